@@ -0,0 +1,312 @@
+#include "baro_correction.h"
+
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cJSON.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef CONFIG_ENABLE_BARO_FIT
+#include "common.h"
+#include "datastructures.h"
+#endif
+
+static const char *TAG = "BARO_CORRECTION";
+
+// Plausible ranges for runtime values
+#define BETA_MAX_ABS  0.1f     // 1/hPa
+#define P0_MIN_HPA    300.0f
+#define P0_MAX_HPA    1100.0f
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Pressure accumulator of the current PCNT window
+static double s_pressure_sum = 0.0;
+static uint32_t s_pressure_samples = 0;
+
+// Correction coefficients
+static float s_beta = 0.0f;
+static float s_p0_hpa = 0.0f;
+
+static bool parse_float(const char *str, float *value)
+{
+    if (str == NULL || str[0] == '\0') {
+        return false;
+    }
+    char *end = NULL;
+    float v = strtof(str, &end);
+    if (end == str || !isfinite(v)) {
+        return false;
+    }
+    *value = v;
+    return true;
+}
+
+static bool values_valid(float beta, float p0_hpa)
+{
+    return isfinite(beta) && fabsf(beta) <= BETA_MAX_ABS &&
+           isfinite(p0_hpa) && p0_hpa >= P0_MIN_HPA && p0_hpa <= P0_MAX_HPA;
+}
+
+esp_err_t baro_correction_init(const nmda_init_config_t *config)
+{
+    esp_err_t ret = ESP_OK;
+    float beta = 0.0f;
+    float p0_hpa = 0.0f;
+
+    parse_float(CONFIG_BARO_DEFAULT_BETA, &beta);
+    parse_float(CONFIG_BARO_DEFAULT_P0_HPA, &p0_hpa);
+
+    if (config != NULL && config->baro_beta != NULL && !parse_float(config->baro_beta, &beta)) {
+        ESP_LOGW(TAG, "Invalid baro_beta '%s', using default %s", config->baro_beta, CONFIG_BARO_DEFAULT_BETA);
+        ret = ESP_ERR_INVALID_ARG;
+    }
+    if (config != NULL && config->baro_p0 != NULL && !parse_float(config->baro_p0, &p0_hpa)) {
+        ESP_LOGW(TAG, "Invalid baro_p0 '%s', using default %s", config->baro_p0, CONFIG_BARO_DEFAULT_P0_HPA);
+        ret = ESP_ERR_INVALID_ARG;
+    }
+
+    if (baro_correction_set(beta, p0_hpa) != ESP_OK) {
+        ESP_LOGE(TAG, "Barometric coefficients out of range, correction disabled (beta = 0)");
+        portENTER_CRITICAL(&s_lock);
+        s_beta = 0.0f;
+        s_p0_hpa = 1013.25f;
+        portEXIT_CRITICAL(&s_lock);
+        ret = ESP_ERR_INVALID_ARG;
+    }
+
+    return ret;
+}
+
+void baro_correction_add_sample(float pressure_hpa)
+{
+    if (!isfinite(pressure_hpa)) {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_pressure_sum += pressure_hpa;
+    s_pressure_samples++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+uint32_t baro_correction_close_window(float *mean_pressure_hpa)
+{
+    portENTER_CRITICAL(&s_lock);
+    double sum = s_pressure_sum;
+    uint32_t samples = s_pressure_samples;
+    s_pressure_sum = 0.0;
+    s_pressure_samples = 0;
+    portEXIT_CRITICAL(&s_lock);
+
+    *mean_pressure_hpa = samples > 0 ? (float)(sum / samples) : NAN;
+    return samples;
+}
+
+void baro_correction_get(float *beta, float *p0_hpa)
+{
+    portENTER_CRITICAL(&s_lock);
+    *beta = s_beta;
+    *p0_hpa = s_p0_hpa;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t baro_correction_set(float beta, float p0_hpa)
+{
+    if (!values_valid(beta, p0_hpa)) {
+        ESP_LOGW(TAG, "Rejected beta=%g 1/hPa, P0=%.2f hPa (out of range)", beta, p0_hpa);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_beta = beta;
+    s_p0_hpa = p0_hpa;
+    portEXIT_CRITICAL(&s_lock);
+
+    ESP_LOGI(TAG, "Barometric correction: beta=%g 1/hPa, P0=%.2f hPa", beta, p0_hpa);
+    return ESP_OK;
+}
+
+// Read a member given either as a JSON number or as a string (the repo publishes strings)
+static bool json_get_float(const cJSON *json, const char *name, float *value)
+{
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(json, name);
+    if (cJSON_IsNumber(item)) {
+        *value = (float)item->valuedouble;
+        return true;
+    }
+    if (cJSON_IsString(item)) {
+        return parse_float(item->valuestring, value);
+    }
+    return false;
+}
+
+esp_err_t baro_correction_handle_config(const char *data, int len)
+{
+    if (data == NULL || len <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    cJSON *json = cJSON_ParseWithLength(data, (size_t)len);
+    if (json == NULL) {
+        ESP_LOGW(TAG, "Invalid JSON in baro config");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    float beta;
+    float p0_hpa;
+    baro_correction_get(&beta, &p0_hpa);
+
+    bool has_beta = json_get_float(json, "beta", &beta);
+    bool has_p0 = json_get_float(json, "p0_hpa", &p0_hpa);
+    cJSON_Delete(json);
+
+    if (!has_beta && !has_p0) {
+        ESP_LOGW(TAG, "Baro config without beta or p0_hpa");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return baro_correction_set(beta, p0_hpa);
+}
+
+#ifdef CONFIG_ENABLE_BARO_FIT
+// Running sums of the exponentially weighted least-squares fit ln(N) = a + b*x,
+// x = P - x0 (centred to keep the sums well conditioned), weight w = N.
+// Each sum is multiplied by the forgetting factor before adding a new window.
+typedef struct {
+    double sw;    // sum w
+    double swx;   // sum w*x
+    double swy;   // sum w*y
+    double swxx;  // sum w*x^2
+    double swxy;  // sum w*x*y
+    double swyy;  // sum w*y^2
+    double n;     // effective number of windows (sum of forgetting weights)
+} baro_fit_t;
+
+// Streams: sum of channels, ch1, ch2, ch3 (same convention as the GLE detector)
+static baro_fit_t s_fit[BARO_FIT_STREAMS];
+static double s_fit_x0_hpa = NAN;  // Fixed centre of x, so runtime P0 changes do not break the sums
+static double s_fit_x_n = 0.0;     // Forgetting-weighted moments of x for the pressure spread
+static double s_fit_x_sum = 0.0;
+static double s_fit_xx_sum = 0.0;
+static double s_fit_lambda = 0.0;
+static uint32_t s_fit_windows = 0;
+
+static void fit_add(baro_fit_t *f, double x, uint32_t counts)
+{
+    f->sw *= s_fit_lambda;
+    f->swx *= s_fit_lambda;
+    f->swy *= s_fit_lambda;
+    f->swxx *= s_fit_lambda;
+    f->swxy *= s_fit_lambda;
+    f->swyy *= s_fit_lambda;
+    f->n *= s_fit_lambda;
+
+    if (counts == 0) {
+        return;  // ln(0) undefined; the window only ages the fit
+    }
+
+    double w = (double)counts;
+    double y = log((double)counts);
+    f->sw += w;
+    f->swx += w * x;
+    f->swy += w * y;
+    f->swxx += w * x * x;
+    f->swxy += w * x * y;
+    f->swyy += w * y * y;
+    f->n += 1.0;
+}
+
+// beta = -slope; sigma from the weighted covariance scaled by the reduced chi^2
+static bool fit_solve(const baro_fit_t *f, float *beta, float *sigma)
+{
+    double d = f->sw * f->swxx - f->swx * f->swx;
+    if (f->n < 3.0 || d <= 0.0) {
+        return false;
+    }
+
+    double b = (f->sw * f->swxy - f->swx * f->swy) / d;
+    double a = (f->swy - b * f->swx) / f->sw;
+    double chi2 = f->swyy - a * f->swy - b * f->swxy;
+    double chi2_red = chi2 > 0.0 ? chi2 / (f->n - 2.0) : 0.0;
+
+    *beta = (float)(-b);
+    *sigma = (float)sqrt(chi2_red * f->sw / d);
+    return true;
+}
+
+void baro_fit_update(const uint32_t counts[3], float pressure_hpa, int64_t timestamp)
+{
+    if (isnan(pressure_hpa)) {
+        return;
+    }
+
+    if (s_fit_lambda == 0.0) {
+        // Weight halves every CONFIG_BARO_FIT_HALF_LIFE_WINDOWS windows
+        s_fit_lambda = pow(0.5, 1.0 / (double)CONFIG_BARO_FIT_HALF_LIFE_WINDOWS);
+    }
+
+    float beta;
+    float p0_hpa;
+    baro_correction_get(&beta, &p0_hpa);
+    if (isnan(s_fit_x0_hpa)) {
+        s_fit_x0_hpa = p0_hpa;
+    }
+    double x = (double)pressure_hpa - s_fit_x0_hpa;
+
+    fit_add(&s_fit[0], x, counts[0] + counts[1] + counts[2]);
+    for (int ch = 0; ch < 3; ch++) {
+        fit_add(&s_fit[ch + 1], x, counts[ch]);
+    }
+    s_fit_x_n = s_fit_x_n * s_fit_lambda + 1.0;
+    s_fit_x_sum = s_fit_x_sum * s_fit_lambda + x;
+    s_fit_xx_sum = s_fit_xx_sum * s_fit_lambda + x * x;
+
+    if (++s_fit_windows < CONFIG_BARO_FIT_PUBLISH_WINDOWS) {
+        return;
+    }
+    s_fit_windows = 0;
+
+    struct telemetry_message message;
+    message.tm_message_type = TM_BARO_FIT;
+    message.timestamp = timestamp;
+    message.payload.tm_baro_fit.n_eff = (float)s_fit[0].n;
+    message.payload.tm_baro_fit.beta_applied = beta;
+
+    // Pressure spread seen by the fit: without it beta is not constrained
+    double mean_x = s_fit_x_sum / s_fit_x_n;
+    double var_x = s_fit_xx_sum / s_fit_x_n - mean_x * mean_x;
+    message.payload.tm_baro_fit.pressure_sd_hpa = var_x > 0.0 ? (float)sqrt(var_x) : 0.0f;
+
+    bool any = false;
+    for (int i = 0; i < BARO_FIT_STREAMS; i++) {
+        if (fit_solve(&s_fit[i], &message.payload.tm_baro_fit.beta[i], &message.payload.tm_baro_fit.sigma[i])) {
+            any = true;
+        } else {
+            message.payload.tm_baro_fit.beta[i] = NAN;
+            message.payload.tm_baro_fit.sigma[i] = NAN;
+        }
+    }
+    if (!any) {
+        ESP_LOGI(TAG, "Beta fit: not enough data yet");
+        return;
+    }
+
+    ESP_LOGI(TAG, "Beta fit (sum): %.5f +/- %.5f 1/hPa (n_eff %.0f, pressure sd %.2f hPa)",
+             message.payload.tm_baro_fit.beta[0], message.payload.tm_baro_fit.sigma[0],
+             message.payload.tm_baro_fit.n_eff, message.payload.tm_baro_fit.pressure_sd_hpa);
+
+    if (!telemetry_ring_push(TELEMETRY_STREAM_HEALTH, &message)) {
+        ESP_LOGW(TAG, "Failed to queue beta fit message");
+    }
+}
+#endif // CONFIG_ENABLE_BARO_FIT
+
+float baro_correction_apply(uint32_t counts, float pressure_hpa, float beta, float p0_hpa)
+{
+    return (float)counts * expf(beta * (pressure_hpa - p0_hpa));
+}
+
+#endif // CONFIG_ENABLE_BARO_CORRECTION
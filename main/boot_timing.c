@@ -0,0 +1,45 @@
+#include "boot_timing.h"
+
+#include <stdatomic.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "BOOT_TIMING";
+
+static const char *const s_names[BOOT_PHASE_COUNT] = {
+    [BOOT_PHASE_SETTINGS] = "settings",
+    [BOOT_PHASE_WIFI_ASSOC] = "wifi_assoc",
+    [BOOT_PHASE_IP] = "ip",
+    [BOOT_PHASE_SNTP] = "sntp",
+    [BOOT_PHASE_ACQUISITION] = "acquisition",
+    [BOOT_PHASE_MQTT] = "mqtt",
+};
+
+// Written from app_main, the event loop, the SNTP callback and the MQTT task
+static _Atomic uint32_t s_marks_ms[BOOT_PHASE_COUNT];
+
+void boot_timing_mark(boot_phase_t phase)
+{
+    if (phase >= BOOT_PHASE_COUNT) {
+        return;
+    }
+    // esp_timer starts at reset, so 0 ms cannot be a real milestone
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    if (now_ms == 0) {
+        now_ms = 1;
+    }
+    uint32_t expected = 0;
+    if (atomic_compare_exchange_strong(&s_marks_ms[phase], &expected, now_ms)) {
+        ESP_LOGI(TAG, "%s at %lu ms", s_names[phase], (unsigned long)now_ms);
+    }
+}
+
+uint32_t boot_timing_get_ms(boot_phase_t phase)
+{
+    return (phase < BOOT_PHASE_COUNT) ? atomic_load(&s_marks_ms[phase]) : 0;
+}
+
+const char *boot_timing_name(boot_phase_t phase)
+{
+    return (phase < BOOT_PHASE_COUNT) ? s_names[phase] : "unknown";
+}
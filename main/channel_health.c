@@ -0,0 +1,282 @@
+#include "channel_health.h"
+
+#ifdef CONFIG_ENABLE_CHANNEL_HEALTH
+
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "common.h"
+#include "datastructures.h"
+#include "pulse_monitor.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+#include "rmt_pulse_capture.h"
+#endif
+
+static const char *TAG = "CHANNEL_HEALTH";
+
+// A line that is high in at least this fraction of the samples is stuck
+#define STUCK_HIGH_FRACTION 0.98f
+// A line that is high in at most this fraction of the samples is idle (low)
+#define IDLE_HIGH_FRACTION 0.02f
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+#define NOISY_BURST_PULSES ((float)CONFIG_CHANNEL_HEALTH_NOISY_BURST_PULSES)
+#else
+#define NOISY_BURST_PULSES (INFINITY)  // No burst statistics without RMT capture
+#endif
+// Weight of a new OK window in the rate baseline (exponential moving average)
+#define BASELINE_ALPHA 0.1f
+// OK windows averaged before the baseline is used for classification
+#define BASELINE_MIN_WINDOWS 6
+// Counts the baseline must predict in a window before a change relative to it
+// is significant (Poisson noise of a few counts is not a collapse or a flood)
+#define BASELINE_MIN_EXPECTED 20.0f
+
+static const int channel_gpios[3] = {PIN_PULSE_IN_CH1, PIN_PULSE_IN_CH2, PIN_PULSE_IN_CH3};
+
+typedef struct {
+    channel_health_state_t state;
+    uint32_t zero_windows;       // Consecutive windows without pulses and with the line idle
+    float baseline_hz;           // Rate history: average rate over OK windows
+    uint32_t baseline_windows;   // OK windows in the baseline (saturates)
+    uint32_t collapse_windows;   // Consecutive windows far below the baseline
+    uint32_t shift_windows;      // Consecutive windows far above or below the baseline
+    bool quarantined;            // RMT/GPIO capture disabled
+    int64_t quarantine_until_us; // esp_timer time when the quarantine may be lifted
+} channel_health_t;
+
+static channel_health_t s_channels[3];
+
+// Line-level samples and burst statistics since the last window, shared with
+// the sampling timer and the RMT event processor
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_high_samples[3];
+static uint32_t s_total_samples;
+static uint32_t s_burst_groups[3];
+static uint32_t s_burst_pulses[3];
+
+static esp_timer_handle_t s_sample_timer = NULL;
+
+static void line_sample_callback(void *arg)
+{
+    int level[3];
+    for (int ch = 0; ch < 3; ch++) {
+        level[ch] = gpio_get_level(channel_gpios[ch]);
+    }
+
+    portENTER_CRITICAL(&s_stats_lock);
+    for (int ch = 0; ch < 3; ch++) {
+        s_high_samples[ch] += level[ch] ? 1 : 0;
+    }
+    s_total_samples++;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+esp_err_t channel_health_init(void)
+{
+    memset(s_channels, 0, sizeof(s_channels));
+
+    esp_timer_create_args_t timer_args = {
+        .callback = line_sample_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "ch_health",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &s_sample_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create line sampling timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_timer_start_periodic(s_sample_timer, (uint64_t)CONFIG_CHANNEL_HEALTH_SAMPLE_MS * 1000ULL);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start line sampling timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Channel health monitor started (line sampling every %d ms)",
+             CONFIG_CHANNEL_HEALTH_SAMPLE_MS);
+    return ESP_OK;
+}
+
+void channel_health_record_burst(int channel_index, uint8_t num_pulses)
+{
+    if (channel_index < 0 || channel_index >= 3) {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_stats_lock);
+    s_burst_groups[channel_index]++;
+    s_burst_pulses[channel_index] += num_pulses;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+channel_health_state_t channel_health_get_state(int channel_index)
+{
+    if (channel_index < 0 || channel_index >= 3) {
+        return CHANNEL_HEALTH_OK;
+    }
+    return s_channels[channel_index].state;
+}
+
+const char *channel_health_state_name(channel_health_state_t state)
+{
+    switch (state) {
+        case CHANNEL_HEALTH_OK:    return "ok";
+        case CHANNEL_HEALTH_DEAD:  return "dead";
+        case CHANNEL_HEALTH_STUCK: return "stuck";
+        case CHANNEL_HEALTH_NOISY: return "noisy";
+        default:                   return "unknown";
+    }
+}
+
+// Disable or re-enable the high-rate capture paths of a channel.
+// PCNT keeps counting, so the channel is still evaluated while quarantined.
+static void set_quarantine(int ch, bool quarantined)
+{
+    s_channels[ch].quarantined = quarantined;
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+    rmt_pulse_capture_set_channel_quarantine(ch, quarantined);
+#endif
+#ifdef CONFIG_ENABLE_GPIO_PULSE_DETECTION
+    set_GPIO_detection_enabled(ch, !quarantined);
+#endif
+    if (quarantined) {
+        s_channels[ch].quarantine_until_us = esp_timer_get_time() +
+            (int64_t)CONFIG_CHANNEL_HEALTH_QUARANTINE_SEC * 1000000LL;
+        ESP_LOGW(TAG, "Channel %d quarantined for %d s", ch + 1, CONFIG_CHANNEL_HEALTH_QUARANTINE_SEC);
+    } else {
+        ESP_LOGI(TAG, "Channel %d quarantine lifted", ch + 1);
+    }
+}
+
+void channel_health_window(const int32_t counts[3], int integration_time_sec, int64_t timestamp)
+{
+    uint32_t high_samples[3];
+    uint32_t total_samples;
+    uint32_t burst_groups[3];
+    uint32_t burst_pulses[3];
+
+    // Take and reset the statistics of this window
+    portENTER_CRITICAL(&s_stats_lock);
+    memcpy(high_samples, s_high_samples, sizeof(high_samples));
+    memcpy(burst_groups, s_burst_groups, sizeof(burst_groups));
+    memcpy(burst_pulses, s_burst_pulses, sizeof(burst_pulses));
+    total_samples = s_total_samples;
+    memset(s_high_samples, 0, sizeof(s_high_samples));
+    memset(s_burst_groups, 0, sizeof(s_burst_groups));
+    memset(s_burst_pulses, 0, sizeof(s_burst_pulses));
+    s_total_samples = 0;
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    if (integration_time_sec <= 0) {
+        return;
+    }
+
+    for (int ch = 0; ch < 3; ch++) {
+        channel_health_t *h = &s_channels[ch];
+        float rate_hz = (float)counts[ch] / (float)integration_time_sec;
+        float high_fraction = total_samples > 0 ? (float)high_samples[ch] / (float)total_samples : 0.0f;
+        float mean_burst = burst_groups[ch] > 0 ? (float)burst_pulses[ch] / (float)burst_groups[ch] : 0.0f;
+
+        // A dead channel counts nothing with its line at rest (low); a line held
+        // high is stuck instead
+        bool idle = counts[ch] == 0 && high_fraction <= IDLE_HIGH_FRACTION;
+        h->zero_windows = idle ? h->zero_windows + 1 : 0;
+
+        // Relative to the rate history: a flood well above it is noise, a
+        // collapse well below it is a dying tube (HV or discriminator failure)
+        float expected = h->baseline_hz * (float)integration_time_sec;
+        bool baseline_usable = h->baseline_windows >= BASELINE_MIN_WINDOWS && expected >= BASELINE_MIN_EXPECTED;
+        bool flood = baseline_usable && rate_hz > h->baseline_hz * (float)CONFIG_CHANNEL_HEALTH_NOISY_FACTOR;
+        bool collapse = baseline_usable && rate_hz * (float)CONFIG_CHANNEL_HEALTH_DEAD_FACTOR < h->baseline_hz;
+        h->collapse_windows = collapse ? h->collapse_windows + 1 : 0;
+
+        // Noisy whatever the baseline: above the absolute rate, or ringing
+        bool flood_absolute = rate_hz > (float)CONFIG_CHANNEL_HEALTH_NOISY_RATE_HZ ||
+                              mean_burst > NOISY_BURST_PULSES;
+        // A rate step only relative to the baseline; real noise never becomes the reference
+        h->shift_windows = ((flood || collapse) && !flood_absolute) ? h->shift_windows + 1 : 0;
+
+        channel_health_state_t new_state;
+        if (high_fraction >= STUCK_HIGH_FRACTION && counts[ch] == 0) {
+            new_state = CHANNEL_HEALTH_STUCK;
+        } else if (flood_absolute || flood) {
+            new_state = CHANNEL_HEALTH_NOISY;
+        } else if (h->zero_windows >= CONFIG_CHANNEL_HEALTH_DEAD_WINDOWS ||
+                   h->collapse_windows >= CONFIG_CHANNEL_HEALTH_DEAD_WINDOWS) {
+            new_state = CHANNEL_HEALTH_DEAD;
+        } else {
+            new_state = CHANNEL_HEALTH_OK;
+        }
+
+        // A step that lasts this long is the new normal rate (the detector was
+        // moved or its threshold changed): start the baseline again from it
+        if (h->shift_windows >= CONFIG_CHANNEL_HEALTH_REBASELINE_WINDOWS) {
+            ESP_LOGW(TAG, "Channel %d: rate %.2f Hz for %lu windows against a baseline of %.2f Hz, re-baselining",
+                     ch + 1, rate_hz, (unsigned long)h->shift_windows, h->baseline_hz);
+            h->baseline_hz = rate_hz;
+            h->baseline_windows = 1;
+            h->collapse_windows = 0;
+            h->shift_windows = 0;
+            if (new_state == CHANNEL_HEALTH_NOISY ||
+                (new_state == CHANNEL_HEALTH_DEAD && h->zero_windows < CONFIG_CHANNEL_HEALTH_DEAD_WINDOWS)) {
+                new_state = CHANNEL_HEALTH_OK;
+            }
+        } else if (new_state == CHANNEL_HEALTH_OK && !flood && !collapse) {
+            // Only OK windows feed the baseline, and not the first windows of a
+            // collapse either, so a fault does not become the reference
+            if (h->baseline_windows > 0) {
+                h->baseline_hz += BASELINE_ALPHA * (rate_hz - h->baseline_hz);
+            } else {
+                h->baseline_hz = rate_hz;
+            }
+            if (h->baseline_windows < BASELINE_MIN_WINDOWS) {
+                h->baseline_windows++;
+            }
+        }
+
+        // Quarantine noisy channels; lift it once the minimum time has passed
+        // and the PCNT rate is no longer noisy
+        bool quarantine_changed = false;
+        if (new_state == CHANNEL_HEALTH_NOISY && !h->quarantined) {
+            set_quarantine(ch, true);
+            quarantine_changed = true;
+        } else if (h->quarantined && new_state != CHANNEL_HEALTH_NOISY &&
+                   esp_timer_get_time() >= h->quarantine_until_us) {
+            set_quarantine(ch, false);
+            quarantine_changed = true;
+        }
+
+        if (new_state == h->state && !quarantine_changed) {
+            continue;
+        }
+
+        ESP_LOGW(TAG, "Channel %d: %s -> %s (rate %.2f Hz, baseline %.2f Hz, high %.3f, burst %.2f)",
+                 ch + 1, channel_health_state_name(h->state), channel_health_state_name(new_state),
+                 rate_hz, h->baseline_hz, high_fraction, mean_burst);
+
+        struct telemetry_message message;
+        message.tm_message_type = TM_CHANNEL_HEALTH;
+        message.timestamp = timestamp;
+        message.payload.tm_health.channel = ch + 1;
+        message.payload.tm_health.state = new_state;
+        message.payload.tm_health.previous_state = h->state;
+        message.payload.tm_health.quarantined = h->quarantined ? 1 : 0;
+        message.payload.tm_health.rate_hz = rate_hz;
+        message.payload.tm_health.baseline_hz = h->baseline_hz;
+        message.payload.tm_health.high_fraction = high_fraction;
+        message.payload.tm_health.mean_burst = mean_burst;
+
+        h->state = new_state;
+
+        if (!telemetry_ring_push(TELEMETRY_STREAM_HEALTH, &message)) {
+            ESP_LOGE(TAG, "Failed to send health message to telemetry ring");
+        }
+    }
+}
+
+#endif // CONFIG_ENABLE_CHANNEL_HEALTH
@@ -0,0 +1,140 @@
+#include "gle_detector.h"
+
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include "common.h"
+#include "datastructures.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "timebase.h"
+
+static const char *TAG = "GLE_DETECTOR";
+
+#define GLE_BASELINE_BINS    CONFIG_GLE_BASELINE_SEC
+#define GLE_INTEGRATION_BINS CONFIG_GLE_INTEGRATION_SEC
+#define GLE_THRESHOLD_SIGMA  ((float)CONFIG_GLE_THRESHOLD_SIGMA_X10 / 10.0f)
+// The alert ends when the significance falls below half the onset threshold
+#define GLE_CLEAR_SIGMA      (GLE_THRESHOLD_SIGMA / 2.0f)
+
+typedef struct {
+    // Sliding sum over the last GLE_INTEGRATION_BINS bins
+    uint16_t recent[GLE_INTEGRATION_BINS];
+    uint32_t recent_head;
+    uint32_t recent_count;
+    uint32_t recent_sum;
+    // Rolling baseline over the bins that already left the sliding sum
+    uint16_t baseline[GLE_BASELINE_BINS];
+    uint32_t baseline_head;
+    uint32_t baseline_count;
+    uint32_t baseline_sum;
+    bool alert_active;
+} gle_stream_t;
+
+static gle_stream_t s_streams[GLE_STREAMS];
+
+void gle_detector_init(void)
+{
+    memset(s_streams, 0, sizeof(s_streams));
+    ESP_LOGI(TAG, "GLE detector: %d s integration, %d s baseline, threshold %.1f sigma",
+             GLE_INTEGRATION_BINS, GLE_BASELINE_BINS, GLE_THRESHOLD_SIGMA);
+}
+
+// Poisson significance of observing n counts when mu are expected, using the
+// variance-stabilising (Anscombe) transform: approximately N(0, 1) for mu >~ 1
+static float poisson_significance(uint32_t n, float mu)
+{
+    return 2.0f * (sqrtf((float)n + 0.375f) - sqrtf(mu + 0.375f));
+}
+
+static void send_alert(int stream, uint8_t event, uint32_t counts, float expected, float sigma,
+                       int64_t bin_start_us, int64_t bin_end_us)
+{
+    struct telemetry_message message;
+    int64_t detect_us = esp_timer_get_time();
+
+    // Unix time of the end of the bin that triggered the event (esp_timer before the first sync)
+    message.tm_message_type = TM_GLE_ALERT;
+    message.timestamp = timebase_from_boot_us(bin_end_us);
+    message.payload.tm_alert.stream = (uint8_t)stream;
+    message.payload.tm_alert.event = event;
+    message.payload.tm_alert.integration_time_sec = GLE_INTEGRATION_BINS;
+    message.payload.tm_alert.counts = counts;
+    message.payload.tm_alert.expected = expected;
+    message.payload.tm_alert.sigma = sigma;
+    message.payload.tm_alert.bin_start_us = bin_start_us;
+    message.payload.tm_alert.bin_end_us = bin_end_us;
+    message.payload.tm_alert.detect_us = detect_us;
+
+    // High-priority path: the alert ring is drained before any other stream
+    if (!telemetry_ring_push(TELEMETRY_STREAM_ALERT, &message)) {
+        ESP_LOGE(TAG, "Failed to queue GLE alert (alert ring full)");
+    }
+}
+
+static void stream_feed(int stream, uint32_t bin_count, int64_t bin_start_us, int64_t bin_end_us)
+{
+    gle_stream_t *s = &s_streams[stream];
+    uint16_t value = bin_count > UINT16_MAX ? UINT16_MAX : (uint16_t)bin_count;
+
+    // The oldest bin of the sliding sum moves into the baseline, except during an
+    // alert so that the enhancement does not raise its own reference level
+    if (s->recent_count == GLE_INTEGRATION_BINS) {
+        uint16_t oldest = s->recent[s->recent_head];
+        s->recent_sum -= oldest;
+        s->recent_count--;
+        if (!s->alert_active) {
+            if (s->baseline_count == GLE_BASELINE_BINS) {
+                s->baseline_sum -= s->baseline[s->baseline_head];
+            } else {
+                s->baseline_count++;
+            }
+            s->baseline[s->baseline_head] = oldest;
+            s->baseline_sum += oldest;
+            s->baseline_head = (s->baseline_head + 1) % GLE_BASELINE_BINS;
+        }
+    }
+    s->recent[s->recent_head] = value;
+    s->recent_sum += value;
+    s->recent_count++;
+    s->recent_head = (s->recent_head + 1) % GLE_INTEGRATION_BINS;
+
+    if (s->recent_count < GLE_INTEGRATION_BINS || s->baseline_count < CONFIG_GLE_MIN_BASELINE_SEC) {
+        return;  // Still warming up
+    }
+
+    float expected = (float)s->baseline_sum / (float)s->baseline_count * (float)GLE_INTEGRATION_BINS;
+    float sigma = poisson_significance(s->recent_sum, expected);
+
+    if (!s->alert_active && sigma >= GLE_THRESHOLD_SIGMA) {
+        s->alert_active = true;
+        ESP_LOGW(TAG, "GLE onset on stream %d: %lu counts in %d s, expected %.1f (%.1f sigma)",
+                 stream, (unsigned long)s->recent_sum, GLE_INTEGRATION_BINS, expected, sigma);
+        send_alert(stream, GLE_EVENT_ONSET, s->recent_sum, expected, sigma, bin_start_us, bin_end_us);
+    } else if (s->alert_active && sigma < GLE_CLEAR_SIGMA) {
+        s->alert_active = false;
+        ESP_LOGI(TAG, "GLE end on stream %d (%.1f sigma)", stream, sigma);
+        send_alert(stream, GLE_EVENT_END, s->recent_sum, expected, sigma, bin_start_us, bin_end_us);
+    }
+}
+
+void gle_detector_feed(const int32_t counts[3], int64_t bin_start_us, int64_t bin_end_us)
+{
+    int64_t duration_us = bin_end_us - bin_start_us;
+    if (duration_us < 900000 || duration_us > 1100000) {
+        ESP_LOGD(TAG, "Ignoring %lld us bin", duration_us);
+        return;
+    }
+
+    uint32_t sum = 0;
+    for (int ch = 0; ch < 3; ch++) {
+        uint32_t c = counts[ch] > 0 ? (uint32_t)counts[ch] : 0;
+        sum += c;
+        stream_feed(ch + 1, c, bin_start_us, bin_end_us);
+    }
+    stream_feed(GLE_STREAM_SUM, sum, bin_start_us, bin_end_us);
+}
+
+#endif // CONFIG_ENABLE_GLE_DETECTOR
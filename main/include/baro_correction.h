@@ -0,0 +1,92 @@
+#ifndef __BARO_CORRECTION_H_
+#define __BARO_CORRECTION_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "settings.h"
+
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+
+/**
+ * @brief Load beta and P0 from the settings (ini/NVS) or the Kconfig defaults
+ *
+ * @param config Loaded settings; baro_beta / baro_p0 may be NULL
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG if a configured value could not be parsed
+ *         (the Kconfig default is kept for that value)
+ */
+esp_err_t baro_correction_init(const nmda_init_config_t *config);
+
+/**
+ * @brief Add one pressure sample to the current PCNT window
+ *
+ * Called by spl06_monitor_task every CONFIG_BARO_SAMPLE_PERIOD_MS.
+ *
+ * @param pressure_hpa Absolute pressure in hPa
+ */
+void baro_correction_add_sample(float pressure_hpa);
+
+/**
+ * @brief Close the current window and start the next one
+ *
+ * Called by task_pcnt at the same instant the PCNT counters are cleared, so the
+ * mean covers exactly the same integration window as the counts.
+ *
+ * @param mean_pressure_hpa Output: mean pressure of the window (NAN if no samples)
+ * @return Number of pressure samples in the window
+ */
+uint32_t baro_correction_close_window(float *mean_pressure_hpa);
+
+/**
+ * @brief Current correction coefficients
+ *
+ * @param beta Output: barometric coefficient in 1/hPa
+ * @param p0_hpa Output: reference pressure in hPa
+ */
+void baro_correction_get(float *beta, float *p0_hpa);
+
+/**
+ * @brief Change the correction coefficients at runtime
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG if a value is out of range
+ */
+esp_err_t baro_correction_set(float beta, float p0_hpa);
+
+/**
+ * @brief Apply a runtime configuration received on {base}/config/baro
+ *
+ * Payload: JSON object with optional "beta" (1/hPa) and "p0_hpa" members, as
+ * numbers or strings, e.g. {"beta":"0.0072","p0_hpa":"1013.25"}.
+ *
+ * @param data Payload (not NUL-terminated)
+ * @param len Payload length
+ * @return ESP_OK if applied, ESP_ERR_INVALID_ARG if the payload is not valid
+ */
+esp_err_t baro_correction_handle_config(const char *data, int len);
+
+#ifdef CONFIG_ENABLE_BARO_FIT
+/**
+ * @brief Update the online estimate of beta with one PCNT window
+ *
+ * Exponentially weighted least-squares fit of ln(N) against (P - P0) for each
+ * channel and for the sum of the three, weighted by N (Poisson variance of ln N).
+ * Only running sums are kept, so the update is O(1) with no history buffer.
+ * Every CONFIG_BARO_FIT_PUBLISH_WINDOWS windows a TM_BARO_FIT message with the
+ * current estimates is queued.
+ *
+ * @param counts PCNT counts of the window per channel
+ * @param pressure_hpa Mean pressure of the same window (ignored if NAN)
+ * @param timestamp Window end (microseconds Unix)
+ */
+void baro_fit_update(const uint32_t counts[3], float pressure_hpa, int64_t timestamp);
+#endif
+
+/**
+ * @brief Pressure-corrected counts: N_corr = N * exp(beta * (P - P0))
+ */
+float baro_correction_apply(uint32_t counts, float pressure_hpa, float beta, float p0_hpa);
+
+#endif // CONFIG_ENABLE_BARO_CORRECTION
+
+#endif // __BARO_CORRECTION_H_
@@ -0,0 +1,40 @@
+#ifndef __BOOT_TIMING_H_
+#define __BOOT_TIMING_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Milestones of the boot sequence
+ *
+ * Each milestone is stamped once, the first time it is reached, in
+ * milliseconds since the chip came out of reset (esp_timer). mss_sender
+ * reports them in the first status message.
+ */
+typedef enum {
+    BOOT_PHASE_SETTINGS = 0,    // Settings loaded from NVS/SPIFFS
+    BOOT_PHASE_WIFI_ASSOC,      // Associated with the access point
+    BOOT_PHASE_IP,              // IP address ready (DHCP lease or static)
+    BOOT_PHASE_SNTP,            // First SNTP synchronization
+    BOOT_PHASE_ACQUISITION,     // task_pcnt started
+    BOOT_PHASE_MQTT,            // First MQTT connection
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+/**
+ * @brief Stamp a milestone; later calls for the same one are ignored
+ *
+ * Safe from any task.
+ */
+void boot_timing_mark(boot_phase_t phase);
+
+/**
+ * @brief Milliseconds since reset at which the milestone was reached, 0 if not yet
+ */
+uint32_t boot_timing_get_ms(boot_phase_t phase);
+
+/**
+ * @brief Short name of the milestone ("settings", "wifi_assoc"...)
+ */
+const char *boot_timing_name(boot_phase_t phase);
+
+#endif // __BOOT_TIMING_H_
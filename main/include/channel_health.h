@@ -0,0 +1,63 @@
+#ifndef __CHANNEL_HEALTH_H_
+#define __CHANNEL_HEALTH_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_ENABLE_CHANNEL_HEALTH
+
+/**
+ * @brief Health state of a pulse channel
+ */
+typedef enum {
+    CHANNEL_HEALTH_OK = 0,  // Counting normally
+    CHANNEL_HEALTH_DEAD,    // No pulses for CONFIG_CHANNEL_HEALTH_DEAD_WINDOWS windows, line idle
+    CHANNEL_HEALTH_STUCK,   // Line held at high level during the window
+    CHANNEL_HEALTH_NOISY,   // Rate or burst size far above what a detector produces (ringing)
+} channel_health_state_t;
+
+/**
+ * @brief Start line-level sampling of the three pulse inputs
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t channel_health_init(void);
+
+/**
+ * @brief Record one RMT pulse group (burst) for the burst statistics
+ *
+ * Called from task_rmt_event_processor for every group received.
+ *
+ * @param channel_index Channel index (0, 1, 2)
+ * @param num_pulses Number of pulses in the group
+ */
+void channel_health_record_burst(int channel_index, uint8_t num_pulses);
+
+/**
+ * @brief Classify every channel at the end of a PCNT window
+ *
+ * Uses the window counts, the rate history, the line-level samples and the
+ * burst statistics gathered since the previous call. Noisy channels get their
+ * RMT capture and GPIO interrupts disabled for CONFIG_CHANNEL_HEALTH_QUARANTINE_SEC.
+ * A TM_CHANNEL_HEALTH message is queued for every state change.
+ *
+ * @param counts PCNT counts of the window per channel
+ * @param integration_time_sec Window length in seconds
+ * @param timestamp Window end (microseconds Unix)
+ */
+void channel_health_window(const int32_t counts[3], int integration_time_sec, int64_t timestamp);
+
+/**
+ * @brief Get the current state of a channel
+ */
+channel_health_state_t channel_health_get_state(int channel_index);
+
+/**
+ * @brief Short name of a health state ("ok", "dead", "stuck", "noisy")
+ */
+const char *channel_health_state_name(channel_health_state_t state);
+
+#endif // CONFIG_ENABLE_CHANNEL_HEALTH
+
+#endif // __CHANNEL_HEALTH_H_
@@ -8,6 +8,7 @@
 #include "esp32-libs.h"
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
+#include "telemetry_rings.h"
 
 //OTA
 void task_ota(void *parameters);
@@ -37,11 +38,9 @@ void hv_adc_monitor_task(void *parameters);
 void init_GPIO(void);
 #ifdef CONFIG_ENABLE_GPIO_PULSE_DETECTION
 void reconfigure_GPIO_interrupts(void);
+void set_GPIO_detection_enabled(int channel_index, bool enabled);
 #endif
 
-//QUEUE
-extern QueueHandle_t telemetry_queue;
-
 //SEMAPHORE
 extern SemaphoreHandle_t wifi_semaphore;
 extern SemaphoreHandle_t sntp_semaphore;
@@ -6,6 +6,10 @@
 #define TM_PULSE_COUNT 3
 #define TM_TIME_SYNCHRONIZER 4
 
+// time_flags: el timestamp se convirtió con la hora provisional restaurada del RTC
+// (antes de la primera sincronización SNTP tras un reinicio en caliente)
+#define TM_TIME_PROVISIONAL 0x01
+
 #ifdef CONFIG_ENABLE_SPL06
 #define TM_SPL06 6
 #endif
@@ -15,15 +19,72 @@
 #define TM_RMT_COINCIDENCE 8
 #define TM_RMT_MULTIPLICITY 9
 
+#endif
+
+#ifdef CONFIG_ENABLE_CHANNEL_HEALTH
+#define TM_CHANNEL_HEALTH 10
+#endif
+
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+#define TM_GLE_ALERT 11
+#endif
+
+#ifdef CONFIG_ENABLE_BARO_FIT
+#define TM_BARO_FIT 12
+#define BARO_FIT_STREAMS 4  // Suma de canales, ch1, ch2, ch3
+#endif
+
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
 // Structure for a single pulse (duration and separation)
 typedef struct {
     uint32_t duration_us;   // Duración del pulso (microsegundos)
+    uint16_t duration_ticks; // Duración del pulso en ticks RMT (RMT_PULSE_RESOLUTION_HZ)
     int64_t separation_us;   // Separación con pulso anterior (microsegundos, -1 si es el primero)
 } rmt_pulse_t;
 #endif
 
+/*
+ * Esquema de los mensajes planos: una única tabla por tipo de mensaje genera el
+ * miembro de la unión (aquí), el codificador JSON, el codificador binario y el
+ * registro del topic (telemetry_schema.c).
+ *
+ * F(tipo C, miembro, dimensión, clave JSON, estilo JSON, decimales)
+ *   - dimensión: vacía para un escalar, [n] para un array; las claves de un
+ *     array son la clave seguida de "ch01", "ch02"...
+ *   - estilo: TM_JSON_UINT (número entre comillas), TM_JSON_FLOAT (con los
+ *     decimales indicados), TM_JSON_CHANNEL ("chN"), TM_JSON_FLAG ("1"/"0") o
+ *     TM_JSON_HEALTH_STATE (nombre del estado de salud)
+ *
+ * Añadir un campo es añadir una línea. Los documentos empiezan siempre por
+ * "datetime" (timestamp del mensaje).
+ */
+#define TM_SCHEMA_DETECT(F) \
+    F(uint32_t, channel, [3], "", TM_JSON_UINT, 0)                           /* Nivel de cada canal (1 = pulso) */
+
+#define TM_SCHEMA_SYNC(F) \
+    F(uint32_t, cpu_count, , "cpu_lnd", TM_JSON_UINT, 0)
+
+#define TM_SCHEMA_SPL06(F) \
+    F(float, pressure_pa, , "pressure_pa", TM_JSON_FLOAT, 2)                 /* Presión en Pascales */ \
+    F(float, pressure_hpa, , "pressure_hpa", TM_JSON_FLOAT, 2)               /* Presión en hPa (compatibilidad) */ \
+    F(float, temperature_celsius, , "temperature_celsius", TM_JSON_FLOAT, 2) /* Temperatura en grados Celsius */ \
+    F(float, qnh_hpa, , "qnh_hpa", TM_JSON_FLOAT, 2)                         /* QNH en hPa (fórmula AEMET) */
+
+#define TM_SCHEMA_HEALTH(F) \
+    F(uint8_t, channel, , "channel", TM_JSON_CHANNEL, 0)                     /* Canal (1, 2, o 3) */ \
+    F(uint8_t, state, , "state", TM_JSON_HEALTH_STATE, 0)                    /* Nuevo estado (channel_health_state_t) */ \
+    F(uint8_t, previous_state, , "previous", TM_JSON_HEALTH_STATE, 0)        /* Estado anterior */ \
+    F(uint8_t, quarantined, , "quarantined", TM_JSON_FLAG, 0)                /* 1 si la captura RMT/GPIO del canal está deshabilitada */ \
+    F(float, rate_hz, , "rate_hz", TM_JSON_FLOAT, 2)                         /* Tasa PCNT de la ventana */ \
+    F(float, baseline_hz, , "baseline_hz", TM_JSON_FLOAT, 2)                 /* Tasa media histórica (ventanas OK) */ \
+    F(float, high_fraction, , "high_fraction", TM_JSON_FLOAT, 3)             /* Fracción de muestras con la línea a nivel alto */ \
+    F(float, mean_burst, , "mean_burst", TM_JSON_FLOAT, 2)                   /* Pulsos medios por grupo RMT */
+
+#define TM_SCHEMA_MEMBER(ctype, member, dims, key, style, decimals) ctype member dims;
+
 struct telemetry_message {
     uint8_t tm_message_type;
+    uint8_t time_flags;       // TM_TIME_*; lo fija mss_sender al publicar
     int64_t timestamp;
     union {
         struct  {
@@ -34,19 +95,28 @@ struct telemetry_message {
             uint8_t integration_time_sec;
             uint32_t channel[3];
             int64_t start_timestamp;  // Timestamp de inicio del intervalo (microsegundos Unix)
+            uint32_t seq;             // Número de secuencia de la ventana (persistente entre reinicios en caliente)
+#ifdef CONFIG_ENABLE_PCNT_GATE
+            uint32_t gated[3];        // Cuentas con gate/veto aplicado (igual a channel[] si el canal no tiene gate)
+#endif
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+            uint32_t rmt[3];          // Pulsos capturados por RMT en la misma ventana (contraste PCNT/RMT)
+#endif
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+            float pressure_hpa;       // Presión media de la ventana (NAN si no hubo muestras)
+            float baro_beta;          // Coeficiente barométrico aplicado (1/hPa)
+            float baro_p0_hpa;        // Presión de referencia aplicada (hPa)
+#endif
         } tm_pcnt;
         struct {
-            uint32_t channel[3];
+            TM_SCHEMA_DETECT(TM_SCHEMA_MEMBER)
         } tm_detect;
         struct {
-            uint32_t cpu_count;
+            TM_SCHEMA_SYNC(TM_SCHEMA_MEMBER)
         } tm_sync;
 #ifdef CONFIG_ENABLE_SPL06
         struct {
-            float pressure_pa;          // Presión en Pascales
-            float pressure_hpa;         // Presión en hectopascales (para compatibilidad)
-            float temperature_celsius;  // Temperatura en grados Celsius
-            float qnh_hpa;              // QNH (presión reducida al nivel del mar) en hPa (fórmula AEMET)
+            TM_SCHEMA_SPL06(TM_SCHEMA_MEMBER)
         } tm_spl06;
 #endif
 #ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
@@ -72,6 +142,33 @@ struct telemetry_message {
             uint32_t max_separation_us; // Máxima separación entre pulsos (microsegundos)
             uint32_t total_duration_us; // Duración total del grupo (microsegundos)
         } tm_rmt_multiplicity;
+#endif
+#ifdef CONFIG_ENABLE_CHANNEL_HEALTH
+        struct {
+            TM_SCHEMA_HEALTH(TM_SCHEMA_MEMBER)
+        } tm_health;
+#endif
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+        struct {
+            uint8_t stream;             // 0 = suma de canales, 1..3 = canal
+            uint8_t event;              // GLE_EVENT_ONSET / GLE_EVENT_END
+            uint8_t integration_time_sec; // Longitud de la suma deslizante
+            uint32_t counts;            // Cuentas en la suma deslizante
+            float expected;             // Cuentas esperadas según la línea base
+            float sigma;                // Significancia Poisson
+            int64_t bin_start_us;       // Inicio del bin de 1 s que disparó la alerta (esp_timer, desde arranque)
+            int64_t bin_end_us;         // Fin del bin (esp_timer, desde arranque)
+            int64_t detect_us;          // Instante de la detección (esp_timer, desde arranque)
+        } tm_alert;
+#endif
+#ifdef CONFIG_ENABLE_BARO_FIT
+        struct {
+            float beta[BARO_FIT_STREAMS];   // Estimación de beta (1/hPa): suma, ch1, ch2, ch3
+            float sigma[BARO_FIT_STREAMS];  // Incertidumbre (1 sigma) de cada estimación
+            float n_eff;                    // Número efectivo de ventanas en el ajuste
+            float pressure_sd_hpa;          // Dispersión de presión vista por el ajuste
+            float beta_applied;             // Beta usado en la corrección de pcnt en ese momento
+        } tm_baro_fit;
 #endif
   } payload;
 };
@@ -0,0 +1,40 @@
+#ifndef __GLE_DETECTOR_H_
+#define __GLE_DETECTOR_H_
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+
+// Streams analysed by the detector: one per channel plus the sum of the three
+#define GLE_STREAM_SUM 0
+#define GLE_STREAMS    4
+
+#define GLE_EVENT_END   0
+#define GLE_EVENT_ONSET 1
+
+/**
+ * @brief Reset the detector state (baselines are rebuilt from scratch)
+ */
+void gle_detector_init(void);
+
+/**
+ * @brief Feed one 1 s counting bin to the detector
+ *
+ * Called by task_pcnt once per second. Each stream keeps a sliding sum over the
+ * last CONFIG_GLE_INTEGRATION_SEC bins and a rolling baseline over the previous
+ * CONFIG_GLE_BASELINE_SEC bins. When the Poisson significance of the sliding sum
+ * crosses CONFIG_GLE_THRESHOLD_SIGMA_X10 / 10 a TM_GLE_ALERT message is pushed on
+ * the alert ring, which mss_sender drains ahead of any other telemetry.
+ *
+ * Bins shorter than 900 ms or longer than 1100 ms (first partial bin) are ignored.
+ *
+ * @param counts PCNT counts of the bin per channel
+ * @param bin_start_us Bin start (microseconds since boot, esp_timer)
+ * @param bin_end_us Bin end (microseconds since boot, esp_timer)
+ */
+void gle_detector_feed(const int32_t counts[3], int64_t bin_start_us, int64_t bin_end_us);
+
+#endif // CONFIG_ENABLE_GLE_DETECTOR
+
+#endif // __GLE_DETECTOR_H_
@@ -0,0 +1,20 @@
+#ifndef __JSON_BENCHMARK_H_
+#define __JSON_BENCHMARK_H_
+
+#include "sdkconfig.h"
+
+#ifdef CONFIG_ENABLE_JSON_BENCHMARK
+
+/**
+ * @brief Compare the streaming JSON writer against the former cJSON path
+ *
+ * Serializes synthetic pcnt and pburst messages (1, 8 and 64 pulses)
+ * CONFIG_JSON_BENCHMARK_ITERATIONS times with each method and logs CPU
+ * cycles, document bytes and allocator calls per message, and whether both
+ * documents are byte-identical. Called once by mss_sender before MQTT starts.
+ */
+void json_benchmark_run(void);
+
+#endif // CONFIG_ENABLE_JSON_BENCHMARK
+
+#endif // __JSON_BENCHMARK_H_
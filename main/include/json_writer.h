@@ -0,0 +1,79 @@
+#ifndef __JSON_WRITER_H_
+#define __JSON_WRITER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Streaming JSON writer into a caller-owned buffer
+ *
+ * Emits compact JSON (same bytes as cJSON_PrintUnformatted for the same members
+ * in the same order) without building a tree and without any allocation.
+ * Integers are formatted without snprintf. If the buffer is too small the
+ * writer stops writing and json_writer_finish() returns NULL.
+ *
+ * Members are added with a key inside objects and with key NULL inside arrays
+ * and for the top-level value.
+ */
+
+#define JSON_WRITER_MAX_DEPTH 8
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    uint8_t depth;
+    uint8_t first;      // Bit n set: level n has no member yet
+    bool overflow;
+} json_writer_t;
+
+/**
+ * @brief Start a new document in buf (previous content is discarded)
+ */
+void json_writer_init(json_writer_t *w, char *buf, size_t size);
+
+void json_writer_begin_object(json_writer_t *w, const char *key);
+void json_writer_end_object(json_writer_t *w);
+void json_writer_begin_array(json_writer_t *w, const char *key);
+void json_writer_end_array(json_writer_t *w);
+
+/**
+ * @brief String member, escaped as cJSON does
+ */
+void json_writer_string(json_writer_t *w, const char *key, const char *value);
+
+/**
+ * @brief Integer published as a string member ("key":"123"), the repo's usual format
+ */
+void json_writer_string_int(json_writer_t *w, const char *key, int64_t value);
+void json_writer_string_uint(json_writer_t *w, const char *key, uint64_t value);
+
+/**
+ * @brief Float published as a string member with a fixed number of decimals ("%.Nf")
+ */
+void json_writer_string_float(json_writer_t *w, const char *key, double value, int decimals);
+
+/**
+ * @brief Integer number member ("key":123)
+ */
+void json_writer_int(json_writer_t *w, const char *key, int64_t value);
+
+/**
+ * @brief Close the document
+ *
+ * @return NUL-terminated document in the writer buffer, or NULL if it did not fit
+ *         or objects/arrays were left open
+ */
+const char *json_writer_finish(json_writer_t *w);
+
+/**
+ * @brief Decimal representation of an integer, without snprintf
+ *
+ * @param dst Output, at least 21 bytes; NUL-terminated
+ * @return Number of characters written (without the NUL)
+ */
+size_t json_format_int(char *dst, int64_t value);
+size_t json_format_uint(char *dst, uint64_t value);
+
+#endif // __JSON_WRITER_H_
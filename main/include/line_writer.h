@@ -0,0 +1,72 @@
+#ifndef __LINE_WRITER_H_
+#define __LINE_WRITER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+
+/**
+ * @brief Streaming InfluxDB line protocol writer into a caller-owned buffer
+ *
+ * One call sequence per line:
+ *
+ *   line_writer_begin(w, "meteo");           // measurement + the device tags
+ *   line_writer_tag(w, "channel", "ch2");    // optional, before any field
+ *   line_writer_float(w, "qnh_hpa", 1015.1, 2);
+ *   line_writer_end(w, timestamp_us);        // " <ns>\n"
+ *
+ * Fields are typed (123i, 1015.10, "ok") so the collector does not convert
+ * strings. Lines are appended; no NUL terminator is written. If the buffer is
+ * too small the writer stops writing and line_writer_end() returns 0.
+ */
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    size_t line_start;
+    const char *tags;   // Pre-escaped ",key=value..." added after every measurement
+    uint8_t fields;     // Fields of the current line
+    bool overflow;
+} line_writer_t;
+
+/**
+ * @param tags Tag set common to every line (see line_writer_escape()), or NULL
+ */
+void line_writer_init(line_writer_t *w, char *buf, size_t size, const char *tags);
+
+void line_writer_begin(line_writer_t *w, const char *measurement);
+void line_writer_tag(line_writer_t *w, const char *key, const char *value);
+
+void line_writer_int(line_writer_t *w, const char *key, int64_t value);
+
+/**
+ * @brief Float field with a fixed number of decimals; NaN and infinities are skipped
+ *        (line protocol cannot represent them)
+ */
+void line_writer_float(line_writer_t *w, const char *key, double value, int decimals);
+
+void line_writer_string(line_writer_t *w, const char *key, const char *value);
+
+/**
+ * @brief Close the line with its timestamp
+ *
+ * @param timestamp_us Microseconds Unix, written in nanoseconds
+ * @return Length of the line including the newline, or 0 if it did not fit or
+ *         has no fields (the partial line is discarded)
+ */
+size_t line_writer_end(line_writer_t *w, int64_t timestamp_us);
+
+/**
+ * @brief Escape a measurement, tag key or tag value (commas, spaces and '=')
+ *
+ * @return Characters written without the NUL, or 0 if dst is too small
+ */
+size_t line_writer_escape(char *dst, size_t size, const char *src);
+
+#endif // CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+
+#endif // __LINE_WRITER_H_
@@ -0,0 +1,59 @@
+#ifndef __LZSS_H_
+#define __LZSS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_ENABLE_BATCH_COMPRESSION
+
+/**
+ * Compressed payload, format 1
+ *
+ *   u8   magic 0xC5 (JSON starts with '{' or '[', binary pburst with 0xB5)
+ *   u8   format (1: LZSS, 1024-byte window, matches of 3..66 bytes)
+ *   u16  uncompressed length, little endian
+ *   bitstream, most significant bit first, zero-padded to a whole byte:
+ *     1 + 8 bits            literal byte
+ *     0 + 10 bits + 6 bits  copy (length - 3) bytes from (distance - 1) back
+ *
+ * Same token layout as heatshrink with window 10 / lookahead 6, but the whole
+ * payload is in memory, so matches are found with a fixed-size hash chain
+ * instead of heatshrink's rolling buffers.
+ */
+
+#define LZSS_PAYLOAD_MAGIC  0xC5
+#define LZSS_PAYLOAD_FORMAT 1
+#define LZSS_HEADER_SIZE    4
+#define LZSS_MAX_INPUT      65534
+
+/**
+ * @brief Compress src into a complete payload (header included)
+ *
+ * Uses about 4 KB of static tables; not reentrant (mss_sender only).
+ *
+ * @return Payload length, or 0 if it does not fit in dst or src is too long
+ */
+size_t lzss_compress(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t len);
+
+/**
+ * @brief Reference decoder
+ *
+ * @param out_len Output: uncompressed length
+ * @return ESP_OK, ESP_ERR_INVALID_VERSION (magic/format), ESP_ERR_INVALID_SIZE
+ *         (truncated, trailing data or dst too small) or ESP_ERR_INVALID_ARG
+ *         (copy before the start of the data)
+ */
+esp_err_t lzss_decompress(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t len, size_t *out_len);
+
+/**
+ * @brief Round-trip self-test on JSON-like, repetitive and random data
+ *
+ * @return ESP_OK if every case passes, ESP_FAIL otherwise (details logged)
+ */
+esp_err_t lzss_self_test(void);
+
+#endif // CONFIG_ENABLE_BATCH_COMPRESSION
+
+#endif // __LZSS_H_
@@ -7,8 +7,69 @@
 #include "mqtt_client.h"
 #include "settings.h"
 
+typedef struct {
+    uint32_t disconnects;       // Broker connections lost since boot
+    uint32_t reconnects;        // Connections recovered
+    uint32_t offline_last_ms;   // Duration of the last outage
+    uint32_t offline_max_ms;    // Longest outage
+    uint32_t offline_now_ms;    // Current outage (0 while connected)
+    uint64_t offline_total_ms;  // Sum of the finished outages
+} mqtt_link_stats_t;
+
 void mqtt_setup(nmda_init_config_t* nmda_config);
-void mqtt_send_mss(char* topic, char* mss);
+bool mqtt_is_connected(void);
+void mqtt_get_link_stats(mqtt_link_stats_t* stats);
+// Return the client msg_id, or -1 if the message was lost. With
+// CONFIG_ENABLE_MQTT_OUTBOX, 0 also when the message was stored in the outbox;
+// with CONFIG_ENABLE_PUBLISH_PIPELINE, 0 when it was queued for the network task.
+int mqtt_send_mss(char* topic, char* mss);
+int mqtt_send_bin(char* topic, const uint8_t* data, size_t len);
+int mqtt_send_acked(char* topic, const uint8_t* data, size_t len);
+#ifdef CONFIG_ENABLE_PUBLISH_PIPELINE
+// Synchronous publication, for the network task of the pipeline only
+int mqtt_publish_now(char* topic, const uint8_t* data, size_t len);
+#endif
+
+// Returned instead of a msg_id when admission refused the message (not logged)
+#define MQTT_SEND_REFUSED (-3)
+
+#ifdef CONFIG_ENABLE_MQTT_ADMISSION
+// Admission priority of a topic, from its last level
+typedef enum {
+    MQTT_PRIORITY_LOW = 0,      // pburst, detect
+    MQTT_PRIORITY_NORMAL,       // stats, meteo, health, timesync, baro, any other
+    MQTT_PRIORITY_HIGH,         // pcnt, alert, influx, status
+    MQTT_PRIORITY_COUNT,
+} mqtt_priority_t;
+
+typedef struct {
+    uint32_t queue_bytes;       // Bytes held now: pipeline ready buffers and the outbox replay in flight
+    uint32_t queue_peak;        // Highest value seen at a publication
+    uint32_t queue_limit;       // CONFIG_MQTT_QUEUE_LIMIT_KB
+} mqtt_admission_stats_t;
+
+void mqtt_get_admission_stats(mqtt_admission_stats_t *stats);
+
+/**
+ * @brief Messages refused for one topic since boot
+ *
+ * @param index 0, 1, ... until NULL is returned
+ * @return Service of the topic ("other" for topics without a priority of their own), or NULL
+ */
+const char *mqtt_admission_refused(size_t index, uint32_t *refused);
+#endif
+
+#ifdef CONFIG_ENABLE_MQTT5_TOPIC_ALIASES
+typedef struct {
+    bool mqtt5;                 // Current (or last) connection uses MQTT 5
+    bool fallback;              // The broker refused MQTT 5: using MQTT 3.1.1
+    uint32_t aliased;           // Publications sent with an empty topic and an alias
+    uint64_t topic_bytes_saved; // Topic bytes those publications did not send
+    uint64_t property_bytes;    // Bytes added by the properties (alias, content type, schema version)
+} mqtt5_stats_t;
+
+void mqtt_get_mqtt5_stats(mqtt5_stats_t *stats);
+#endif
 void mss_sender(void *parameters);
 
 struct mqtt_settings_t {
@@ -0,0 +1,62 @@
+#ifndef __MQTT_TLS_H_
+#define __MQTT_TLS_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_transport.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_ENABLE_MQTT_TLS_RESUMPTION
+
+/**
+ * @brief TLS transport for the MQTT client with session resumption
+ *
+ * Replaces the client's own SSL transport for mqtts. After every successful
+ * handshake the TLS session (session ticket, or session ID when the broker
+ * does not issue tickets) is kept in RAM and offered on the next connection,
+ * so a reconnect costs an abbreviated handshake instead of a full one with
+ * certificate verification and key exchange. A session the broker no longer
+ * accepts just falls back to a full handshake; a failed handshake drops it.
+ *
+ * The session lives in esp-tls structures that hold heap pointers, so it is
+ * not kept across resets: the first connection after a boot is always full.
+ *
+ * All functions except mqtt_tls_get_stats() run in the MQTT client task.
+ */
+
+typedef struct {
+    uint32_t handshakes;        // Successful handshakes
+    uint32_t offered;           // ... of which offered a cached session
+    uint32_t resumed;           // ... of which the broker accepted it (abbreviated handshake)
+    uint32_t failures;          // Failed connections (TCP or TLS)
+    uint32_t full_last_ms;      // Duration of the last full handshake
+    uint32_t resumed_last_ms;   // Duration of the last abbreviated handshake
+    uint32_t heap_last_bytes;   // Internal heap taken during the last handshake, at its peak
+    uint32_t heap_peak_bytes;   // Highest heap_last_bytes
+} mqtt_tls_stats_t;
+
+/**
+ * @brief Create the transport to pass in esp_mqtt_client_config_t.network.transport
+ *
+ * @param ca_cert PEM CA certificate of the broker; must outlive the client
+ * @return The transport (owned and destroyed by the MQTT client), or NULL
+ */
+esp_transport_handle_t mqtt_tls_transport_create(const char *ca_cert);
+
+void mqtt_tls_get_stats(mqtt_tls_stats_t *stats);
+
+/**
+ * @brief esp-tls error of the last failed connection, read or write
+ *
+ * The MQTT client takes the esp-tls codes of MQTT_EVENT_ERROR from its own
+ * transports only, so with this one they are read here instead.
+ *
+ * @param tls_code Output: mbedTLS error code
+ * @param tls_flags Output: certificate verification flags
+ * @return esp-tls error (ESP_ERR_ESP_TLS_* / ESP_ERR_MBEDTLS_*), ESP_OK if none
+ */
+esp_err_t mqtt_tls_get_last_error(int *tls_code, int *tls_flags);
+
+#endif // CONFIG_ENABLE_MQTT_TLS_RESUMPTION
+
+#endif // __MQTT_TLS_H_
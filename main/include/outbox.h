@@ -0,0 +1,85 @@
+#ifndef __OUTBOX_H_
+#define __OUTBOX_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+
+/**
+ * @brief Store-and-forward outbox for publications that could not be sent
+ *
+ * Messages that mqtt_send_mss()/mqtt_send_bin() cannot hand to the MQTT client
+ * (broker or WiFi outage) are appended, with a sequence number, to a ring of
+ * 4 KB sectors in the "outbox" flash partition. After reconnection they are
+ * replayed oldest first at QoS 1, one at a time and at most
+ * CONFIG_OUTBOX_REPLAY_PER_SEC per second, so live traffic keeps priority. A
+ * record is marked delivered in flash only when its PUBACK arrives; until
+ * then it survives resets and power cuts. When the ring is full the oldest
+ * sector is erased and its undelivered records are counted as dropped.
+ *
+ * Only mss_sender publishes, so every function except outbox_on_published()
+ * runs in that task.
+ */
+
+typedef struct {
+    uint32_t pending;           // Records not yet acknowledged
+    uint32_t pending_bytes;     // Their payload bytes
+    uint32_t oldest_age_s;      // Age of the oldest pending record (0 if none)
+    uint32_t stored;            // Records stored since boot
+    uint32_t replayed;          // Records acknowledged since boot
+    uint32_t dropped;           // Pending records lost to ring wrap-around
+    uint32_t too_large;         // Messages larger than a sector, not stored
+    uint32_t errors;            // Flash errors and corrupt records skipped
+    uint32_t capacity_bytes;    // Size of the partition (0 if there is none)
+} outbox_stats_t;
+
+/**
+ * @brief Find the partition and recover the ring left by the previous run
+ *
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND without an "outbox" partition (the
+ *         outbox then stays disabled and outbox_store() fails)
+ */
+esp_err_t outbox_init(void);
+
+/**
+ * @brief Append an unpublished message
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE if it does not fit in a sector,
+ *         ESP_ERR_INVALID_STATE if the outbox is disabled, or a flash error
+ */
+esp_err_t outbox_store(const char *topic, const uint8_t *payload, size_t len);
+
+/**
+ * @brief Acknowledge delivered records and replay the next one when allowed
+ *
+ * @param now_us esp_timer_get_time()
+ */
+void outbox_poll(int64_t now_us);
+
+/**
+ * @brief True while there are records to replay
+ */
+bool outbox_has_pending(void);
+
+/**
+ * @brief Topic and payload bytes of the replayed record awaiting its PUBACK
+ *
+ * The only QoS 1 message the MQTT client holds; 0 when none is in flight.
+ * Safe to call from any task.
+ */
+size_t outbox_inflight_bytes(void);
+
+/**
+ * @brief MQTT_EVENT_PUBLISHED (PUBACK) handler, called from the MQTT task
+ */
+void outbox_on_published(int msg_id);
+
+void outbox_get_stats(outbox_stats_t *stats);
+
+#endif // CONFIG_ENABLE_MQTT_OUTBOX
+
+#endif // __OUTBOX_H_
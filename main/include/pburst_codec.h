@@ -0,0 +1,34 @@
+#ifndef __PBURST_CODEC_H_
+#define __PBURST_CODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "datastructures.h"
+#include "pburst_wire.h"
+
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+
+// Wire format and reference decoder: pburst_wire.h (host-buildable)
+
+/**
+ * @brief Encode a TM_RMT_PULSE_EVENT message
+ *
+ * @return Encoded length, or 0 if buf is too small
+ */
+size_t pburst_encode(uint8_t *buf, size_t size, const struct telemetry_message *message);
+
+/**
+ * @brief Round-trip check of pburst_encode() against the reference decoder
+ *
+ * Run before publishing binary pburst only; the decoder itself, including the
+ * rejection of malformed payloads, is tested on the host (test/pburst_wire).
+ *
+ * @return ESP_OK if every case passes, ESP_FAIL otherwise (details logged)
+ */
+esp_err_t pburst_codec_self_test(void);
+
+#endif // CONFIG_ENABLE_RMT_PULSE_DETECTION
+
+#endif // __PBURST_CODEC_H_
@@ -0,0 +1,102 @@
+#ifndef __PBURST_WIRE_H_
+#define __PBURST_WIRE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Binary pburst payload, version 1 (docs/PBURST_DOCUMENTATION.md)
+ *
+ *   u8      magic 0xB5 (a JSON document always starts with '{')
+ *   u8      version (1)
+ *   u8      channel (1..3)
+ *   uvarint tick resolution in Hz (2000000: 0.5 us per tick)
+ *   svarint start_timestamp: first pulse, microseconds Unix (per-message base)
+ *   uvarint number of pulses
+ *   per pulse:
+ *     uvarint duration in RMT ticks
+ *     svarint separation_us (start-to-start delta to the previous pulse, -1 if unknown)
+ *
+ * uvarint: 7 bits per byte, least significant group first, bit 7 set on all
+ * but the last byte (LEB128). svarint: zig-zag mapping (0,-1,1,-2.. -> 0,1,2,3..)
+ * followed by uvarint, so -1 takes a single byte.
+ *
+ * Messages are self-delimiting, so a batch (CONFIG_ENABLE_PUBLISH_BATCHING) is
+ * several of them back to back; read it with pburst_decode_next().
+ *
+ * Plain C99 with no ESP-IDF types: this file and pburst_wire.c are the
+ * reference decoder for backend consumers and build on a host as they are
+ * (see test/pburst_wire).
+ */
+
+#define PBURST_BIN_MAGIC   0xB5
+#define PBURST_BIN_VERSION 1
+
+// Worst case: 3 fixed bytes + 5 + 10 + 2 header varints, then 3 + 10 per pulse
+#define PBURST_BIN_MAX_SIZE(pulses) (20 + 13 * (size_t)(pulses))
+
+typedef enum {
+    PBURST_OK = 0,
+    PBURST_ERR_VERSION,     // Unknown magic or version
+    PBURST_ERR_SIZE,        // Truncated, trailing bytes or more pulses than the output holds
+    PBURST_ERR_FIELD,       // Malformed varint or field out of range
+} pburst_status_t;
+
+typedef struct {
+    uint8_t channel;           // 1..3
+    uint32_t resolution_hz;    // Tick resolution of the durations
+    int64_t start_timestamp;   // Microseconds Unix
+    uint8_t num_pulses;
+} pburst_bin_header_t;
+
+typedef struct {
+    uint16_t duration_ticks;   // Duration in ticks of resolution_hz
+    uint32_t duration_us;      // duration_ticks / ticks-per-microsecond, as the firmware computes it
+    int64_t separation_us;     // Start-to-start delta to the previous pulse, -1 if unknown
+} pburst_pulse_t;
+
+// Appends at len and sets overflow instead of writing past size
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+} pburst_writer_t;
+
+void pburst_writer_init(pburst_writer_t *w, uint8_t *buf, size_t size);
+
+/**
+ * @brief Write the header; then exactly header->num_pulses pburst_write_pulse() calls
+ */
+void pburst_write_header(pburst_writer_t *w, const pburst_bin_header_t *header);
+
+void pburst_write_pulse(pburst_writer_t *w, uint16_t duration_ticks, int64_t separation_us);
+
+/**
+ * @brief Encoded length, or 0 if the buffer was too small
+ */
+size_t pburst_writer_finish(const pburst_writer_t *w);
+
+/**
+ * @brief Reference decoder
+ *
+ * @param pulses Output array of at least max_pulses elements
+ * @return PBURST_OK or the reason the payload was rejected
+ */
+pburst_status_t pburst_decode(const uint8_t *buf, size_t len, pburst_bin_header_t *header,
+                              pburst_pulse_t *pulses, size_t max_pulses);
+
+/**
+ * @brief Decode the first message of a batch
+ *
+ * Same as pburst_decode() but bytes after the message are allowed.
+ *
+ * @param consumed Output: length of the decoded message
+ */
+pburst_status_t pburst_decode_next(const uint8_t *buf, size_t len, size_t *consumed,
+                                   pburst_bin_header_t *header, pburst_pulse_t *pulses, size_t max_pulses);
+
+const char *pburst_status_name(pburst_status_t status);
+
+#endif // __PBURST_WIRE_H_
@@ -0,0 +1,136 @@
+#ifndef __PUBLISH_BATCH_H_
+#define __PUBLISH_BATCH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef CONFIG_ENABLE_PUBLISH_BATCHING
+
+/**
+ * @brief Why a batch was published
+ */
+typedef enum {
+    PUBLISH_BATCH_FLUSH_SIZE = 0,  // The next record did not fit in the byte budget
+    PUBLISH_BATCH_FLUSH_DELAY,     // The oldest record reached the maximum delay
+    PUBLISH_BATCH_FLUSH_FORCED,    // publish_batch_flush() (e.g. a pcnt window closes the batch)
+    PUBLISH_BATCH_FLUSH_REASONS
+} publish_batch_flush_t;
+
+/**
+ * @brief Batch payload layout
+ */
+typedef enum {
+    PUBLISH_BATCH_JSON_ARRAY = 0,  // JSON documents joined as "[doc,doc,...]"
+    PUBLISH_BATCH_CONCAT,          // Self-delimiting binary records back to back
+    PUBLISH_BATCH_LINES,           // Newline-terminated text lines (line protocol), published as text
+} publish_batch_format_t;
+
+/**
+ * @brief Counters of a batch since boot (see {base}/stats)
+ */
+typedef struct {
+    uint32_t batches;                             // Payloads published
+    uint32_t records;                             // Records in those payloads
+    uint32_t max_records;                         // Largest batch (records)
+    uint32_t flushes[PUBLISH_BATCH_FLUSH_REASONS];
+    uint32_t failed;                              // Payloads neither published nor kept in the outbox
+    uint32_t lost_records;                        // Records in those payloads
+    uint32_t stored;                              // Payloads the client refused, kept in the outbox
+    uint64_t bytes;                               // Payload bytes published
+    uint64_t delay_sum_us;                        // Sum of the wait of the oldest record of each batch
+    uint32_t delay_max_us;                        // Longest wait of an oldest record
+#ifdef CONFIG_ENABLE_BATCH_COMPRESSION
+    // Batches sent compressed, or a sample of them to measure the gain when not
+    uint32_t lz_batches;                          // Batches run through the compressor
+    uint32_t lz_incompressible;                   // Batches that did not get smaller
+    uint64_t lz_in_bytes;                         // Uncompressed bytes of those batches
+    uint64_t lz_out_bytes;                        // Their size after compression (raw size if it did not shrink)
+    uint64_t lz_cpu_us;                           // Time spent compressing
+#endif
+} publish_batch_stats_t;
+
+/**
+ * @brief Accumulates the records of one topic into a single MQTT payload
+ *
+ * Owned by mss_sender; not thread-safe.
+ */
+typedef struct {
+    char *topic;
+    publish_batch_format_t format;
+    uint8_t *buf;
+    size_t budget;        // Payload size limit (bytes)
+    size_t len;
+    uint32_t records;
+    int64_t first_us;     // esp_timer time at which the oldest pending record was added
+    int64_t max_delay_us;
+    bool compress;        // Publish compressed payloads (CONFIG_ENABLE_BATCH_COMPRESSION)
+    int last_msg_id;      // Result of the last flush, as returned by publish_batch_flush()
+#ifdef CONFIG_ENABLE_BATCH_COMPRESSION
+    uint32_t lz_flushes;  // Flushes while not compressing, to pick the sampled ones
+#endif
+    publish_batch_stats_t stats;
+} publish_batch_t;
+
+/**
+ * @brief Set up an empty batch
+ *
+ * @param buf Payload buffer of budget bytes, owned by the caller
+ * @param compress Publish LZSS-compressed batches when they get smaller; ignored
+ *                 without CONFIG_ENABLE_BATCH_COMPRESSION
+ */
+void publish_batch_init(publish_batch_t *batch, char *topic, publish_batch_format_t format,
+                        uint8_t *buf, size_t budget, uint32_t max_delay_ms, bool compress);
+
+/**
+ * @brief Append one record (a JSON document or a binary record)
+ *
+ * If the record does not fit in the remaining budget the pending batch is
+ * published first. A record larger than the whole budget is published alone.
+ *
+ * @param now_us esp_timer_get_time()
+ */
+void publish_batch_add(publish_batch_t *batch, const void *record, size_t len, int64_t now_us);
+
+/**
+ * @brief Free space at the end of the batch, to serialize a record in place
+ *
+ * The record is written at the returned pointer (at most *room bytes) and
+ * accounted with publish_batch_commit(). Not for PUBLISH_BATCH_JSON_ARRAY,
+ * which frames each record.
+ */
+uint8_t *publish_batch_tail(publish_batch_t *batch, size_t *room);
+
+/**
+ * @brief Account a record of len bytes written at publish_batch_tail()
+ */
+void publish_batch_commit(publish_batch_t *batch, size_t len, int64_t now_us);
+
+/**
+ * @brief Publish the pending batch now
+ *
+ * @return MQTT message id, 0 if the batch was empty, -1 if the client refused it
+ */
+int publish_batch_flush(publish_batch_t *batch, publish_batch_flush_t reason, int64_t now_us);
+
+/**
+ * @brief Publish the pending batch if its oldest record has waited max_delay
+ */
+void publish_batch_poll(publish_batch_t *batch, int64_t now_us);
+
+/**
+ * @brief esp_timer time at which the pending batch must be published
+ *
+ * @return INT64_MAX if the batch is empty
+ */
+int64_t publish_batch_deadline_us(const publish_batch_t *batch);
+
+/**
+ * @brief Name of a flush reason as published on the stats topic
+ */
+const char *publish_batch_flush_name(publish_batch_flush_t reason);
+
+#endif // CONFIG_ENABLE_PUBLISH_BATCHING
+
+#endif // __PUBLISH_BATCH_H_
@@ -0,0 +1,91 @@
+#ifndef __PUBLISH_PIPELINE_H_
+#define __PUBLISH_PIPELINE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_ENABLE_PUBLISH_PIPELINE
+
+/**
+ * @brief Network stage of the publication pipeline
+ *
+ * mss_sender serializes on the acquisition core; mqtt_send_mss() and
+ * mqtt_send_bin() then copy topic and payload into one telemetry pool block
+ * (a ready buffer) and queue it here instead of writing to the socket. The
+ * "MQTT publish" task, pinned to core 0 next to the WiFi stack, hands the
+ * buffers to the MQTT client in order and returns them to the pool, so a slow
+ * TLS write stalls this task and not the serializer. When the queue is full
+ * the serializer waits (backpressure towards the telemetry rings, which
+ * drop by stream priority) for at most CONFIG_PUBLISH_PIPELINE_SUBMIT_TIMEOUT_MS.
+ *
+ * With CONFIG_ENABLE_MQTT_OUTBOX the replay of the outbox also runs in this
+ * task, which is then the only one that touches the client and the outbox.
+ */
+
+typedef struct {
+    uint32_t submitted;         // Buffers queued by the serializer
+    uint32_t published;         // Buffers the client accepted (or the outbox stored)
+    uint32_t failed;            // Buffers the client refused
+    uint32_t dropped;           // Not queued: no pool block or queue still full after the timeout
+    uint32_t depth;             // Buffers waiting now
+    uint32_t depth_max;         // Highest depth seen
+    uint32_t capacity;          // CONFIG_PUBLISH_PIPELINE_DEPTH
+    uint32_t bytes;             // Payload bytes waiting now
+    uint32_t bytes_max;         // Highest value of bytes
+    uint32_t wait_max_us;       // Longest time a buffer waited in the queue
+    uint64_t wait_sum_us;       // Sum of the queue waits of the published buffers
+    uint64_t submit_block_us;   // Time the serializer spent waiting for room
+    uint64_t busy_us;           // Time the network stage spent inside the client
+} publish_pipeline_stats_t;
+
+/**
+ * @brief Create the queue and the network task
+ *
+ * Until it is called mqtt_send_mss()/mqtt_send_bin() publish synchronously.
+ */
+esp_err_t publish_pipeline_start(void);
+
+/**
+ * @brief True once publish_pipeline_start() succeeded
+ */
+bool publish_pipeline_running(void);
+
+/**
+ * @brief Copy a publication into a ready buffer and queue it
+ *
+ * @return 0 if queued, -1 if it was dropped
+ */
+int publish_pipeline_submit(const char *topic, const void *data, size_t len);
+
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+/**
+ * @brief Mark a pcnt window as published once the network task has sent it
+ *
+ * Queued right after the publication that carries the window: the network
+ * task calls rtc_window_ring_mark_published() only if the client (or the
+ * outbox) took that publication, so a window lost in the network stage is
+ * still replayed from RTC memory.
+ *
+ * @return 0 if queued, -1 if not (the window stays pending)
+ */
+int publish_pipeline_mark_window(uint32_t seq);
+
+/**
+ * @brief Window markers the network task has not dealt with yet
+ */
+uint32_t publish_pipeline_windows_queued(void);
+#endif
+
+/**
+ * @brief Payload bytes queued and not yet handed to the client, from any task
+ */
+size_t publish_pipeline_bytes(void);
+
+void publish_pipeline_get_stats(publish_pipeline_stats_t *stats);
+
+#endif // CONFIG_ENABLE_PUBLISH_PIPELINE
+
+#endif // __PUBLISH_PIPELINE_H_
@@ -16,5 +16,12 @@
 esp_err_t pulse_counter_init(int channel_index, int pulse_gpio_num);
 esp_err_t pulse_counter_deinit(int channel_index);
 int16_t get_and_clear(int channel_index);
+int16_t get_count(int channel_index);  // Lectura sin limpiar (cuentas de 1 s del detector GLE)
+
+#ifdef CONFIG_ENABLE_PCNT_GATE
+// Contadores con gate (veto/ventana) en paralelo a los contadores totales
+bool pulse_counter_has_gate(int channel_index);
+int16_t get_and_clear_gated(int channel_index);
+#endif
 
 #endif
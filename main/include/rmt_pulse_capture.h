@@ -1,6 +1,7 @@
 #ifndef __RMT_PULSE_CAPTURE_H_
 #define __RMT_PULSE_CAPTURE_H_
 
+#include <stdbool.h>
 #include "esp_err.h"
 #include "driver/rmt_rx.h"
 #include "freertos/FreeRTOS.h"
@@ -8,6 +9,9 @@
 
 #ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
 
+// Resolución del RMT RX: 2 MHz = 500 ns por tick (permite símbolos de hasta ~32.7 ms)
+#define RMT_PULSE_RESOLUTION_HZ 2000000
+
 // Estructura para eventos de pulso capturados por RMT
 struct rmt_pulse_event {
     uint8_t channel;           // Canal (0, 1, o 2)
@@ -44,6 +48,37 @@ esp_err_t rmt_pulse_capture_deinit(void);
  */
 QueueHandle_t rmt_pulse_capture_get_event_queue(void);
 
+/**
+ * @brief Cerrar la ventana PCNT actual para el contraste PCNT/RMT
+ * 
+ * Los pulsos capturados por RMT que empiezan antes de boundary_us cuentan para la
+ * ventana que se cierra; los posteriores, para la siguiente.
+ * 
+ * @param boundary_us Fin de la ventana en microsegundos desde el arranque (esp_timer)
+ */
+void rmt_pulse_capture_close_window(int64_t boundary_us);
+
+/**
+ * @brief Obtener los pulsos RMT de la ventana cerrada y empezar la siguiente
+ * 
+ * Debe llamarse tras rmt_pulse_capture_close_window(), dejando tiempo para que el
+ * RMT entregue los grupos de pulsos que aún estaban abiertos en el límite.
+ * 
+ * @param counts Pulsos contados por RMT en la ventana, por canal (ch1, ch2, ch3)
+ */
+void rmt_pulse_capture_collect_window(uint32_t counts[3]);
+
+/**
+ * @brief Poner en cuarentena (o liberar) la captura RMT de un canal
+ * 
+ * Un canal en cuarentena deja de rearmarse tras completar la recepción en curso y
+ * sus grupos pendientes no se publican. PCNT sigue contando normalmente.
+ * 
+ * @param channel_index Índice del canal (0, 1, 2)
+ * @param quarantined true para deshabilitar la captura, false para reanudarla
+ */
+void rmt_pulse_capture_set_channel_quarantine(int channel_index, bool quarantined);
+
 /**
  * @brief Tarea de procesamiento de eventos RMT
  * 
@@ -0,0 +1,98 @@
+#ifndef __RTC_WINDOW_RING_H_
+#define __RTC_WINDOW_RING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+
+/**
+ * @brief One PCNT integration window as kept in RTC slow memory
+ */
+typedef struct {
+    uint32_t seq;                   // Window sequence number (monotonic across warm resets)
+    uint32_t published;             // 1 once the window has been handed to MQTT
+    int64_t start_timestamp;        // Window start (microseconds Unix)
+    int64_t end_timestamp;          // Window end (microseconds Unix)
+    uint32_t channel[3];            // Counts per channel (ch1, ch2, ch3)
+#ifdef CONFIG_ENABLE_PCNT_GATE
+    uint32_t gated[3];              // Gated counts per channel
+#endif
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+    uint32_t rmt[3];                // RMT-captured pulses in the same window
+#endif
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+    float pressure_hpa;             // Mean pressure of the window (NAN if no samples)
+    float baro_beta;                // Barometric coefficient used (1/hPa)
+    float baro_p0_hpa;              // Reference pressure used (hPa)
+#endif
+    uint32_t integration_time_sec;  // Window length in seconds
+} rtc_window_record_t;
+
+/**
+ * @brief Validate the RTC ring left by the previous run
+ *
+ * Must be called once at boot, before task_pcnt starts. If the magic or the
+ * CRC do not match (cold boot, brown-out, layout change) the ring is reset
+ * and sequence numbers start again from 0. Otherwise the records that were
+ * never published survive and can be replayed with rtc_window_ring_get_pending().
+ *
+ * @return ESP_OK if the previous ring was valid, ESP_ERR_INVALID_CRC if it was reset
+ */
+esp_err_t rtc_window_ring_init(void);
+
+/**
+ * @brief Store a closed window in the ring, overwriting the oldest record when full
+ *
+ * @param record Window to store; its seq field is ignored and assigned here
+ * @return Sequence number assigned to the window
+ */
+uint32_t rtc_window_ring_push(const rtc_window_record_t *record);
+
+/**
+ * @brief Mark a window as published so it is not replayed after a reset
+ *
+ * @param seq Sequence number returned by rtc_window_ring_push()
+ */
+void rtc_window_ring_mark_published(uint32_t seq);
+
+/**
+ * @brief Get the oldest window that has not been published yet
+ *
+ * The record stays in the ring until rtc_window_ring_mark_published() is called.
+ *
+ * @param after_seq Only consider windows with a sequence number greater than this
+ *                  (use -1 to start from the oldest)
+ * @param record Output record
+ * @return true if a pending window was found
+ */
+bool rtc_window_ring_get_pending(int64_t after_seq, rtc_window_record_t *record);
+
+/**
+ * @brief Sequence number of the first window of this boot
+ *
+ * Pending windows with a lower number were closed before the last reset.
+ */
+uint32_t rtc_window_ring_boot_seq(void);
+
+/**
+ * @brief Convert the esp_timer timestamps of this boot to Unix time
+ *
+ * Called once the time is synchronized (see timebase.h), so that windows
+ * closed earlier can still be replayed after a reset. At boot, pending
+ * windows that were never converted are discarded.
+ *
+ * @return Number of windows converted
+ */
+uint32_t rtc_window_ring_backfill(void);
+
+/**
+ * @brief Number of windows that have not been published yet
+ */
+uint32_t rtc_window_ring_pending_count(void);
+
+#endif // CONFIG_ENABLE_RTC_WINDOW_RING
+
+#endif // __RTC_WINDOW_RING_H_
@@ -7,6 +7,10 @@ typedef struct {
     char* wifi_essid;
     char* wifi_password;
     char* wifi_ntp_server;
+    char* wifi_static_ip;
+    char* wifi_netmask;
+    char* wifi_gateway;
+    char* wifi_dns;
     char* mqtt_server;
     char* mqtt_port;
     char* mqtt_user;
@@ -16,12 +20,21 @@ typedef struct {
     char* mqtt_station;
     char* mqtt_experiment;
     char* mqtt_device_id;
+    char* pburst_format;
+    char* batch_compression;
+    char* telemetry_format;
+    char* baro_beta;
+    char* baro_p0;
 } nmda_init_config_t;
 
 #define NMDA_INIT_CONFIG_DEFAULT() {\
     .wifi_essid = "default",\
     .wifi_password = "default",\
     .wifi_ntp_server = "default",\
+    .wifi_static_ip = (char*)NULL,\
+    .wifi_netmask = (char*)NULL,\
+    .wifi_gateway = (char*)NULL,\
+    .wifi_dns = (char*)NULL,\
     .mqtt_server = "default",\
     .mqtt_port = "default",\
     .mqtt_user = "default",\
@@ -30,7 +43,12 @@ typedef struct {
     .mqtt_ca_cert = (char*)NULL,\
     .mqtt_station = "default",\
     .mqtt_experiment = "default",\
-    .mqtt_device_id = "default"\
+    .mqtt_device_id = "default",\
+    .pburst_format = (char*)NULL,\
+    .batch_compression = (char*)NULL,\
+    .telemetry_format = (char*)NULL,\
+    .baro_beta = (char*)NULL,\
+    .baro_p0 = (char*)NULL\
 }; 
 
 
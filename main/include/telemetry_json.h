@@ -0,0 +1,37 @@
+#ifndef __TELEMETRY_JSON_H_
+#define __TELEMETRY_JSON_H_
+
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "datastructures.h"
+#include "json_writer.h"
+
+/**
+ * @brief Hand-written JSON documents of the telemetry topics
+ *
+ * The flat message types (detect, timesync, meteo, health) are encoded from
+ * their TM_SCHEMA_* table by telemetry_schema_json(). Each function writes
+ * one message into the writer (initialised by the caller on its reusable
+ * buffer) and returns the finished document, or NULL if it did not fit. The
+ * documents are byte-identical to the former cJSON output. The layouts are
+ * described in docs/MQTT_TOPICS_SCHEMA.md.
+ */
+
+const char *telemetry_json_pulse_count(json_writer_t *w, const struct telemetry_message *message);
+
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+const char *telemetry_json_pburst(json_writer_t *w, const struct telemetry_message *message);
+#endif
+
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+/**
+ * @param publish_us esp_timer time of publication, for the latency fields
+ */
+const char *telemetry_json_gle_alert(json_writer_t *w, const struct telemetry_message *message, int64_t publish_us);
+#endif
+
+#ifdef CONFIG_ENABLE_BARO_FIT
+const char *telemetry_json_baro_fit(json_writer_t *w, const struct telemetry_message *message);
+#endif
+
+#endif // __TELEMETRY_JSON_H_
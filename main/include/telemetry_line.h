@@ -0,0 +1,24 @@
+#ifndef __TELEMETRY_LINE_H_
+#define __TELEMETRY_LINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "datastructures.h"
+#include "line_writer.h"
+
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+
+/**
+ * @brief Hand-written line protocol encoders (telemetry_format=influx)
+ *
+ * Same contract as telemetry_schema_line(): one line appended to the writer,
+ * its length returned, 0 if it did not fit. Field keys are those of the JSON
+ * documents; the JSON datetime becomes the line timestamp.
+ */
+
+size_t telemetry_line_pulse_count(line_writer_t *w, const struct telemetry_message *message);
+
+#endif // CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+
+#endif // __TELEMETRY_LINE_H_
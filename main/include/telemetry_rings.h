@@ -0,0 +1,87 @@
+#ifndef __TELEMETRY_RINGS_H_
+#define __TELEMETRY_RINGS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "datastructures.h"
+
+/**
+ * @brief Telemetry streams, one bounded ring each
+ *
+ * Every stream has a single producer (task or ISR) and mss_sender as the only
+ * consumer, so the rings are lock-free single-producer/single-consumer FIFOs.
+ * Order is preserved within a stream, not across streams.
+ */
+typedef enum {
+    TELEMETRY_STREAM_ALERT = 0,  // GLE alerts (task_pcnt); strict priority
+    TELEMETRY_STREAM_PCNT,       // PCNT windows (task_pcnt)
+    TELEMETRY_STREAM_HEALTH,     // Channel health and beta fit (task_pcnt)
+    TELEMETRY_STREAM_METEO,      // SPL06 readings (spl06_monitor_task)
+    TELEMETRY_STREAM_PBURST,     // RMT pulse groups (task_rmt_event_processor)
+    TELEMETRY_STREAM_DETECT,     // GPIO edge detections (GPIO ISR)
+    TELEMETRY_STREAM_COUNT
+} telemetry_stream_t;
+
+/**
+ * @brief Per-stream counters
+ */
+typedef struct {
+    uint32_t pushed;      // Messages accepted
+    uint32_t dropped;     // Messages refused because the ring was full
+    uint32_t high_water;  // Highest occupancy seen
+    uint32_t capacity;    // Ring size
+} telemetry_ring_stats_t;
+
+/**
+ * @brief Reset all rings; must be called before any producer starts
+ */
+void telemetry_rings_init(void);
+
+/**
+ * @brief Register the consumer task that telemetry_rings_receive() wakes up
+ */
+void telemetry_rings_set_consumer(TaskHandle_t consumer);
+
+/**
+ * @brief Push a message on a stream (task context, never blocks)
+ *
+ * @return true if queued, false if the ring is full (drop counted)
+ */
+bool telemetry_ring_push(telemetry_stream_t stream, const struct telemetry_message *message);
+
+/**
+ * @brief Push a message on a stream from an ISR
+ *
+ * @param higher_priority_task_woken Set to pdTRUE if the consumer must run
+ * @return true if queued, false if the ring is full (drop counted)
+ */
+bool telemetry_ring_push_from_isr(telemetry_stream_t stream, const struct telemetry_message *message,
+                                  BaseType_t *higher_priority_task_woken);
+
+/**
+ * @brief Take the next message for publication (consumer only)
+ *
+ * The alert stream is always drained first. The other streams are served by
+ * weighted round robin in priority order (pcnt, health, meteo, pburst, detect),
+ * so a pulse flood cannot starve the low-rate streams.
+ *
+ * @param message Output message
+ * @param timeout Maximum time to wait for a message
+ * @return true if a message was returned, false on timeout
+ */
+bool telemetry_rings_receive(struct telemetry_message *message, TickType_t timeout);
+
+/**
+ * @brief Snapshot of the counters of a stream
+ */
+void telemetry_ring_get_stats(telemetry_stream_t stream, telemetry_ring_stats_t *stats);
+
+/**
+ * @brief Short name of a stream ("alert", "pcnt", ...), used in the stats message
+ */
+const char *telemetry_stream_name(telemetry_stream_t stream);
+
+#endif // __TELEMETRY_RINGS_H_
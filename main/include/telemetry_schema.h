@@ -0,0 +1,103 @@
+#ifndef __TELEMETRY_SCHEMA_H_
+#define __TELEMETRY_SCHEMA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "datastructures.h"
+#include "json_writer.h"
+#include "line_writer.h"
+
+/**
+ * @brief Registry of the published message types
+ *
+ * One entry per TM_* type: the service (last topic level), its JSON
+ * encoder and, with CONFIG_ENABLE_INFLUX_LINE_PROTOCOL, its line protocol
+ * encoder. The flat types are described by the TM_SCHEMA_* tables of
+ * datastructures.h, which also generate their struct; their JSON and line
+ * protocol encoders are table-driven. pcnt, pburst, alert and baro have hand-written
+ * encoders (derived fields, variable-length pulses, publication latency,
+ * skipped NaN estimates) and no field table.
+ */
+
+// Field storage types, from the C type of the TM_SCHEMA_* line
+typedef enum {
+    TM_FIELD_U8 = 0,
+    TM_FIELD_U32,
+    TM_FIELD_I64,
+    TM_FIELD_F32,
+} tm_field_type_t;
+
+// JSON rendering of a field (see datastructures.h)
+typedef enum {
+    TM_JSON_UINT = 0,
+    TM_JSON_FLOAT,
+    TM_JSON_CHANNEL,
+    TM_JSON_FLAG,
+    TM_JSON_HEALTH_STATE,
+} tm_json_style_t;
+
+typedef struct {
+    const char *key;
+    uint16_t offset;    // In struct telemetry_message
+    uint8_t type;       // tm_field_type_t
+    uint8_t count;      // 1 for scalars
+    uint8_t style;      // tm_json_style_t
+    uint8_t decimals;   // TM_JSON_FLOAT only
+} tm_field_t;
+
+typedef const char *(*telemetry_json_fn_t)(json_writer_t *w, const struct telemetry_message *message);
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+typedef size_t (*telemetry_line_fn_t)(line_writer_t *w, const struct telemetry_message *message);
+#endif
+
+typedef struct {
+    uint8_t type;               // TM_*
+    const char *service;        // Topic {station}/{experiment}/{device}/{service}
+    const tm_field_t *fields;   // NULL for hand-written encoders
+    uint8_t field_count;
+    telemetry_json_fn_t json;
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+    telemetry_line_fn_t line;   // NULL: always published as JSON
+#endif
+} telemetry_schema_t;
+
+// Upper bound of the registry size, for callers that keep per-entry state
+#define TELEMETRY_SCHEMA_MAX 12
+
+extern const telemetry_schema_t telemetry_schemas[];
+extern const size_t telemetry_schema_count;
+
+/**
+ * @brief Registry entry of a message type, or NULL if the type is not published
+ */
+const telemetry_schema_t *telemetry_schema_find(uint8_t type);
+
+/**
+ * @brief Table-driven JSON document of a flat message type
+ *
+ * Same contract as the telemetry_json_* functions.
+ */
+const char *telemetry_schema_json(json_writer_t *w, const struct telemetry_message *message);
+
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+/**
+ * @brief Table-driven line protocol of a flat message type
+ *
+ * Measurement = service. TM_JSON_CHANNEL fields become tags, health states
+ * string fields and every other field an integer or float field.
+ *
+ * @return Length of the line appended to the writer, or 0 if it did not fit
+ */
+size_t telemetry_schema_line(line_writer_t *w, const struct telemetry_message *message);
+#endif
+
+/**
+ * @brief JSON and line protocol encoding of every flat type
+ *
+ * @return ESP_OK if every case passes, ESP_FAIL otherwise (details logged)
+ */
+esp_err_t telemetry_schema_self_test(void);
+
+#endif // __TELEMETRY_SCHEMA_H_
@@ -0,0 +1,108 @@
+#ifndef __TIMEBASE_H_
+#define __TIMEBASE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+/**
+ * @brief Time base of the telemetry timestamps
+ *
+ * Acquisition starts before WiFi and SNTP are up. Until the first SNTP
+ * synchronization the producers stamp messages with esp_timer time
+ * (microseconds since boot); afterwards with Unix time. Both kinds are told
+ * apart by magnitude: no esp_timer value reaches TIMEBASE_UNIX_MIN_US. When
+ * the time is synchronized, timebase_to_unix_us() turns an early timestamp
+ * into Unix time with the offset measured at synchronization, so mss_sender
+ * can backfill the messages it held back.
+ *
+ * With CONFIG_ENABLE_RTC_WALL_CLOCK the last SNTP time is also anchored to the
+ * RTC timer in RTC memory. After a warm reset timebase_init() restores it as a
+ * provisional time: producers still stamp esp_timer time, but mss_sender can
+ * convert and publish at once, flagging the messages as provisional. The first
+ * SNTP synchronization then confirms or corrects it.
+ */
+
+typedef enum {
+    TIMEBASE_NONE = 0,          // No wall-clock time yet
+    TIMEBASE_PROVISIONAL,       // Restored from the RTC clock after a warm reset
+    TIMEBASE_SYNCED,            // SNTP synchronized
+} timebase_state_t;
+
+typedef struct {
+    timebase_state_t state;
+    uint32_t confidence;            // Consecutive syncs that confirmed the RTC clock
+    uint32_t provisional_error_ms;  // Error bound of the provisional time at boot (0 if none)
+    int32_t correction_ms;          // SNTP minus provisional time at the first sync
+} timebase_stats_t;
+
+// 2020-01-01T00:00:00Z. Any timestamp below it is esp_timer time
+#define TIMEBASE_UNIX_MIN_US 1577836800000000LL
+
+/**
+ * @brief Restore the provisional time after a warm reset
+ *
+ * Call once at boot, before the producers start.
+ */
+void timebase_init(void);
+
+/**
+ * @brief Record the esp_timer/Unix offset; called on every SNTP synchronization
+ *
+ * Only the first call sets the offset used for backfill; every call
+ * re-anchors the RTC clock.
+ */
+void timebase_on_sync(void);
+
+timebase_state_t timebase_state(void);
+
+/**
+ * @brief True once the time has been synchronized
+ */
+bool timebase_is_synced(void);
+
+/**
+ * @brief Current time: Unix microseconds once synchronized, esp_timer before
+ */
+int64_t timebase_now_us(void);
+
+/**
+ * @brief Best current estimate of Unix time, provisional included
+ *
+ * esp_timer time while the state is TIMEBASE_NONE. For alignment only:
+ * timestamps come from timebase_now_us().
+ */
+int64_t timebase_wall_now_us(void);
+
+/**
+ * @brief Stamp an instant measured with esp_timer_get_time()
+ *
+ * @return Unix microseconds once synchronized, boot_us unchanged before
+ */
+int64_t timebase_from_boot_us(int64_t boot_us);
+
+/**
+ * @brief Backfill: convert an esp_timer timestamp of this boot to Unix time
+ *
+ * Uses the provisional offset while the time is provisional. Unix
+ * timestamps are returned unchanged, and so is everything while the time is
+ * unknown.
+ */
+int64_t timebase_to_unix_us(int64_t timestamp_us);
+
+/**
+ * @brief True if the timestamp is Unix time (not esp_timer time)
+ */
+static inline bool timebase_is_unix(int64_t timestamp_us)
+{
+    return timestamp_us >= TIMEBASE_UNIX_MIN_US;
+}
+
+/**
+ * @brief Microseconds between two timestamps of any kind (b - a)
+ */
+int64_t timebase_elapsed_us(int64_t a_us, int64_t b_us);
+
+void timebase_get_stats(timebase_stats_t *stats);
+
+#endif // __TIMEBASE_H_
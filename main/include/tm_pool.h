@@ -0,0 +1,80 @@
+#ifndef __TM_POOL_H_
+#define __TM_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Preallocated slab allocator for telemetry payloads
+ *
+ * Four fixed size classes (64, 256, 1040 and 4096 bytes) carved out of static
+ * arenas at link time, so RMT pulse groups, pulse arrays and JSON buffers
+ * never go through the general heap at burst rate and cannot fragment it.
+ * A request is served from the smallest class that fits and never from a
+ * larger one, so small requests cannot drain the large blocks. Block counts
+ * are set in menuconfig (CONFIG_TM_POOL_CLASSx_BLOCKS).
+ *
+ * Allocation and release are O(1) free-list operations inside a portMUX
+ * critical section, valid from task and ISR context.
+ */
+
+#define TM_POOL_CLASSES 4
+
+/**
+ * @brief Counters of one size class
+ */
+typedef struct {
+    uint32_t block_size;  // Bytes per block
+    uint32_t blocks;      // Blocks in the class
+    uint32_t in_use;      // Blocks currently allocated
+    uint32_t high_water;  // Highest in_use seen
+    uint32_t allocs;      // Successful allocations from this class
+    uint32_t exhausted;   // Requests for this class that found it empty
+} tm_pool_class_stats_t;
+
+/**
+ * @brief Global counters
+ */
+typedef struct {
+    uint32_t heap_fallback;  // Task allocations served by the heap (too big or class empty)
+    uint32_t failed;         // Allocations that returned NULL
+} tm_pool_stats_t;
+
+/**
+ * @brief Allocate a block (task context)
+ *
+ * Falls back to heap_caps_malloc(MALLOC_CAP_INTERNAL) when the request is too
+ * big for every class or its class is exhausted; the fallback is counted so
+ * pools can be resized.
+ *
+ * @return Block of at least size bytes, 8-byte aligned, or NULL
+ */
+void *tm_pool_alloc(size_t size);
+
+/**
+ * @brief Allocate a block from an ISR
+ *
+ * Same as tm_pool_alloc() but never touches the heap: NULL when its class is
+ * exhausted or no class fits.
+ */
+void *tm_pool_alloc_from_isr(size_t size);
+
+/**
+ * @brief Release a block from tm_pool_alloc() or tm_pool_alloc_from_isr()
+ *
+ * Safe from task and ISR context for pool blocks. Pointers outside the pool
+ * arenas (heap fallback) are passed to heap_caps_free(). NULL is ignored.
+ */
+void tm_pool_free(void *ptr);
+
+/**
+ * @brief Snapshot of the counters of a size class
+ */
+void tm_pool_get_class_stats(int class_index, tm_pool_class_stats_t *stats);
+
+/**
+ * @brief Snapshot of the global counters
+ */
+void tm_pool_get_stats(tm_pool_stats_t *stats);
+
+#endif // __TM_POOL_H_
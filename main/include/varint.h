@@ -0,0 +1,79 @@
+#ifndef __VARINT_H_
+#define __VARINT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * LEB128 varints and zig-zag mapping shared by the binary telemetry encodings
+ *
+ * uvarint: 7 bits per byte, least significant group first, bit 7 set on all
+ * but the last byte. svarint: zig-zag (0,-1,1,-2.. -> 0,1,2,3..) then uvarint.
+ *
+ * Writers append at *len and set *overflow instead of writing past size, so a
+ * whole message can be written and checked once at the end.
+ */
+
+#define VARINT_MAX_BYTES 10
+
+static inline uint64_t varint_zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t varint_unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static inline void varint_put_byte(uint8_t *buf, size_t size, size_t *len, bool *overflow, uint8_t b)
+{
+    if (*len >= size) {
+        *overflow = true;
+        return;
+    }
+    buf[(*len)++] = b;
+}
+
+static inline void varint_put_u(uint8_t *buf, size_t size, size_t *len, bool *overflow, uint64_t v)
+{
+    while (v >= 0x80) {
+        varint_put_byte(buf, size, len, overflow, (uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    varint_put_byte(buf, size, len, overflow, (uint8_t)v);
+}
+
+static inline void varint_put_s(uint8_t *buf, size_t size, size_t *len, bool *overflow, int64_t v)
+{
+    varint_put_u(buf, size, len, overflow, varint_zigzag(v));
+}
+
+/**
+ * @brief Read a uvarint at *pos
+ *
+ * @return 0 on success, -1 if truncated, -2 if longer than 64 bits
+ */
+static inline int varint_get_u(const uint8_t *buf, size_t len, size_t *pos, uint64_t *value)
+{
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*pos >= len) {
+            return -1;
+        }
+        uint8_t b = buf[(*pos)++];
+        // The tenth byte may only carry the top bit of a 64-bit value
+        if (shift == 63 && b > 1) {
+            return -2;
+        }
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            *value = v;
+            return 0;
+        }
+    }
+    return -2;
+}
+
+#endif // __VARINT_H_
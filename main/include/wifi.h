@@ -6,7 +6,29 @@
 
 #include "esp_wifi.h"
 
-#define time_to_reconect 5
+typedef struct {
+	uint32_t disconnects;       // Links lost since boot
+	uint32_t reconnects;        // Links recovered (IP obtained again)
+	uint32_t attempts;          // Reconnection attempts
+	uint32_t offline_last_ms;   // Duration of the last outage
+	uint32_t offline_max_ms;    // Longest outage
+	uint32_t offline_now_ms;    // Current outage (0 while connected)
+	uint64_t offline_total_ms;  // Sum of the finished outages
+	uint8_t last_reason;        // wifi_err_reason_t of the last disconnection
+	bool connected;
+} wifi_link_stats_t;
+
+// Outcome of the first association of this boot
+typedef enum {
+	WIFI_FAST_CONNECT_NONE = 0, // No cached AP (or CONFIG_ENABLE_WIFI_FAST_CONNECT disabled): full scan
+	WIFI_FAST_CONNECT_HIT,      // Connected to the cached BSSID/channel without scanning
+	WIFI_FAST_CONNECT_MISS,     // The cached AP failed, connected after a full scan
+} wifi_fast_connect_t;
 
 void wifi_setup(nmda_init_config_t* nmda_config);
+bool wifi_is_connected(void);
+void wifi_get_link_stats(wifi_link_stats_t* stats);
+wifi_fast_connect_t wifi_get_fast_connect(void);
+const char* wifi_fast_connect_name(wifi_fast_connect_t result);
+bool wifi_static_ip_enabled(void);
 #endif
@@ -0,0 +1,296 @@
+#include "json_benchmark.h"
+
+#ifdef CONFIG_ENABLE_JSON_BENCHMARK
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "cJSON.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "datastructures.h"
+#include "json_writer.h"
+#include "telemetry_json.h"
+#include "tm_pool.h"
+
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+#include "baro_correction.h"
+#endif
+
+static const char *TAG = "JSON_BENCH";
+
+#define BENCH_BUFFER_SIZE 4096
+
+static char s_writer_buf[BENCH_BUFFER_SIZE];
+static char s_reference[BENCH_BUFFER_SIZE];
+
+// Reference: TM_PULSE_COUNT as serialized with cJSON before the streaming writer
+static char *cjson_pulse_count(const struct telemetry_message *message)
+{
+    cJSON *json = cJSON_CreateObject();
+    if (json == NULL) {
+        return NULL;
+    }
+
+    char start_ts_str[32];
+    char end_ts_str[32];
+    char ch01_str[32];
+    char ch02_str[32];
+    char ch03_str[32];
+    char interval_str[16];
+    char seq_str[16];
+
+    snprintf(start_ts_str, sizeof(start_ts_str), "%lld", message->payload.tm_pcnt.start_timestamp);
+    snprintf(end_ts_str, sizeof(end_ts_str), "%lld", message->timestamp);
+    snprintf(ch01_str, sizeof(ch01_str), "%lu", (unsigned long)message->payload.tm_pcnt.channel[0]);
+    snprintf(ch02_str, sizeof(ch02_str), "%lu", (unsigned long)message->payload.tm_pcnt.channel[1]);
+    snprintf(ch03_str, sizeof(ch03_str), "%lu", (unsigned long)message->payload.tm_pcnt.channel[2]);
+    snprintf(interval_str, sizeof(interval_str), "%u", message->payload.tm_pcnt.integration_time_sec);
+    snprintf(seq_str, sizeof(seq_str), "%lu", (unsigned long)message->payload.tm_pcnt.seq);
+
+    cJSON_AddStringToObject(json, "start_datetime", start_ts_str);
+    cJSON_AddStringToObject(json, "datetime", end_ts_str);
+    cJSON_AddStringToObject(json, "ch01", ch01_str);
+    cJSON_AddStringToObject(json, "ch02", ch02_str);
+    cJSON_AddStringToObject(json, "ch03", ch03_str);
+    cJSON_AddStringToObject(json, "Interval_s", interval_str);
+    cJSON_AddStringToObject(json, "seq", seq_str);
+#ifdef CONFIG_ENABLE_PCNT_GATE
+    char gated_str[3][16];
+    snprintf(gated_str[0], sizeof(gated_str[0]), "%lu", (unsigned long)message->payload.tm_pcnt.gated[0]);
+    snprintf(gated_str[1], sizeof(gated_str[1]), "%lu", (unsigned long)message->payload.tm_pcnt.gated[1]);
+    snprintf(gated_str[2], sizeof(gated_str[2]), "%lu", (unsigned long)message->payload.tm_pcnt.gated[2]);
+    cJSON_AddStringToObject(json, "gated_ch01", gated_str[0]);
+    cJSON_AddStringToObject(json, "gated_ch02", gated_str[1]);
+    cJSON_AddStringToObject(json, "gated_ch03", gated_str[2]);
+#endif
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+    char rmt_str[3][16];
+    char lost_str[3][16];
+    for (int i = 0; i < 3; i++) {
+        snprintf(rmt_str[i], sizeof(rmt_str[i]), "%lu", (unsigned long)message->payload.tm_pcnt.rmt[i]);
+        snprintf(lost_str[i], sizeof(lost_str[i]), "%ld",
+                 (long)message->payload.tm_pcnt.channel[i] - (long)message->payload.tm_pcnt.rmt[i]);
+    }
+    cJSON_AddStringToObject(json, "rmt_ch01", rmt_str[0]);
+    cJSON_AddStringToObject(json, "rmt_ch02", rmt_str[1]);
+    cJSON_AddStringToObject(json, "rmt_ch03", rmt_str[2]);
+    cJSON_AddStringToObject(json, "lost_ch01", lost_str[0]);
+    cJSON_AddStringToObject(json, "lost_ch02", lost_str[1]);
+    cJSON_AddStringToObject(json, "lost_ch03", lost_str[2]);
+#endif
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+    if (!isnan(message->payload.tm_pcnt.pressure_hpa)) {
+        char pressure_str[16];
+        char beta_str[16];
+        char p0_str[16];
+        char corr_str[3][24];
+        snprintf(pressure_str, sizeof(pressure_str), "%.2f", message->payload.tm_pcnt.pressure_hpa);
+        snprintf(beta_str, sizeof(beta_str), "%.6f", message->payload.tm_pcnt.baro_beta);
+        snprintf(p0_str, sizeof(p0_str), "%.2f", message->payload.tm_pcnt.baro_p0_hpa);
+        for (int i = 0; i < 3; i++) {
+            snprintf(corr_str[i], sizeof(corr_str[i]), "%.2f",
+                     baro_correction_apply(message->payload.tm_pcnt.channel[i],
+                                           message->payload.tm_pcnt.pressure_hpa,
+                                           message->payload.tm_pcnt.baro_beta,
+                                           message->payload.tm_pcnt.baro_p0_hpa));
+        }
+        cJSON_AddStringToObject(json, "pressure_hpa", pressure_str);
+        cJSON_AddStringToObject(json, "baro_beta", beta_str);
+        cJSON_AddStringToObject(json, "baro_p0_hpa", p0_str);
+        cJSON_AddStringToObject(json, "corr_ch01", corr_str[0]);
+        cJSON_AddStringToObject(json, "corr_ch02", corr_str[1]);
+        cJSON_AddStringToObject(json, "corr_ch03", corr_str[2]);
+    }
+#endif
+
+    char *json_string = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+    return json_string;
+}
+
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+// Reference: TM_RMT_PULSE_EVENT as serialized with cJSON before the streaming writer
+static char *cjson_pburst(const struct telemetry_message *message)
+{
+    cJSON *json = cJSON_CreateObject();
+    if (json == NULL) {
+        return NULL;
+    }
+
+    char start_ts_str[32];
+    snprintf(start_ts_str, sizeof(start_ts_str), "%lld", message->payload.tm_rmt_pulse_event.start_timestamp);
+    cJSON_AddStringToObject(json, "start_datetime", start_ts_str);
+
+    char channel_str[8];
+    snprintf(channel_str, sizeof(channel_str), "ch%u", message->payload.tm_rmt_pulse_event.channel);
+    cJSON_AddStringToObject(json, "channel", channel_str);
+
+    cJSON_AddNumberToObject(json, "symbols", message->payload.tm_rmt_pulse_event.symbols);
+
+    cJSON *pulses_array = cJSON_CreateArray();
+    if (pulses_array == NULL) {
+        cJSON_Delete(json);
+        return NULL;
+    }
+    for (uint8_t i = 0; i < message->payload.tm_rmt_pulse_event.symbols; i++) {
+        cJSON *pulse_obj = cJSON_CreateObject();
+        if (pulse_obj == NULL) {
+            break;
+        }
+        cJSON_AddNumberToObject(pulse_obj, "duration_us", message->payload.tm_rmt_pulse_event.pulses[i].duration_us);
+        cJSON_AddNumberToObject(pulse_obj, "separation_us", message->payload.tm_rmt_pulse_event.pulses[i].separation_us);
+        cJSON_AddItemToArray(pulses_array, pulse_obj);
+    }
+    cJSON_AddItemToObject(json, "pulses", pulses_array);
+
+    char *json_string = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+    return json_string;
+}
+#endif
+
+// Allocator calls seen by the pool (cJSON is hooked to it), heap fallbacks included
+static uint32_t allocator_calls(void)
+{
+    uint32_t calls = 0;
+    for (int i = 0; i < TM_POOL_CLASSES; i++) {
+        tm_pool_class_stats_t stats;
+        tm_pool_get_class_stats(i, &stats);
+        calls += stats.allocs;
+    }
+    tm_pool_stats_t stats;
+    tm_pool_get_stats(&stats);
+    return calls + stats.heap_fallback + stats.failed;
+}
+
+typedef char *(*cjson_fn_t)(const struct telemetry_message *message);
+typedef const char *(*writer_fn_t)(json_writer_t *w, const struct telemetry_message *message);
+
+static void bench_case(const char *name, const struct telemetry_message *message,
+                       cjson_fn_t cjson_fn, writer_fn_t writer_fn)
+{
+    const int iterations = CONFIG_JSON_BENCHMARK_ITERATIONS;
+    uint64_t cjson_cycles = 0;
+    uint64_t writer_cycles = 0;
+    size_t cjson_bytes = 0;
+    size_t writer_bytes = 0;
+    bool identical = true;
+
+    // cJSON path: tree, print, free (allocation and release are both part of the cost)
+    uint32_t calls_before = allocator_calls();
+    for (int i = 0; i < iterations; i++) {
+        uint32_t start = esp_cpu_get_cycle_count();
+        char *json_string = cjson_fn(message);
+        if (json_string != NULL && i == 0) {
+            cjson_bytes = strlen(json_string);
+            strlcpy(s_reference, json_string, sizeof(s_reference));
+        }
+        cJSON_free(json_string);
+        cjson_cycles += (uint32_t)(esp_cpu_get_cycle_count() - start);
+        if (json_string == NULL) {
+            ESP_LOGE(TAG, "%s: cJSON serialization failed", name);
+            return;
+        }
+    }
+    uint32_t cjson_calls = allocator_calls() - calls_before;
+
+    // Streaming writer into the reusable buffer
+    calls_before = allocator_calls();
+    for (int i = 0; i < iterations; i++) {
+        json_writer_t writer;
+        uint32_t start = esp_cpu_get_cycle_count();
+        json_writer_init(&writer, s_writer_buf, sizeof(s_writer_buf));
+        const char *json_string = writer_fn(&writer, message);
+        writer_cycles += (uint32_t)(esp_cpu_get_cycle_count() - start);
+        if (json_string == NULL) {
+            ESP_LOGE(TAG, "%s: writer serialization failed", name);
+            return;
+        }
+        if (i == 0) {
+            writer_bytes = writer.len;
+            identical = (strcmp(json_string, s_reference) == 0);
+        }
+    }
+    uint32_t writer_calls = allocator_calls() - calls_before;
+
+    ESP_LOGI(TAG, "%-10s cJSON: %7lu cycles %4u bytes %5.1f allocs | writer: %7lu cycles %4u bytes %5.1f allocs | x%.1f %s",
+             name,
+             (unsigned long)(cjson_cycles / iterations), (unsigned)cjson_bytes, (double)cjson_calls / iterations,
+             (unsigned long)(writer_cycles / iterations), (unsigned)writer_bytes, (double)writer_calls / iterations,
+             writer_cycles > 0 ? (double)cjson_cycles / (double)writer_cycles : 0.0,
+             identical ? "identical" : "DIFFERENT");
+    if (!identical) {
+        ESP_LOGE(TAG, "cJSON:  %s", s_reference);
+        ESP_LOGE(TAG, "writer: %s", s_writer_buf);
+    }
+}
+
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+static void bench_pburst(const char *name, uint8_t num_pulses)
+{
+    static rmt_pulse_t pulses[64];
+    struct telemetry_message message;
+    uint32_t lcg = 12345;
+
+    // Plausible pulses: a few microseconds wide, separations from tens of us to seconds
+    for (int i = 0; i < num_pulses; i++) {
+        lcg = lcg * 1664525u + 1013904223u;
+        pulses[i].duration_us = 2 + (lcg >> 28);
+        pulses[i].separation_us = (i == 0) ? -1 : (int64_t)(20 + (lcg >> 8) % 2000000);
+    }
+
+    memset(&message, 0, sizeof(message));
+    message.tm_message_type = TM_RMT_PULSE_EVENT;
+    message.timestamp = 1718000000123456LL;
+    message.payload.tm_rmt_pulse_event.channel = 2;
+    message.payload.tm_rmt_pulse_event.symbols = num_pulses;
+    message.payload.tm_rmt_pulse_event.start_timestamp = message.timestamp;
+    message.payload.tm_rmt_pulse_event.pulses = pulses;
+
+    bench_case(name, &message, cjson_pburst, telemetry_json_pburst);
+}
+#endif
+
+void json_benchmark_run(void)
+{
+    struct telemetry_message message;
+
+    ESP_LOGI(TAG, "JSON serialization benchmark, %d iterations per case (per-message averages)",
+             CONFIG_JSON_BENCHMARK_ITERATIONS);
+
+    memset(&message, 0, sizeof(message));
+    message.tm_message_type = TM_PULSE_COUNT;
+    message.timestamp = 1718000010000000LL;
+    message.payload.tm_pcnt.start_timestamp = 1718000000000000LL;
+    message.payload.tm_pcnt.integration_time_sec = 10;
+    message.payload.tm_pcnt.channel[0] = 1523;
+    message.payload.tm_pcnt.channel[1] = 1498;
+    message.payload.tm_pcnt.channel[2] = 1540;
+    message.payload.tm_pcnt.seq = 4242;
+#ifdef CONFIG_ENABLE_PCNT_GATE
+    message.payload.tm_pcnt.gated[0] = 1490;
+    message.payload.tm_pcnt.gated[1] = 1498;
+    message.payload.tm_pcnt.gated[2] = 1540;
+#endif
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+    message.payload.tm_pcnt.rmt[0] = 1521;
+    message.payload.tm_pcnt.rmt[1] = 1498;
+    message.payload.tm_pcnt.rmt[2] = 1539;
+#endif
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+    message.payload.tm_pcnt.pressure_hpa = 1008.37f;
+    message.payload.tm_pcnt.baro_beta = 0.0072f;
+    message.payload.tm_pcnt.baro_p0_hpa = 1013.25f;
+#endif
+    bench_case("pcnt", &message, cjson_pulse_count, telemetry_json_pulse_count);
+
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+    bench_pburst("pburst/1", 1);
+    bench_pburst("pburst/8", 8);
+    bench_pburst("pburst/64", 64);
+#endif
+}
+
+#endif // CONFIG_ENABLE_JSON_BENCHMARK
@@ -0,0 +1,216 @@
+#include "json_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+size_t json_format_uint(char *dst, uint64_t value)
+{
+    char tmp[20];
+    size_t n = 0;
+
+    // 32-bit division is much cheaper than 64-bit on the ESP32: use it once the value fits
+    while (value > UINT32_MAX) {
+        tmp[n++] = (char)('0' + (value % 10));
+        value /= 10;
+    }
+    uint32_t v32 = (uint32_t)value;
+    do {
+        tmp[n++] = (char)('0' + (v32 % 10));
+        v32 /= 10;
+    } while (v32 != 0);
+
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = tmp[n - 1 - i];
+    }
+    dst[n] = '\0';
+    return n;
+}
+
+size_t json_format_int(char *dst, int64_t value)
+{
+    if (value < 0) {
+        dst[0] = '-';
+        // Negate in unsigned arithmetic so INT64_MIN does not overflow
+        return 1 + json_format_uint(dst + 1, (uint64_t)0 - (uint64_t)value);
+    }
+    return json_format_uint(dst, (uint64_t)value);
+}
+
+static void put(json_writer_t *w, const char *data, size_t n)
+{
+    if (w->overflow) {
+        return;
+    }
+    // Keep one byte for the terminating NUL
+    if (w->len + n >= w->size) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, n);
+    w->len += n;
+}
+
+static inline void put_char(json_writer_t *w, char c)
+{
+    put(w, &c, 1);
+}
+
+// Same escaping as cJSON print_string_ptr
+static void put_escaped(json_writer_t *w, const char *str)
+{
+    put_char(w, '"');
+    const char *run = str;
+    for (const char *p = str; *p != '\0'; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c >= 32 && c != '"' && c != '\\') {
+            continue;
+        }
+        put(w, run, (size_t)(p - run));
+        run = p + 1;
+
+        char esc[7];
+        switch (c) {
+            case '"':  put(w, "\\\"", 2); break;
+            case '\\': put(w, "\\\\", 2); break;
+            case '\b': put(w, "\\b", 2); break;
+            case '\f': put(w, "\\f", 2); break;
+            case '\n': put(w, "\\n", 2); break;
+            case '\r': put(w, "\\r", 2); break;
+            case '\t': put(w, "\\t", 2); break;
+            default:
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+                put(w, esc, 6);
+                break;
+        }
+    }
+    put(w, run, strlen(run));
+    put_char(w, '"');
+}
+
+// Separator and key of the next member
+static void member(json_writer_t *w, const char *key)
+{
+    if (w->depth > 0) {
+        uint8_t bit = (uint8_t)(1u << (w->depth - 1));
+        if (w->first & bit) {
+            w->first &= (uint8_t)~bit;
+        } else {
+            put_char(w, ',');
+        }
+    }
+    if (key != NULL) {
+        put_escaped(w, key);
+        put_char(w, ':');
+    }
+}
+
+static void open_level(json_writer_t *w, const char *key, char c)
+{
+    member(w, key);
+    if (w->depth >= JSON_WRITER_MAX_DEPTH) {
+        w->overflow = true;
+        return;
+    }
+    put_char(w, c);
+    w->depth++;
+    w->first |= (uint8_t)(1u << (w->depth - 1));
+}
+
+static void close_level(json_writer_t *w, char c)
+{
+    if (w->depth == 0) {
+        w->overflow = true;
+        return;
+    }
+    w->depth--;
+    w->first &= (uint8_t)~(1u << w->depth);
+    put_char(w, c);
+}
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->depth = 0;
+    w->first = 0;
+    w->overflow = (buf == NULL || size == 0);
+}
+
+void json_writer_begin_object(json_writer_t *w, const char *key)
+{
+    open_level(w, key, '{');
+}
+
+void json_writer_end_object(json_writer_t *w)
+{
+    close_level(w, '}');
+}
+
+void json_writer_begin_array(json_writer_t *w, const char *key)
+{
+    open_level(w, key, '[');
+}
+
+void json_writer_end_array(json_writer_t *w)
+{
+    close_level(w, ']');
+}
+
+void json_writer_string(json_writer_t *w, const char *key, const char *value)
+{
+    member(w, key);
+    put_escaped(w, value != NULL ? value : "");
+}
+
+void json_writer_string_int(json_writer_t *w, const char *key, int64_t value)
+{
+    char digits[21];
+    size_t n = json_format_int(digits, value);
+    member(w, key);
+    put_char(w, '"');
+    put(w, digits, n);
+    put_char(w, '"');
+}
+
+void json_writer_string_uint(json_writer_t *w, const char *key, uint64_t value)
+{
+    char digits[21];
+    size_t n = json_format_uint(digits, value);
+    member(w, key);
+    put_char(w, '"');
+    put(w, digits, n);
+    put_char(w, '"');
+}
+
+void json_writer_string_float(json_writer_t *w, const char *key, double value, int decimals)
+{
+    // Floats keep snprintf so the rounding is exactly that of the previous "%.Nf" strings
+    char text[48];
+    int n = snprintf(text, sizeof(text), "%.*f", decimals, value);
+    if (n < 0 || (size_t)n >= sizeof(text)) {
+        w->overflow = true;
+        return;
+    }
+    member(w, key);
+    put_char(w, '"');
+    put(w, text, (size_t)n);
+    put_char(w, '"');
+}
+
+void json_writer_int(json_writer_t *w, const char *key, int64_t value)
+{
+    char digits[21];
+    size_t n = json_format_int(digits, value);
+    member(w, key);
+    put(w, digits, n);
+}
+
+const char *json_writer_finish(json_writer_t *w)
+{
+    if (w->overflow || w->depth != 0) {
+        return NULL;
+    }
+    w->buf[w->len] = '\0';
+    return w->buf;
+}
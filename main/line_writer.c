@@ -0,0 +1,139 @@
+#include "line_writer.h"
+
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "json_writer.h"
+
+void line_writer_init(line_writer_t *w, char *buf, size_t size, const char *tags)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->line_start = 0;
+    w->tags = tags;
+    w->fields = 0;
+    w->overflow = false;
+}
+
+static void put(line_writer_t *w, const char *data, size_t n)
+{
+    if (w->overflow) {
+        return;
+    }
+    if (w->len + n > w->size) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, n);
+    w->len += n;
+}
+
+static inline void put_char(line_writer_t *w, char c)
+{
+    put(w, &c, 1);
+}
+
+static void put_escaped(line_writer_t *w, const char *str)
+{
+    for (; *str != '\0'; str++) {
+        if (*str == ',' || *str == ' ' || *str == '=') {
+            put_char(w, '\\');
+        }
+        put_char(w, *str);
+    }
+}
+
+static void field_key(line_writer_t *w, const char *key)
+{
+    put_char(w, w->fields == 0 ? ' ' : ',');
+    put_escaped(w, key);
+    put_char(w, '=');
+    w->fields++;
+}
+
+void line_writer_begin(line_writer_t *w, const char *measurement)
+{
+    w->line_start = w->len;
+    w->fields = 0;
+    put_escaped(w, measurement);
+    if (w->tags != NULL) {
+        put(w, w->tags, strlen(w->tags));
+    }
+}
+
+void line_writer_tag(line_writer_t *w, const char *key, const char *value)
+{
+    put_char(w, ',');
+    put_escaped(w, key);
+    put_char(w, '=');
+    put_escaped(w, value);
+}
+
+void line_writer_int(line_writer_t *w, const char *key, int64_t value)
+{
+    char digits[21];
+    size_t n = json_format_int(digits, value);
+    field_key(w, key);
+    put(w, digits, n);
+    put_char(w, 'i');
+}
+
+void line_writer_float(line_writer_t *w, const char *key, double value, int decimals)
+{
+    if (!isfinite(value)) {
+        return;
+    }
+    char text[48];
+    int n = snprintf(text, sizeof(text), "%.*f", decimals, value);
+    if (n < 0 || (size_t)n >= sizeof(text)) {
+        w->overflow = true;
+        return;
+    }
+    field_key(w, key);
+    put(w, text, (size_t)n);
+}
+
+void line_writer_string(line_writer_t *w, const char *key, const char *value)
+{
+    field_key(w, key);
+    put_char(w, '"');
+    for (; *value != '\0'; value++) {
+        if (*value == '"' || *value == '\\') {
+            put_char(w, '\\');
+        }
+        put_char(w, *value);
+    }
+    put_char(w, '"');
+}
+
+size_t line_writer_end(line_writer_t *w, int64_t timestamp_us)
+{
+    char digits[21];
+    size_t n = json_format_int(digits, timestamp_us);
+
+    put_char(w, ' ');
+    put(w, digits, n);
+    put(w, "000\n", 4);     // Microseconds to nanoseconds
+    if (w->overflow || w->fields == 0) {
+        w->len = w->line_start;
+        return 0;
+    }
+    return w->len - w->line_start;
+}
+
+size_t line_writer_escape(char *dst, size_t size, const char *src)
+{
+    line_writer_t w;
+    line_writer_init(&w, dst, size - 1, NULL);
+    put_escaped(&w, src);
+    if (w.overflow) {
+        return 0;
+    }
+    dst[w.len] = '\0';
+    return w.len;
+}
+
+#endif // CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
@@ -0,0 +1,289 @@
+#include "lzss.h"
+
+#ifdef CONFIG_ENABLE_BATCH_COMPRESSION
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "LZSS";
+
+#define WINDOW_BITS 10
+#define LENGTH_BITS 6
+#define WINDOW_SIZE (1 << WINDOW_BITS)
+#define MIN_MATCH   3   // A copy costs 17 bits, three literals 27
+#define MAX_MATCH   (MIN_MATCH + (1 << LENGTH_BITS) - 1)
+#define HASH_BITS   10
+#define MAX_CHAIN   32  // Candidates tried per position: bounds the CPU time
+
+// Most recent position + 1 of each 3-byte hash (0: none), and for each position
+// in the window the previous one with the same hash
+static uint16_t s_head[1 << HASH_BITS];
+static uint16_t s_prev[WINDOW_SIZE];
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    uint32_t acc;
+    int bits;
+    bool overflow;
+} bit_writer_t;
+
+static void put_bits(bit_writer_t *w, uint32_t value, int count)
+{
+    w->acc = (w->acc << count) | (value & ((1u << count) - 1));
+    w->bits += count;
+    while (w->bits >= 8) {
+        w->bits -= 8;
+        if (w->len >= w->size) {
+            w->overflow = true;
+        } else {
+            w->buf[w->len++] = (uint8_t)(w->acc >> w->bits);
+        }
+    }
+}
+
+static void flush_bits(bit_writer_t *w)
+{
+    if (w->bits > 0) {
+        put_bits(w, 0, 8 - w->bits);
+    }
+}
+
+static inline uint32_t hash3(const uint8_t *p)
+{
+    return ((p[0] << 6) ^ (p[1] << 3) ^ p[2]) & ((1 << HASH_BITS) - 1);
+}
+
+static inline void insert(const uint8_t *src, size_t len, size_t pos)
+{
+    if (pos + MIN_MATCH <= len) {
+        uint32_t h = hash3(src + pos);
+        s_prev[pos % WINDOW_SIZE] = s_head[h];
+        s_head[h] = (uint16_t)(pos + 1);
+    }
+}
+
+size_t lzss_compress(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t len)
+{
+    if (len > LZSS_MAX_INPUT || dst_size < LZSS_HEADER_SIZE) {
+        return 0;
+    }
+    dst[0] = LZSS_PAYLOAD_MAGIC;
+    dst[1] = LZSS_PAYLOAD_FORMAT;
+    dst[2] = (uint8_t)(len & 0xFF);
+    dst[3] = (uint8_t)(len >> 8);
+
+    bit_writer_t w = { dst, dst_size, LZSS_HEADER_SIZE, 0, 0, false };
+    memset(s_head, 0, sizeof(s_head));
+
+    size_t pos = 0;
+    while (pos < len && !w.overflow) {
+        size_t best_len = 0;
+        size_t best_dist = 0;
+
+        if (pos + MIN_MATCH <= len) {
+            size_t max_len = len - pos < MAX_MATCH ? len - pos : MAX_MATCH;
+            uint16_t candidate = s_head[hash3(src + pos)];
+            for (int chain = 0; candidate != 0 && chain < MAX_CHAIN; chain++) {
+                size_t match = candidate - 1;
+                size_t dist = pos - match;
+                if (dist > WINDOW_SIZE) {
+                    break;  // Older candidates are even further away
+                }
+                size_t n = 0;
+                while (n < max_len && src[match + n] == src[pos + n]) {
+                    n++;
+                }
+                if (n > best_len) {
+                    best_len = n;
+                    best_dist = dist;
+                    if (n == max_len) {
+                        break;
+                    }
+                }
+                candidate = s_prev[match % WINDOW_SIZE];
+            }
+        }
+
+        if (best_len >= MIN_MATCH) {
+            put_bits(&w, 0, 1);
+            put_bits(&w, (uint32_t)(best_dist - 1), WINDOW_BITS);
+            put_bits(&w, (uint32_t)(best_len - MIN_MATCH), LENGTH_BITS);
+            for (size_t i = 0; i < best_len; i++) {
+                insert(src, len, pos + i);
+            }
+            pos += best_len;
+        } else {
+            put_bits(&w, 1, 1);
+            put_bits(&w, src[pos], 8);
+            insert(src, len, pos);
+            pos++;
+        }
+    }
+    flush_bits(&w);
+
+    return w.overflow ? 0 : w.len;
+}
+
+typedef struct {
+    const uint8_t *buf;
+    size_t len;
+    size_t pos;    // Next byte
+    uint32_t acc;
+    int bits;
+} bit_reader_t;
+
+static bool get_bits(bit_reader_t *r, int count, uint32_t *value)
+{
+    while (r->bits < count) {
+        if (r->pos >= r->len) {
+            return false;
+        }
+        r->acc = (r->acc << 8) | r->buf[r->pos++];
+        r->bits += 8;
+    }
+    r->bits -= count;
+    *value = (r->acc >> r->bits) & ((1u << count) - 1);
+    return true;
+}
+
+esp_err_t lzss_decompress(uint8_t *dst, size_t dst_size, const uint8_t *src, size_t len, size_t *out_len)
+{
+    if (len < LZSS_HEADER_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (src[0] != LZSS_PAYLOAD_MAGIC || src[1] != LZSS_PAYLOAD_FORMAT) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    size_t total = (size_t)src[2] | ((size_t)src[3] << 8);
+    if (total > dst_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    bit_reader_t r = { src, len, LZSS_HEADER_SIZE, 0, 0 };
+    size_t produced = 0;
+    uint32_t flag, value, dist, count;
+
+    while (produced < total) {
+        if (!get_bits(&r, 1, &flag)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (flag) {
+            if (!get_bits(&r, 8, &value)) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            dst[produced++] = (uint8_t)value;
+            continue;
+        }
+        if (!get_bits(&r, WINDOW_BITS, &dist) || !get_bits(&r, LENGTH_BITS, &count)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        dist += 1;
+        count += MIN_MATCH;
+        if (dist > produced) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (produced + count > total) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        // Byte by byte: the copy may overlap the bytes it produces (runs)
+        for (uint32_t i = 0; i < count; i++, produced++) {
+            dst[produced] = dst[produced - dist];
+        }
+    }
+
+    // Only the zero padding of the last byte may remain
+    if (r.pos != len || r.bits >= 8 || (r.acc & ((1u << r.bits) - 1)) != 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *out_len = total;
+    return ESP_OK;
+}
+
+#define SELF_TEST_MAX 2048
+
+static bool round_trip(const char *name, const uint8_t *src, size_t len, bool expect_smaller)
+{
+    static uint8_t packed[SELF_TEST_MAX + SELF_TEST_MAX / 8 + LZSS_HEADER_SIZE + 1];
+    static uint8_t unpacked[SELF_TEST_MAX];
+    size_t out_len = 0;
+
+    size_t packed_len = lzss_compress(packed, sizeof(packed), src, len);
+    if (packed_len == 0) {
+        ESP_LOGE(TAG, "%s: compress failed", name);
+        return false;
+    }
+    if (expect_smaller && packed_len >= len) {
+        ESP_LOGE(TAG, "%s: %u bytes did not compress (%u)", name, (unsigned)len, (unsigned)packed_len);
+        return false;
+    }
+    esp_err_t err = lzss_decompress(unpacked, sizeof(unpacked), packed, packed_len, &out_len);
+    if (err != ESP_OK || out_len != len || memcmp(unpacked, src, len) != 0) {
+        ESP_LOGE(TAG, "%s: round trip failed (%s, %u of %u bytes)", name, esp_err_to_name(err),
+                 (unsigned)out_len, (unsigned)len);
+        return false;
+    }
+    for (size_t cut = 0; cut < packed_len; cut++) {
+        if (lzss_decompress(unpacked, sizeof(unpacked), packed, cut, &out_len) == ESP_OK) {
+            ESP_LOGE(TAG, "%s: truncated payload (%u of %u bytes) accepted", name, (unsigned)cut, (unsigned)packed_len);
+            return false;
+        }
+    }
+    ESP_LOGD(TAG, "%s: %u -> %u bytes", name, (unsigned)len, (unsigned)packed_len);
+    return true;
+}
+
+esp_err_t lzss_self_test(void)
+{
+    static uint8_t data[SELF_TEST_MAX];
+    bool ok = true;
+    size_t len = 0;
+
+    ok &= round_trip("empty", data, 0, false);
+    ok &= round_trip("byte", (const uint8_t *)"x", 1, false);
+
+    // Batched pburst JSON: the structure repeats, the values change
+    len = 0;
+    data[len++] = '[';
+    for (int i = 0; len < SELF_TEST_MAX - 120; i++) {
+        len += snprintf((char *)data + len, SELF_TEST_MAX - len,
+                        "%s{\"start_datetime\":\"17180000%08d\",\"channel\":\"ch%d\",\"symbols\":1,"
+                        "\"pulses\":[{\"duration_us\":%d,\"separation_us\":-1}]}",
+                        i ? "," : "", i * 7919, 1 + i % 3, 3 + i % 11);
+    }
+    data[len++] = ']';
+    ok &= round_trip("json", data, len, true);
+
+    // Long run (overlapping copies) and matches at the far end of the window
+    memset(data, 'a', SELF_TEST_MAX);
+    ok &= round_trip("run", data, SELF_TEST_MAX, true);
+    uint32_t lcg = 0x12345678;
+    for (size_t i = 0; i < WINDOW_SIZE; i++) {
+        lcg = lcg * 1664525u + 1013904223u;
+        data[i] = (uint8_t)(lcg >> 24);
+    }
+    memcpy(data + WINDOW_SIZE, data, WINDOW_SIZE);
+    ok &= round_trip("window", data, 2 * WINDOW_SIZE, true);
+
+    // Incompressible data must still round-trip (the caller sends it raw)
+    ok &= round_trip("random", data, WINDOW_SIZE, false);
+
+    // A copy from before the start of the data must be rejected
+    static const uint8_t bad_dist[] = { LZSS_PAYLOAD_MAGIC, LZSS_PAYLOAD_FORMAT, 3, 0, 0x00, 0x00, 0x00 };
+    size_t out_len;
+    if (lzss_decompress(data, sizeof(data), bad_dist, sizeof(bad_dist), &out_len) != ESP_ERR_INVALID_ARG) {
+        ESP_LOGE(TAG, "copy before the start accepted");
+        ok = false;
+    }
+
+    if (ok) {
+        ESP_LOGI(TAG, "LZSS self-test passed");
+        return ESP_OK;
+    }
+    return ESP_FAIL;
+}
+
+#endif // CONFIG_ENABLE_BATCH_COMPRESSION
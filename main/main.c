@@ -10,6 +10,10 @@
 #include "wifi.h"
 #include "sntp.h"
 #include "mqtt.h"
+#include "tm_pool.h"
+#include "boot_timing.h"
+#include "timebase.h"
+#include "cJSON.h"
 
 #ifdef CONFIG_ENABLE_USER_LED
 #include "user_led.h"
@@ -31,7 +35,18 @@
 #include "rmt_pulse_capture.h"
 #endif
 
-QueueHandle_t telemetry_queue;
+#ifdef CONFIG_ENABLE_CHANNEL_HEALTH
+#include "channel_health.h"
+#endif
+
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+#include "baro_correction.h"
+#endif
+
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+#include "rtc_window_ring.h"
+#endif
+
 SemaphoreHandle_t wifi_semaphore;
 SemaphoreHandle_t sntp_semaphore;
 SemaphoreHandle_t mqtt_semaphore;
@@ -53,36 +68,46 @@ void app_main(void)
 
     init_nvs();
 
+    // Provisional wall-clock time after a warm reset, before any timestamp is taken
+    timebase_init();
+
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+    // Recover PCNT windows closed before the last reset (republished by mss_sender)
+    rtc_window_ring_init();
+#endif
+
     // Load configuration
     esp_err_t settings_ret = load_nmda_settings(&nmda_config);
     if (settings_ret != ESP_OK) {
         ESP_LOGW("APP_MAIN", "Failed to load settings, using defaults");
     }
+    boot_timing_mark(BOOT_PHASE_SETTINGS);
 
-    // Create telemetry queue and semaphores
-    // Note: struct telemetry_message now uses dynamic allocation for RMT pulse arrays
-    // Size: base structure + pointer (8 bytes) = ~25 bytes per message
-    // The actual pulse arrays are allocated separately and freed after processing
-    telemetry_queue = xQueueCreate(100, sizeof(struct telemetry_message));
-    if (telemetry_queue == NULL) {
-        ESP_LOGE("APP_MAIN", "Failed to create telemetry queue - insufficient memory!");
-        ESP_LOGE("APP_MAIN", "Required size: %zu bytes per message, %zu bytes total", 
-                 sizeof(struct telemetry_message), 
-                 100 * sizeof(struct telemetry_message));
-        esp_restart();
-    } else {
-        ESP_LOGI("APP_MAIN", "Telemetry queue created: %zu bytes per message, %zu bytes total", 
-                 sizeof(struct telemetry_message), 
-                 100 * sizeof(struct telemetry_message));
-    }
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+    // Barometric coefficients from settings (can be changed later on {base}/config/baro)
+    baro_correction_init(&nmda_config);
+#endif
+
+    // Per-stream telemetry rings (static, sized in menuconfig) and semaphores
+    // Note: struct telemetry_message uses dynamic allocation for RMT pulse arrays;
+    // the pulse arrays are allocated separately and freed after processing
+    telemetry_rings_init();
+
+    // cJSON trees and printed documents come from the preallocated telemetry pool
+    cJSON_Hooks json_hooks = {
+        .malloc_fn = tm_pool_alloc,
+        .free_fn = tm_pool_free,
+    };
+    cJSON_InitHooks(&json_hooks);
     wifi_semaphore = xSemaphoreCreateBinary();
     sntp_semaphore = xSemaphoreCreateBinary();
     mqtt_semaphore = xSemaphoreCreateBinary();
 
-    // Initialize WiFi and NTP
+    // Initialize WiFi and NTP (both complete in the background)
     wifi_setup(&nmda_config);
     ntp_setup(&nmda_config);
 
+#ifndef CONFIG_ENABLE_EARLY_ACQUISITION
     // Wait for WiFi and NTP to be ready
     // Without WiFi/NTP, data collection is meaningless - reset the system
     if (xSemaphoreTake(wifi_semaphore, pdMS_TO_TICKS(30000)) != pdTRUE) {
@@ -93,6 +118,7 @@ void app_main(void)
         ESP_LOGE("APP_MAIN", "NTP synchronization timeout - resetting system");
         esp_restart();
     }
+#endif
 
     // Initialize GPIO (required for PCNT, optional for interrupt detection)
     init_GPIO();
@@ -131,8 +157,15 @@ void app_main(void)
 #endif
 
     // Start MQTT sender and other tasks
+#ifdef CONFIG_ENABLE_PUBLISH_PIPELINE
+    // Serialization only: on the acquisition core, below every acquisition task
+    // (pulse counter 2, RMT and sensors 3); the network stage runs on core 0
+    xTaskCreatePinnedToCore(&mss_sender, "Send message", 1024 * 6, &nmda_config, 1, NULL, 1);
+#else
     xTaskCreatePinnedToCore(&mss_sender, "Send message", 1024 * 6, &nmda_config, 5, NULL, 0);
-    xTaskCreatePinnedToCore(&task_pcnt, "Pulse counter", 1024 * 8, NULL, 1, NULL, 1);
+#endif
+    xTaskCreatePinnedToCore(&task_pcnt, "Pulse counter", 1024 * 8, NULL, 2, NULL, 1);
+    boot_timing_mark(BOOT_PHASE_ACQUISITION);
 
 #ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
     // Initialize RMT pulse capture
@@ -148,4 +181,27 @@ void app_main(void)
         ESP_LOGE("APP_MAIN", "RMT pulse capture initialization failed: %s", esp_err_to_name(rmt_ret));
     }
 #endif
+
+#ifdef CONFIG_ENABLE_CHANNEL_HEALTH
+    // Line-level sampling for the channel health monitor (classified by task_pcnt)
+    if (channel_health_init() != ESP_OK) {
+        ESP_LOGE("APP_MAIN", "Channel health monitor initialization failed");
+    }
+#endif
+
+#if defined(CONFIG_ENABLE_EARLY_ACQUISITION) && CONFIG_BOOT_TIME_SYNC_TIMEOUT_SEC > 0
+    // Acquisition already runs on esp_timer time and mss_sender keeps draining the
+    // rings into its early backlog until the first SNTP synchronization; a restart
+    // throws that backlog away, so it is a last resort after a long wait
+    if (xSemaphoreTake(sntp_semaphore, pdMS_TO_TICKS(CONFIG_BOOT_TIME_SYNC_TIMEOUT_SEC * 1000)) != pdTRUE) {
+        // With the provisional RTC time the telemetry keeps flowing (flagged)
+        if (timebase_state() == TIMEBASE_NONE) {
+            ESP_LOGE("APP_MAIN", "No time synchronization after %d s - resetting system",
+                     CONFIG_BOOT_TIME_SYNC_TIMEOUT_SEC);
+            esp_restart();
+        }
+        ESP_LOGW("APP_MAIN", "No time synchronization after %d s, keeping the provisional time",
+                 CONFIG_BOOT_TIME_SYNC_TIMEOUT_SEC);
+    }
+#endif
 }
@@ -1,11 +1,292 @@
 #include "mqtt.h"
 #include "settings.h"
+#include <stdatomic.h>
+#include <stdlib.h>
 #include <string.h>
+#include "esp_timer.h"
+#include "boot_timing.h"
+
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+#include "baro_correction.h"
+#endif
+
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+#include "outbox.h"
+#endif
+
+#ifdef CONFIG_ENABLE_PUBLISH_PIPELINE
+#include "publish_pipeline.h"
+#endif
+
+#ifdef CONFIG_ENABLE_MQTT_TLS_RESUMPTION
+#include "mqtt_tls.h"
+#endif
+
+#ifdef CONFIG_ENABLE_MQTT5_TOPIC_ALIASES
+#include "pburst_codec.h"
+#include "lzss.h"
+#endif
 
 esp_mqtt_client_handle_t client = NULL;
 
+// Set by the MQTT task between MQTT_EVENT_CONNECTED and MQTT_EVENT_DISCONNECTED
+static volatile bool s_connected = false;
+static int64_t s_offline_since_us = 0;
+static mqtt_link_stats_t s_link_stats;
+
+#ifdef CONFIG_ENABLE_MQTT_ADMISSION
+#define MQTT_QUEUE_LIMIT ((size_t)CONFIG_MQTT_QUEUE_LIMIT_KB * 1024)
+
+// Share of the queue limit that each priority may fill: raw pulses are
+// refused first, window counts and alerts last
+static const uint8_t s_admit_percent[MQTT_PRIORITY_COUNT] = { 50, 80, 100 };
+
+static struct {
+    const char *service;    // Last topic level
+    uint8_t priority;
+} const s_topic_priority[] = {
+    { "pburst",   MQTT_PRIORITY_LOW },
+    { "detect",   MQTT_PRIORITY_LOW },
+    { "stats",    MQTT_PRIORITY_NORMAL },
+    { "meteo",    MQTT_PRIORITY_NORMAL },
+    { "health",   MQTT_PRIORITY_NORMAL },
+    { "timesync", MQTT_PRIORITY_NORMAL },
+    { "baro",     MQTT_PRIORITY_NORMAL },
+    { "pcnt",     MQTT_PRIORITY_HIGH },
+    { "alert",    MQTT_PRIORITY_HIGH },
+    { "influx",   MQTT_PRIORITY_HIGH },    // Carries the pcnt windows
+    { "status",   MQTT_PRIORITY_HIGH },
+    // Any other topic: normal, counted as "other"
+};
+#define TOPIC_CLASSES (sizeof(s_topic_priority) / sizeof(s_topic_priority[0]))
+
+static uint32_t s_refused[TOPIC_CLASSES + 1];   // Last entry: topics not in the table
+static uint32_t s_queue_peak = 0;
+
+// Index in s_topic_priority, or TOPIC_CLASSES for a topic not in the table
+static size_t topic_class(const char *topic) {
+    const char *service = strrchr(topic, '/');
+    service = (service != NULL) ? service + 1 : topic;
+    for (size_t i = 0; i < TOPIC_CLASSES; i++) {
+        if (strcmp(service, s_topic_priority[i].service) == 0) {
+            return i;
+        }
+    }
+    return TOPIC_CLASSES;
+}
+
+// Bytes held in RAM on the way to the broker: ready buffers waiting for the
+// network stage, and the outbox record being replayed, the only QoS 1 message
+// the client keeps until its PUBACK. A QoS 0 publication leaves the client once
+// written, so it never counts here. The client itself is not queried: its API
+// lock is held by the MQTT task through connect and the TLS handshake.
+static size_t queued_bytes(void) {
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+    return publish_pipeline_bytes() + outbox_inflight_bytes();
+#else
+    return publish_pipeline_bytes();
+#endif
+}
+
+// Whether the queue may take len more bytes at this priority
+static bool queue_has_room(uint8_t priority, size_t len) {
+    size_t queued = queued_bytes();
+    if ((uint32_t)queued > s_queue_peak) {
+        s_queue_peak = (uint32_t)queued;
+    }
+    return queued + len <= MQTT_QUEUE_LIMIT * s_admit_percent[priority] / 100;
+}
+
+// Admission of a live message, before it takes a ready buffer: a refused
+// message is dropped at once, so the serializer never waits on a full queue
+static bool admit(const char *topic, size_t len) {
+    size_t c = topic_class(topic);
+    uint8_t priority = (c < TOPIC_CLASSES) ? s_topic_priority[c].priority : MQTT_PRIORITY_NORMAL;
+    if (queue_has_room(priority, len)) {
+        return true;
+    }
+    if (s_refused[c]++ == 0) {
+        ESP_LOGW("MQTT", "Queue over %u%% of %u bytes, refusing %s", s_admit_percent[priority],
+                 (unsigned)MQTT_QUEUE_LIMIT, topic);
+    }
+    return false;
+}
+
+void mqtt_get_admission_stats(mqtt_admission_stats_t *stats) {
+    stats->queue_bytes = (uint32_t)queued_bytes();
+    stats->queue_peak = s_queue_peak;
+    stats->queue_limit = MQTT_QUEUE_LIMIT;
+}
+
+const char *mqtt_admission_refused(size_t index, uint32_t *refused) {
+    if (index > TOPIC_CLASSES) {
+        return NULL;
+    }
+    *refused = s_refused[index];
+    return (index < TOPIC_CLASSES) ? s_topic_priority[index].service : "other";
+}
+#else
+static inline bool admit(const char *topic, size_t len) {
+    return true;
+}
+#endif
+
+#ifdef CONFIG_ENABLE_MQTT5_TOPIC_ALIASES
+// Kept to switch to MQTT 3.1.1 if the broker refuses MQTT 5
+static esp_mqtt_client_config_t s_mqtt_config;
+static bool s_fallback_pending = false;
+static bool s_fallback = false;
+// Set by the MQTT task on MQTT_EVENT_CONNECTED
+static volatile bool s_mqtt5 = false;
+static _Atomic uint32_t s_connection_id = 0;
+
+// Topics in the order they were first published; the alias is the index + 1
+static char *s_alias_topics[CONFIG_MQTT5_TOPIC_ALIAS_MAX];
+static size_t s_alias_count = 0;
+// Publisher's view of the current connection: aliases already sent with their
+// topic, and the highest alias the broker accepts
+static uint32_t s_alias_connection = 0;
+static uint64_t s_alias_registered = 0;
+static uint16_t s_alias_limit = CONFIG_MQTT5_TOPIC_ALIAS_MAX;
+static mqtt5_stats_t s_mqtt5_stats;
+
+#define SCHEMA_PROPERTY_KEY "schema_version"
+
+// Content type and schema version of a payload, by its first byte
+static const struct {
+    int first_byte;             // -1: anything else
+    const char *content_type;
+    uint8_t version;
+} s_payload_types[] = {
+    { '{', "application/json", 1 },
+    { '[', "application/json", 1 },
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+    { PBURST_BIN_MAGIC, "application/vnd.nmda.pburst", PBURST_BIN_VERSION },
+#endif
+#ifdef CONFIG_ENABLE_BATCH_COMPRESSION
+    { LZSS_PAYLOAD_MAGIC, "application/vnd.nmda.lzss", LZSS_PAYLOAD_FORMAT },
+#endif
+    { -1, "text/plain", 1 },   // Line protocol and the plain status text
+};
+#define PAYLOAD_TYPES (sizeof(s_payload_types) / sizeof(s_payload_types[0]))
+
+static mqtt5_user_property_handle_t s_schema_property[PAYLOAD_TYPES];
+static uint8_t s_property_bytes[PAYLOAD_TYPES];
+
+static void mqtt5_init_properties(void) {
+    char version[4];
+    for (size_t i = 0; i < PAYLOAD_TYPES; i++) {
+        snprintf(version, sizeof(version), "%u", s_payload_types[i].version);
+        esp_mqtt5_user_property_item_t item = { SCHEMA_PROPERTY_KEY, version };
+        if (esp_mqtt5_client_set_user_property(&s_schema_property[i], &item, 1) != ESP_OK) {
+            ESP_LOGW("MQTT", "Failed to create the schema property of %s", s_payload_types[i].content_type);
+        }
+        // Content type (id, length, string) and user property (id, key, value)
+        s_property_bytes[i] = (uint8_t)(3 + strlen(s_payload_types[i].content_type) +
+                                        5 + strlen(SCHEMA_PROPERTY_KEY) + strlen(version));
+    }
+}
+
+static size_t payload_type(const char *data) {
+    size_t i;
+    for (i = 0; i < PAYLOAD_TYPES - 1; i++) {
+        if ((uint8_t)data[0] == s_payload_types[i].first_byte) {
+            break;
+        }
+    }
+    return i;
+}
+
+// Alias of a topic (registered on first use), or 0 when the table is full
+static uint16_t topic_alias(const char *topic) {
+    for (size_t i = 0; i < s_alias_count; i++) {
+        if (strcmp(s_alias_topics[i], topic) == 0) {
+            return (uint16_t)(i + 1);
+        }
+    }
+    if (s_alias_count == CONFIG_MQTT5_TOPIC_ALIAS_MAX) {
+        return 0;
+    }
+    s_alias_topics[s_alias_count] = strdup(topic);
+    if (s_alias_topics[s_alias_count] == NULL) {
+        return 0;
+    }
+    return (uint16_t)(++s_alias_count);
+}
+
+// MQTT 5 publication: content type and schema version as properties, and for
+// QoS 0 a topic alias. After the first publication of a topic on a connection
+// the topic is sent empty. QoS 1 messages may be retransmitted on another
+// connection, where the alias means nothing, so they always carry the topic.
+static int client_publish(const char *topic, const char *data, int len, int qos) {
+    if (!s_mqtt5) {
+        return esp_mqtt_client_publish(client, topic, data, len, qos, false);
+    }
+
+    uint32_t connection = atomic_load(&s_connection_id);
+    if (connection != s_alias_connection) {
+        // Aliases do not survive the connection
+        s_alias_connection = connection;
+        s_alias_registered = 0;
+        s_alias_limit = CONFIG_MQTT5_TOPIC_ALIAS_MAX;
+    }
+
+    size_t type = payload_type(data);
+    esp_mqtt5_publish_property_config_t property = {
+        .content_type = s_payload_types[type].content_type,
+        .user_property = s_schema_property[type],
+    };
+    uint16_t alias = (qos == 0) ? topic_alias(topic) : 0;
+    if (alias > s_alias_limit) {
+        alias = 0;
+    }
+    property.topic_alias = alias;
+    if (esp_mqtt5_client_set_publish_property(client, &property) != ESP_OK && alias != 0) {
+        // Above the broker's Topic Alias Maximum: no higher aliases on this connection
+        s_alias_limit = alias - 1;
+        alias = 0;
+        property.topic_alias = 0;
+        esp_mqtt5_client_set_publish_property(client, &property);
+    }
+
+    uint64_t bit = (alias != 0) ? 1ULL << (alias - 1) : 0;
+    bool reuse = (s_alias_registered & bit) != 0;
+    int msg_id = esp_mqtt_client_publish(client, reuse ? "" : topic, data, len, qos, false);
+    if (msg_id >= 0) {
+        s_mqtt5_stats.property_bytes += s_property_bytes[type] + (alias != 0 ? 3 : 0);
+        if (reuse) {
+            s_mqtt5_stats.aliased++;
+            s_mqtt5_stats.topic_bytes_saved += strlen(topic);
+        }
+        s_alias_registered |= bit;
+    }
+    return msg_id;
+}
+
+void mqtt_get_mqtt5_stats(mqtt5_stats_t *stats) {
+    *stats = s_mqtt5_stats;
+    stats->mqtt5 = s_mqtt5;
+    stats->fallback = s_fallback;
+}
+#else
+static inline int client_publish(const char *topic, const char *data, int len, int qos) {
+    return esp_mqtt_client_publish(client, topic, data, len, qos, false);
+}
+#endif
+
 struct mqtt_settings_t mqtt_settings;
 
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+// Runtime configuration topic: {station}/{experiment}/{device}/config/baro
+static char topic_config_baro[96] = "";
+
+// Topic comparison for MQTT_EVENT_DATA (event topics are not NUL-terminated)
+static bool topic_matches(const esp_mqtt_event_handle_t event, const char *topic) {
+    return topic[0] != '\0' && event->topic_len == (int)strlen(topic) &&
+           strncmp(event->topic, topic, event->topic_len) == 0;
+}
+#endif
+
 
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
     esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
@@ -13,11 +294,39 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     switch (event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI("MQTT", "MQTT_EVENT_CONNECTED");
+            boot_timing_mark(BOOT_PHASE_MQTT);
+            if (s_offline_since_us != 0) {
+                uint32_t offline_ms = (uint32_t)((esp_timer_get_time() - s_offline_since_us) / 1000);
+                s_link_stats.reconnects++;
+                s_link_stats.offline_last_ms = offline_ms;
+                s_link_stats.offline_total_ms += offline_ms;
+                if (offline_ms > s_link_stats.offline_max_ms) {
+                    s_link_stats.offline_max_ms = offline_ms;
+                }
+                ESP_LOGI("MQTT", "Broker reachable again after %lu ms", (unsigned long)offline_ms);
+                s_offline_since_us = 0;
+            }
+            s_connected = true;
+#ifdef CONFIG_ENABLE_MQTT5_TOPIC_ALIASES
+            s_mqtt5 = (event->protocol_ver == MQTT_PROTOCOL_V_5);
+            atomic_fetch_add(&s_connection_id, 1);
+#endif
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+            // Subscriptions are lost with a clean session, renew them on every connection
+            if (esp_mqtt_client_subscribe(event->client, topic_config_baro, 1) < 0) {
+                ESP_LOGW("MQTT", "Failed to subscribe to %s", topic_config_baro);
+            }
+#endif
             xSemaphoreGive(mqtt_semaphore);
             break;
 
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGI("MQTT", "MQTT_EVENT_DISCONNECTED");
+            if (s_connected) {
+                s_link_stats.disconnects++;
+                s_offline_since_us = esp_timer_get_time();
+            }
+            s_connected = false;
             break;
 
         case MQTT_EVENT_SUBSCRIBED:
@@ -30,12 +339,22 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 
         case MQTT_EVENT_PUBLISHED:
             ESP_LOGI("MQTT", "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+            outbox_on_published(event->msg_id);
+#endif
             break;
 
         case MQTT_EVENT_DATA:
             ESP_LOGI("MQTT", "MQTT_EVENT_DATA");
             printf("TOPIC=%.*s\r\n", event->topic_len, event->topic);
             printf("DATA=%.*s\r\n", event->data_len, event->data);
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+            if (topic_matches(event, topic_config_baro)) {
+                if (baro_correction_handle_config(event->data, event->data_len) != ESP_OK) {
+                    ESP_LOGW("MQTT", "Baro config rejected");
+                }
+            }
+#endif
             break;
 
         case MQTT_EVENT_ERROR:
@@ -44,11 +363,38 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
                 ESP_LOGE("MQTT", "Error type: %d, error code: %d", 
                          event->error_handle->error_type,
                          event->error_handle->esp_transport_sock_errno);
+#ifdef CONFIG_ENABLE_MQTT_TLS_RESUMPTION
+                // The client has no access to the esp-tls error of mqtt_tls
+                if (event->error_handle->error_type == MQTT_ERROR_TYPE_TCP_TRANSPORT) {
+                    int tls_code;
+                    int tls_flags;
+                    esp_err_t tls_err = mqtt_tls_get_last_error(&tls_code, &tls_flags);
+                    ESP_LOGE("MQTT", "esp-tls error: 0x%x, mbedTLS error: -0x%x, cert flags: 0x%x",
+                             tls_err, -tls_code, tls_flags);
+                }
+#endif
+#ifdef CONFIG_ENABLE_MQTT5_TOPIC_ALIASES
+                // A 3.1.1 broker answers the MQTT 5 CONNECT with return code 1
+                if (!s_fallback && event->error_handle->error_type == MQTT_ERROR_TYPE_CONNECTION_REFUSED &&
+                    (event->error_handle->connect_return_code == MQTT_CONNECTION_REFUSE_PROTOCOL ||
+                     event->error_handle->connect_return_code == MQTT5_UNSUPPORTED_PROTOCOL_VER)) {
+                    s_fallback_pending = true;
+                }
+#endif
             }
             break;
 
         case MQTT_EVENT_BEFORE_CONNECT:
             ESP_LOGE("MQTT", "MQTT_EVENT_BEFORE_CONNECT");
+#ifdef CONFIG_ENABLE_MQTT5_TOPIC_ALIASES
+            if (s_fallback_pending) {
+                ESP_LOGW("MQTT", "Broker refused MQTT 5, falling back to MQTT 3.1.1");
+                s_mqtt_config.session.protocol_ver = MQTT_PROTOCOL_V_3_1_1;
+                esp_mqtt_set_config(event->client, &s_mqtt_config);
+                s_fallback_pending = false;
+                s_fallback = true;
+            }
+#endif
             break;
 
         default:
@@ -57,6 +403,13 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     }
 }
 
+// WiFi is back: reconnect now instead of waiting for the client's reconnect timeout
+static void got_ip_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
+    if (client != NULL && !s_connected) {
+        esp_mqtt_client_reconnect(client);
+    }
+}
+
 void mqtt_setup(nmda_init_config_t* nmda_config) {
     ESP_LOGI("MQTT_SETUP", "INIT CLIENT");
     char* mqtt_server = nmda_config->mqtt_server;
@@ -71,6 +424,13 @@ void mqtt_setup(nmda_init_config_t* nmda_config) {
     if (!mqtt_server) mqtt_server = "unknown";
     if (!mqtt_port) mqtt_port = "unknown";
 
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+    snprintf(topic_config_baro, sizeof(topic_config_baro), "%s/%s/%s/config/baro",
+             nmda_config->mqtt_station ? nmda_config->mqtt_station : "default",
+             nmda_config->mqtt_experiment ? nmda_config->mqtt_experiment : "default",
+             nmda_config->mqtt_device_id ? nmda_config->mqtt_device_id : "default");
+#endif
+
     ESP_LOGI("MQTT_SETUP", "MQTT trying transport %s host %s and port %s", mqtt_transport, mqtt_server, mqtt_port);
     ESP_LOGI("MQTT_SETUP", "MQTT CA certificate: %s", mqtt_ca_cert ? "configured" : "not configured (NULL)");
 
@@ -96,44 +456,159 @@ void mqtt_setup(nmda_init_config_t* nmda_config) {
     mqttConfig.credentials.username = mqtt_user;
     mqttConfig.credentials.authentication.password = mqtt_pass;
     mqttConfig.broker.verification.certificate = mqtt_ca_cert;
+#ifdef CONFIG_ENABLE_MQTT_TLS_RESUMPTION
+    // Own TLS transport: reconnects resume the previous TLS session
+    if (mqttConfig.broker.address.transport == MQTT_TRANSPORT_OVER_SSL) {
+        mqttConfig.network.transport = mqtt_tls_transport_create(mqtt_ca_cert);
+    }
+#endif
+#ifdef CONFIG_ENABLE_MQTT_ADMISSION
+    // Hard limit inside the client on the QoS 1 replays, whatever admit() decided
+    mqttConfig.outbox.limit = MQTT_QUEUE_LIMIT;
+#endif
+
+#ifdef CONFIG_ENABLE_MQTT5_TOPIC_ALIASES
+    mqttConfig.session.protocol_ver = MQTT_PROTOCOL_V_5;
+    s_mqtt_config = mqttConfig;
+    mqtt5_init_properties();
+#endif
 
     ESP_LOGI("MSS_SEND", "MQTT initializing");
     client = esp_mqtt_client_init(&mqttConfig);
     esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, client);
+    esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, got_ip_handler, NULL);
     esp_mqtt_client_start(client);
     return (void)client;
 }
 
-void mqtt_send_mss(char* topic, char* mss) {
+bool mqtt_is_connected(void) {
+    return s_connected;
+}
+
+void mqtt_get_link_stats(mqtt_link_stats_t* stats) {
+    *stats = s_link_stats;
+    stats->offline_now_ms = (!s_connected && s_offline_since_us != 0) ?
+        (uint32_t)((esp_timer_get_time() - s_offline_since_us) / 1000) : 0;
+}
+
+// Hand a QoS 0 message to the client. With the outbox, what the client cannot take
+// (disconnected, or its buffer is full) is kept in flash and the call returns 0 as
+// if it had been sent.
+static int publish_or_store(char* topic, const char* data, int len) {
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+    if (s_connected) {
+        int msg_id = client_publish(topic, data, len, 0);
+        if (msg_id >= 0) {
+            return msg_id;
+        }
+    }
+    size_t size = (len > 0) ? (size_t)len : strlen(data);
+    if (outbox_store(topic, (const uint8_t *)data, size) == ESP_OK) {
+        return 0;
+    }
+    return -1;
+#else
+    return client_publish(topic, data, len, 0);
+#endif
+}
+
+int mqtt_send_mss(char* topic, char* mss) {
     if (client == NULL) {
         ESP_LOGW("MQTT", "Cannot publish: MQTT client not initialized");
-        return;
+        return -1;
     }
     
     // Validate pointers before using (avoid calling strlen on NULL)
     if (topic == NULL) {
         ESP_LOGE("MQTT", "Cannot publish: topic is NULL");
-        return;
+        return -1;
     }
     
     if (mss == NULL) {
         ESP_LOGE("MQTT", "Cannot publish: message is NULL");
-        return;
+        return -1;
     }
     
     // Additional safety: check that strings are not empty and are valid
     // esp_mqtt_client_publish internally calls strlen, which will panic on NULL
     if (topic[0] == '\0') {
         ESP_LOGE("MQTT", "Cannot publish: topic is empty string");
-        return;
+        return -1;
     }
     
     if (mss[0] == '\0') {
         ESP_LOGW("MQTT", "Warning: message is empty string, publishing anyway");
     }
-    
-    int msg_id = esp_mqtt_client_publish(client, topic, mss, 0, 0, false);
+
+    if (!admit(topic, strlen(mss))) {
+        return MQTT_SEND_REFUSED;
+    }
+#ifdef CONFIG_ENABLE_PUBLISH_PIPELINE
+    if (publish_pipeline_running()) {
+        return publish_pipeline_submit(topic, mss, strlen(mss));
+    }
+#endif
+    int msg_id = publish_or_store(topic, mss, 0);
     if (msg_id < 0) {
         ESP_LOGE("MQTT", "Failed to publish message to %s (error: %d)", topic ? topic : "(null)", msg_id);
     }
+    return msg_id;
+}
+
+// Publish a binary payload: the length is explicit because it may contain zero bytes
+int mqtt_send_bin(char* topic, const uint8_t* data, size_t len) {
+    if (client == NULL) {
+        ESP_LOGW("MQTT", "Cannot publish: MQTT client not initialized");
+        return -1;
+    }
+
+    if (topic == NULL || topic[0] == '\0') {
+        ESP_LOGE("MQTT", "Cannot publish: topic is NULL or empty");
+        return -1;
+    }
+
+    if (data == NULL || len == 0) {
+        ESP_LOGE("MQTT", "Cannot publish: binary payload is empty");
+        return -1;
+    }
+
+    if (!admit(topic, len)) {
+        return MQTT_SEND_REFUSED;
+    }
+#ifdef CONFIG_ENABLE_PUBLISH_PIPELINE
+    if (publish_pipeline_running()) {
+        return publish_pipeline_submit(topic, data, len);
+    }
+#endif
+    int msg_id = publish_or_store(topic, (const char *)data, (int)len);
+    if (msg_id < 0) {
+        ESP_LOGE("MQTT", "Failed to publish %u bytes to %s (error: %d)", (unsigned)len, topic, msg_id);
+    }
+    return msg_id;
+}
+
+#ifdef CONFIG_ENABLE_PUBLISH_PIPELINE
+// Network stage of the pipeline: the payload is NUL-terminated, so len 0 is an empty text
+int mqtt_publish_now(char* topic, const uint8_t* data, size_t len) {
+    return publish_or_store(topic, (const char *)data, (int)len);
+}
+#endif
+
+// QoS 1 publication whose PUBACK is reported by MQTT_EVENT_PUBLISHED; never stored
+int mqtt_send_acked(char* topic, const uint8_t* data, size_t len) {
+    if (client == NULL || !s_connected) {
+        return -1;
+    }
+#ifdef CONFIG_ENABLE_MQTT_ADMISSION
+    // The backlog is replayed only while the queue has room for low priority traffic
+    if (!queue_has_room(MQTT_PRIORITY_LOW, len)) {
+        return -1;
+    }
+#endif
+    // A zero length makes the client use strlen(): callers NUL-terminate the payload
+    int msg_id = client_publish(topic, (const char *)data, (int)len, 1);
+    if (msg_id < 0) {
+        ESP_LOGW("MQTT", "Failed to publish %u bytes to %s at QoS 1 (error: %d)", (unsigned)len, topic, msg_id);
+    }
+    return msg_id;
 }
@@ -0,0 +1,229 @@
+#include "mqtt_tls.h"
+
+#ifdef CONFIG_ENABLE_MQTT_TLS_RESUMPTION
+
+#include <string.h>
+#include <sys/select.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+#include "mbedtls/ssl.h"
+
+static const char *TAG = "MQTT_TLS";
+
+static const char *s_ca_cert = NULL;
+static esp_tls_t *s_tls = NULL;
+// Session of the last successful handshake, offered on the next connection
+static esp_tls_client_session_t *s_session = NULL;
+static mqtt_tls_stats_t s_stats;
+// esp-tls error of the last failure; the client only reads its own transports'
+static esp_err_t s_last_err = ESP_OK;
+static int s_last_tls_code = 0;
+static int s_last_tls_flags = 0;
+
+static void keep_error(void)
+{
+    esp_tls_error_handle_t error_handle;
+    if (s_tls != NULL && esp_tls_get_error_handle(s_tls, &error_handle) == ESP_OK) {
+        s_last_err = esp_tls_get_and_clear_last_error(error_handle, &s_last_tls_code, &s_last_tls_flags);
+    }
+}
+
+static void drop_session(void)
+{
+    if (s_session != NULL) {
+        esp_tls_free_client_session(s_session);
+        s_session = NULL;
+    }
+}
+
+static int tls_close(esp_transport_handle_t t)
+{
+    if (s_tls != NULL) {
+        esp_tls_conn_destroy(s_tls);
+        s_tls = NULL;
+    }
+    return 0;
+}
+
+static int tls_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    esp_tls_cfg_t cfg = {
+        .cacert_buf = (const unsigned char *)s_ca_cert,
+        .cacert_bytes = (s_ca_cert != NULL) ? strlen(s_ca_cert) + 1 : 0,
+        .timeout_ms = timeout_ms,
+        .client_session = s_session,
+    };
+    bool offered = (s_session != NULL);
+
+    tls_close(t);
+    s_tls = esp_tls_init();
+    if (s_tls == NULL) {
+        s_stats.failures++;
+        return ERR_TCP_TRANSPORT_NO_MEM;
+    }
+
+    // Low-water mark of the internal heap during the handshake only
+    size_t heap_before = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    bool monitoring = (heap_caps_monitor_local_minimum_free_size_start() == ESP_OK);
+    int64_t start_us = esp_timer_get_time();
+    int ret = esp_tls_conn_new_sync(host, strlen(host), port, &cfg, s_tls);
+    uint32_t handshake_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    uint32_t heap_used = 0;
+    if (monitoring) {
+        size_t heap_min = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+        heap_caps_monitor_local_minimum_free_size_stop();
+        heap_used = (heap_before > heap_min) ? (uint32_t)(heap_before - heap_min) : 0;
+    }
+
+    if (ret <= 0) {
+        s_stats.failures++;
+        keep_error();
+        tls_close(t);
+        // The broker may have restarted and forgotten the session: next attempt is full
+        if (offered) {
+            drop_session();
+        }
+        ESP_LOGE(TAG, "TLS connection to %s:%d failed after %lu ms", host, port, (unsigned long)handshake_ms);
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+
+    // Offering a session is no guarantee: the broker may answer with a full handshake
+    const mbedtls_ssl_context *ssl = esp_tls_get_ssl_context(s_tls);
+    bool resumed = offered && ssl != NULL && mbedtls_ssl_session_reused(ssl);
+    s_stats.handshakes++;
+    if (offered) {
+        s_stats.offered++;
+    }
+    if (resumed) {
+        s_stats.resumed++;
+        s_stats.resumed_last_ms = handshake_ms;
+    } else {
+        s_stats.full_last_ms = handshake_ms;
+    }
+    s_stats.heap_last_bytes = heap_used;
+    if (heap_used > s_stats.heap_peak_bytes) {
+        s_stats.heap_peak_bytes = heap_used;
+    }
+    ESP_LOGI(TAG, "%s handshake in %lu ms, %lu bytes of heap",
+             resumed ? "Resumed" : (offered ? "Full (session refused)" : "Full"),
+             (unsigned long)handshake_ms, (unsigned long)heap_used);
+
+    // The broker may have issued a new ticket: keep the newest session
+    esp_tls_client_session_t *session = esp_tls_get_client_session(s_tls);
+    if (session != NULL) {
+        drop_session();
+        s_session = session;
+    }
+    return 0;
+}
+
+// select() on the socket: 1 ready, 0 timeout, -1 error
+static int tls_poll(int timeout_ms, bool write)
+{
+    int fd;
+    if (s_tls == NULL || esp_tls_get_conn_sockfd(s_tls, &fd) != ESP_OK || fd < 0) {
+        return -1;
+    }
+    fd_set ready;
+    fd_set errors;
+    FD_ZERO(&ready);
+    FD_ZERO(&errors);
+    FD_SET(fd, &ready);
+    FD_SET(fd, &errors);
+    struct timeval timeout = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    int ret = select(fd + 1, write ? NULL : &ready, write ? &ready : NULL, &errors,
+                     (timeout_ms >= 0) ? &timeout : NULL);
+    if (ret > 0 && FD_ISSET(fd, &errors)) {
+        return -1;
+    }
+    return ret;
+}
+
+static int tls_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    // Records already decrypted by mbedTLS are not visible to select()
+    if (s_tls != NULL && esp_tls_get_bytes_avail(s_tls) > 0) {
+        return 1;
+    }
+    return tls_poll(timeout_ms, false);
+}
+
+static int tls_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    return tls_poll(timeout_ms, true);
+}
+
+static int tls_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    int poll = tls_poll_read(t, timeout_ms);
+    if (poll <= 0) {
+        return (poll == 0) ? ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT : poll;
+    }
+    ssize_t ret = esp_tls_conn_read(s_tls, buffer, (size_t)len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_TIMEOUT) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    if (ret == 0) {
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    }
+    if (ret < 0) {
+        keep_error();
+    }
+    return (int)ret;
+}
+
+static int tls_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    int poll = tls_poll_write(t, timeout_ms);
+    if (poll <= 0) {
+        return (poll == 0) ? ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT : poll;
+    }
+    ssize_t ret = esp_tls_conn_write(s_tls, buffer, (size_t)len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_WRITE) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    if (ret < 0) {
+        keep_error();
+    }
+    return (int)ret;
+}
+
+static int tls_destroy(esp_transport_handle_t t)
+{
+    tls_close(t);
+    drop_session();
+    return 0;
+}
+
+esp_transport_handle_t mqtt_tls_transport_create(const char *ca_cert)
+{
+    esp_transport_handle_t t = esp_transport_init();
+    if (t == NULL) {
+        ESP_LOGE(TAG, "Failed to create the TLS transport");
+        return NULL;
+    }
+    s_ca_cert = ca_cert;
+    esp_transport_set_func(t, tls_connect, tls_read, tls_write, tls_close, tls_poll_read, tls_poll_write,
+                           tls_destroy);
+    esp_transport_set_default_port(t, 8883);
+    return t;
+}
+
+void mqtt_tls_get_stats(mqtt_tls_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+esp_err_t mqtt_tls_get_last_error(int *tls_code, int *tls_flags)
+{
+    *tls_code = s_last_tls_code;
+    *tls_flags = s_last_tls_flags;
+    return s_last_err;
+}
+
+#endif // CONFIG_ENABLE_MQTT_TLS_RESUMPTION
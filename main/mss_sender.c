@@ -1,31 +1,967 @@
 #include "mqtt.h"
 #include "esp_heap_caps.h"
+#include "tm_pool.h"
+#include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
-#include "cJSON.h"
+#include <sys/time.h>
+#include "esp_timer.h"
+#include "json_writer.h"
+#include "telemetry_json.h"
+#include "telemetry_rings.h"
+#include "telemetry_schema.h"
+#include "line_writer.h"
+#include "wifi.h"
+#include "boot_timing.h"
+#include "timebase.h"
+
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+#include "rtc_window_ring.h"
+#endif
+
+#ifdef CONFIG_ENABLE_JSON_BENCHMARK
+#include "json_benchmark.h"
+#endif
+
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+#include "pburst_codec.h"
+#endif
+
+#ifdef CONFIG_ENABLE_PUBLISH_BATCHING
+#include "publish_batch.h"
+#endif
+
+#ifdef CONFIG_ENABLE_BATCH_COMPRESSION
+#include "lzss.h"
+#endif
+
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+#include "outbox.h"
+#endif
+
+#ifdef CONFIG_ENABLE_PUBLISH_PIPELINE
+#include "publish_pipeline.h"
+#endif
+
+#ifdef CONFIG_ENABLE_MQTT_TLS_RESUMPTION
+#include "mqtt_tls.h"
+#endif
 
 #define TAG "MSS_SEND"
 
+// Reusable output buffer of the JSON writer: only mss_sender serializes, and
+// mqtt_send_mss() is done with the payload when it returns
+static char s_json_buf[CONFIG_MSS_JSON_BUFFER_SIZE];
+// Messages whose timestamps were converted from esp_timer to Unix time
+static uint32_t s_backfilled = 0;
+// Messages published with the provisional RTC time (flagged time_provisional)
+static uint32_t s_provisional = 0;
 
-void mss_sender(void *parameters) {
-	struct telemetry_message message;
+#ifdef CONFIG_ENABLE_PUBLISH_JITTER
+// pcnt windows close at the same instant on every device of the fleet: each
+// device publishes them s_jitter_us later, an offset hashed from its device id
+#define JITTER_SLOTS 2
+static struct telemetry_message s_deferred[JITTER_SLOTS];
+static int64_t s_deferred_due_us[JITTER_SLOTS];
+static size_t s_deferred_count = 0;
+static int64_t s_jitter_us = 0;
+#endif
+
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+// Seq following the newest pcnt window taken from the rings: the later windows
+// of this boot are still in the pcnt ring
+static uint32_t s_window_next_seq = 0;
+#endif
+
+#ifdef CONFIG_ENABLE_EARLY_ACQUISITION
+// Messages taken from the rings while the time is unknown, oldest first. The
+// rings keep draining during a slow SNTP start, so the small pburst and detect
+// rings do not overflow; the backlog is backfilled and published once a time
+// base exists, before anything newer.
+static struct telemetry_message s_early[CONFIG_EARLY_BACKLOG_SIZE];
+static size_t s_early_head = 0;
+static size_t s_early_count = 0;
+static uint32_t s_early_held = 0;
+static uint32_t s_early_dropped = 0;
+
+static struct telemetry_message *early_at(size_t i)
+{
+    return &s_early[(s_early_head + i) % CONFIG_EARLY_BACKLOG_SIZE];
+}
+
+// Full backlog: drop the oldest pulse burst or detection (the high-rate streams),
+// or the oldest message if it holds none
+static void early_drop_one(void)
+{
+    size_t victim = 0;
+    for (size_t i = 0; i < s_early_count; i++) {
+        uint8_t type = early_at(i)->tm_message_type;
+        if (type == TM_RMT_PULSE_EVENT || type == TM_PULSE_DETECTION) {
+            victim = i;
+            break;
+        }
+    }
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+    if (early_at(victim)->tm_message_type == TM_RMT_PULSE_EVENT) {
+        tm_pool_free(early_at(victim)->payload.tm_rmt_pulse_event.pulses);
+    }
+#endif
+    for (size_t i = victim; i + 1 < s_early_count; i++) {
+        *early_at(i) = *early_at(i + 1);
+    }
+    s_early_count--;
+    s_early_dropped++;
+}
+
+static void early_hold(const struct telemetry_message *message)
+{
+    if (s_early_count == CONFIG_EARLY_BACKLOG_SIZE) {
+        early_drop_one();
+    }
+    *early_at(s_early_count++) = *message;
+    s_early_held++;
+}
+
+static bool early_take(struct telemetry_message *message)
+{
+    if (s_early_count == 0) {
+        return false;
+    }
+    *message = *early_at(0);
+    s_early_head = (s_early_head + 1) % CONFIG_EARLY_BACKLOG_SIZE;
+    s_early_count--;
+    return true;
+}
+#endif
+
+// {base}/{service} of every entry of telemetry_schemas, same index
+static char s_topics[TELEMETRY_SCHEMA_MAX][80 + 16];
+
+#ifdef CONFIG_ENABLE_PUBLISH_BATCHING
+// pburst and detect records are small and frequent: they are grouped per topic
+// into one payload of up to CONFIG_PUBLISH_BATCH_MAX_BYTES
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+static uint8_t s_pburst_batch_buf[CONFIG_PUBLISH_BATCH_MAX_BYTES];
+static publish_batch_t s_pburst_batch;
+#endif
 #ifdef CONFIG_ENABLE_GPIO_PULSE_DETECTION
-    int64_t last_event_time = 0;
+static uint8_t s_detect_batch_buf[CONFIG_PUBLISH_BATCH_MAX_BYTES];
+static publish_batch_t s_detect_batch;
 #endif
-    nmda_init_config_t* nmda_config = (nmda_init_config_t*) parameters;
-    char topic_base[80];
-    char topic_status[80 + strlen("status") + 1];
-    char topic_pcnt[80 + strlen("pcnt") + 1];
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+// telemetry_format=influx: the types with a line encoder are written straight
+// into one batch of lines on {base}/influx
+static bool s_influx = false;
+static char s_influx_topic[80 + 8];
+static char s_influx_tags[3 * 80];
+static uint8_t s_line_batch_buf[CONFIG_PUBLISH_BATCH_MAX_BYTES];
+static publish_batch_t s_line_batch;
+#endif
+
+// Earliest time at which a pending batch must be published (INT64_MAX if none)
+static int64_t batches_deadline_us(void)
+{
+    int64_t deadline = INT64_MAX;
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+    int64_t pburst_deadline = publish_batch_deadline_us(&s_pburst_batch);
+    if (pburst_deadline < deadline) deadline = pburst_deadline;
+#endif
+#ifdef CONFIG_ENABLE_GPIO_PULSE_DETECTION
+    int64_t detect_deadline = publish_batch_deadline_us(&s_detect_batch);
+    if (detect_deadline < deadline) deadline = detect_deadline;
+#endif
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+    int64_t line_deadline = publish_batch_deadline_us(&s_line_batch);
+    if (line_deadline < deadline) deadline = line_deadline;
+#endif
+    return deadline;
+}
+
+static void batches_poll(int64_t now_us)
+{
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+    publish_batch_poll(&s_pburst_batch, now_us);
+#endif
+#ifdef CONFIG_ENABLE_GPIO_PULSE_DETECTION
+    publish_batch_poll(&s_detect_batch, now_us);
+#endif
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+    publish_batch_poll(&s_line_batch, now_us);
+#endif
+}
+
+static void add_batch_stats(json_writer_t *writer, const char *name, const publish_batch_stats_t *stats)
+{
+    char key[40];
+
+    snprintf(key, sizeof(key), "batch_%s_batches", name);
+    json_writer_string_uint(writer, key, stats->batches);
+    snprintf(key, sizeof(key), "batch_%s_records", name);
+    json_writer_string_uint(writer, key, stats->records);
+    snprintf(key, sizeof(key), "batch_%s_max_records", name);
+    json_writer_string_uint(writer, key, stats->max_records);
+    snprintf(key, sizeof(key), "batch_%s_bytes", name);
+    json_writer_string_uint(writer, key, stats->bytes);
+    for (int r = 0; r < PUBLISH_BATCH_FLUSH_REASONS; r++) {
+        snprintf(key, sizeof(key), "batch_%s_flush_%s", name, publish_batch_flush_name((publish_batch_flush_t)r));
+        json_writer_string_uint(writer, key, stats->flushes[r]);
+    }
+    snprintf(key, sizeof(key), "batch_%s_failed", name);
+    json_writer_string_uint(writer, key, stats->failed);
+    snprintf(key, sizeof(key), "batch_%s_lost_records", name);
+    json_writer_string_uint(writer, key, stats->lost_records);
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+    snprintf(key, sizeof(key), "batch_%s_stored", name);
+    json_writer_string_uint(writer, key, stats->stored);
+#endif
+    // Queueing delay: how long the oldest record of each batch waited for the flush
+    snprintf(key, sizeof(key), "batch_%s_delay_avg_us", name);
+    json_writer_string_uint(writer, key, stats->batches ? stats->delay_sum_us / stats->batches : 0);
+    snprintf(key, sizeof(key), "batch_%s_delay_max_us", name);
+    json_writer_string_uint(writer, key, stats->delay_max_us);
+#ifdef CONFIG_ENABLE_BATCH_COMPRESSION
+    // Every compressed batch, or a sample of one in 16 when publishing uncompressed
+    snprintf(key, sizeof(key), "batch_%s_lz_in_bytes", name);
+    json_writer_string_uint(writer, key, stats->lz_in_bytes);
+    snprintf(key, sizeof(key), "batch_%s_lz_out_bytes", name);
+    json_writer_string_uint(writer, key, stats->lz_out_bytes);
+    snprintf(key, sizeof(key), "batch_%s_lz_ratio", name);
+    json_writer_string_float(writer, key,
+                             stats->lz_out_bytes ? (double)stats->lz_in_bytes / (double)stats->lz_out_bytes : 0.0, 2);
+    snprintf(key, sizeof(key), "batch_%s_lz_incompressible", name);
+    json_writer_string_uint(writer, key, stats->lz_incompressible);
+    snprintf(key, sizeof(key), "batch_%s_lz_cpu_us", name);
+    json_writer_string_uint(writer, key, stats->lz_cpu_us);
+    snprintf(key, sizeof(key), "batch_%s_lz_cpu_avg_us", name);
+    json_writer_string_uint(writer, key, stats->lz_batches ? stats->lz_cpu_us / stats->lz_batches : 0);
+#endif
+}
+#endif
+
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+// Serialize one message in place at the end of the line batch
+static bool batch_line(const telemetry_schema_t *schema, const struct telemetry_message *message)
+{
+    for (int attempt = 0; attempt < 2; attempt++) {
+        size_t room;
+        line_writer_t writer;
+        char *tail = (char *)publish_batch_tail(&s_line_batch, &room);
+        line_writer_init(&writer, tail, room, s_influx_tags);
+        size_t len = schema->line(&writer, message);
+        if (len > 0) {
+            publish_batch_commit(&s_line_batch, len, esp_timer_get_time());
+            return true;
+        }
+        if (s_line_batch.records == 0) {
+            break;
+        }
+        // Did not fit after the pending lines: publish them and retry on an empty batch
+        publish_batch_flush(&s_line_batch, PUBLISH_BATCH_FLUSH_SIZE, esp_timer_get_time());
+    }
+    ESP_LOGE(TAG, "Line for %s does not fit in a %d-byte batch", schema->service, CONFIG_PUBLISH_BATCH_MAX_BYTES);
+    return false;
+}
+#endif
+
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+// pburst_format setting: binary payloads on {base}/pburst instead of JSON
+static bool s_pburst_binary = false;
+// Size of every pburst in both encodings, in binary mode only (see {base}/stats)
+static uint32_t s_pburst_msgs = 0;
+static uint64_t s_pburst_json_bytes = 0;
+static uint64_t s_pburst_bin_bytes = 0;
+
+// Publish a TM_RMT_PULSE_EVENT in the configured format; in binary mode also
+// account the size the JSON document would have had
+static void send_pburst(char *topic_pburst, const struct telemetry_message *message)
+{
+    json_writer_t writer;
+    size_t bin_len = 0;
+
+    // The binary encoding goes first into the shared buffer: it is published right
+    // away, and the JSON document overwrites it afterwards
+    if (s_pburst_binary) {
+        bin_len = pburst_encode((uint8_t *)s_json_buf, sizeof(s_json_buf), message);
+    }
+    if (bin_len > 0) {
+#ifdef CONFIG_ENABLE_PUBLISH_BATCHING
+        publish_batch_add(&s_pburst_batch, s_json_buf, bin_len, esp_timer_get_time());
+#else
+        mqtt_send_bin(topic_pburst, (const uint8_t *)s_json_buf, bin_len);
+#endif
+    }
+
+    json_writer_init(&writer, s_json_buf, sizeof(s_json_buf));
+    const char *json_string = telemetry_json_pburst(&writer, message);
+    if (json_string == NULL) {
+        ESP_LOGE(TAG, "Failed to serialize JSON for RMT_PULSE_EVENT (%u pulses, buffer %u bytes)",
+                 message->payload.tm_rmt_pulse_event.symbols, (unsigned)sizeof(s_json_buf));
+    } else if (!s_pburst_binary || bin_len == 0) {
+#ifdef CONFIG_ENABLE_PUBLISH_BATCHING
+        if (s_pburst_binary) {
+            // Binary batches cannot carry a JSON record
+            mqtt_send_mss(topic_pburst, (char *)json_string);
+        } else {
+            publish_batch_add(&s_pburst_batch, json_string, writer.len, esp_timer_get_time());
+        }
+#else
+        mqtt_send_mss(topic_pburst, (char *)json_string);
+#endif
+    }
+
+    if (json_string != NULL && bin_len > 0) {
+        s_pburst_msgs++;
+        s_pburst_json_bytes += writer.len;
+        s_pburst_bin_bytes += bin_len;
+    }
+}
+#endif
+
+// Serialize and publish a TM_PULSE_COUNT message.
+// Returns the MQTT message id (negative if the message could not be published).
+static int send_pulse_count(char *topic_pcnt, const struct telemetry_message *message)
+{
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+    if (s_influx) {
+        // The window closes the line batch, so it is only marked published once it is out
+        if (!batch_line(telemetry_schema_find(TM_PULSE_COUNT), message)) {
+            return -1;
+        }
+        ESP_LOGI(TAG, "Publishing PULSECOUNT on %s: seq=%lu (line protocol, %lu lines)", s_influx_topic,
+                 (unsigned long)message->payload.tm_pcnt.seq, (unsigned long)s_line_batch.records);
+        if (s_line_batch.records == 0) {
+            // The window's line filled the batch and publish_batch_commit() already sent it
+            return s_line_batch.last_msg_id;
+        }
+        return publish_batch_flush(&s_line_batch, PUBLISH_BATCH_FLUSH_FORCED, esp_timer_get_time());
+    }
+#endif
+    json_writer_t writer;
+    json_writer_init(&writer, s_json_buf, sizeof(s_json_buf));
+    const char *json_string = telemetry_json_pulse_count(&writer, message);
+    if (json_string == NULL) {
+        ESP_LOGE(TAG, "Failed to serialize JSON for PULSE_COUNT");
+        return -1;
+    }
+
+    ESP_LOGI(TAG, "Publishing PULSECOUNT on %s: seq=%lu, ch1=%lu, ch2=%lu, ch3=%lu, interval=%u",
+             topic_pcnt,
+             (unsigned long)message->payload.tm_pcnt.seq,
+             (unsigned long)message->payload.tm_pcnt.channel[0],
+             (unsigned long)message->payload.tm_pcnt.channel[1],
+             (unsigned long)message->payload.tm_pcnt.channel[2],
+             message->payload.tm_pcnt.integration_time_sec);
+    int msg_id = mqtt_send_mss(topic_pcnt, (char *)json_string);
+    if (msg_id >= 0) {
+        ESP_LOGI(TAG, "PULSECOUNT message published successfully");
+    }
+
+    return msg_id;
+}
+
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+// A published window is not replayed. With the pipeline the publication was
+// only queued: the network task marks the window once the client took it.
+static void mark_window_published(uint32_t seq)
+{
+#ifdef CONFIG_ENABLE_PUBLISH_PIPELINE
+    if (publish_pipeline_running()) {
+        if (publish_pipeline_mark_window(seq) != 0) {
+            ESP_LOGW(TAG, "Window seq %lu stays pending: pipeline full", (unsigned long)seq);
+        }
+        return;
+    }
+#endif
+    rtc_window_ring_mark_published(seq);
+}
+
+// Republish the windows that were closed but never published before the last
+// reset (before_seq = rtc_window_ring_boot_seq()) or during an outage
+static void replay_rtc_windows(char *topic_pcnt, uint32_t before_seq)
+{
+    rtc_window_record_t record;
+    struct telemetry_message message;
+    int64_t last_seq = -1;
+    uint32_t replayed = 0;
+
+    if (timebase_is_synced()) {
+        rtc_window_ring_backfill();
+    }
+    ESP_LOGI(TAG, "Replaying %lu pending windows from RTC memory",
+             (unsigned long)rtc_window_ring_pending_count());
+
+    while (rtc_window_ring_get_pending(last_seq, &record) && record.seq < before_seq) {
+        last_seq = record.seq;
+        // Not yet placed in time: wait for the synchronization
+        if (!timebase_is_unix(record.start_timestamp) || !timebase_is_unix(record.end_timestamp)) {
+            break;
+        }
+
+        message.tm_message_type = TM_PULSE_COUNT;
+        message.time_flags = 0;
+        message.timestamp = record.end_timestamp;
+        message.payload.tm_pcnt.start_timestamp = record.start_timestamp;
+        message.payload.tm_pcnt.integration_time_sec = (uint8_t)record.integration_time_sec;
+        message.payload.tm_pcnt.channel[0] = record.channel[0];
+        message.payload.tm_pcnt.channel[1] = record.channel[1];
+        message.payload.tm_pcnt.channel[2] = record.channel[2];
+        message.payload.tm_pcnt.seq = record.seq;
+#ifdef CONFIG_ENABLE_PCNT_GATE
+        message.payload.tm_pcnt.gated[0] = record.gated[0];
+        message.payload.tm_pcnt.gated[1] = record.gated[1];
+        message.payload.tm_pcnt.gated[2] = record.gated[2];
+#endif
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+        message.payload.tm_pcnt.rmt[0] = record.rmt[0];
+        message.payload.tm_pcnt.rmt[1] = record.rmt[1];
+        message.payload.tm_pcnt.rmt[2] = record.rmt[2];
+#endif
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+        message.payload.tm_pcnt.pressure_hpa = record.pressure_hpa;
+        message.payload.tm_pcnt.baro_beta = record.baro_beta;
+        message.payload.tm_pcnt.baro_p0_hpa = record.baro_p0_hpa;
+#endif
+
+        if (send_pulse_count(topic_pcnt, &message) < 0) {
+            ESP_LOGW(TAG, "Replay of window seq %lu failed, will retry after next reset",
+                     (unsigned long)record.seq);
+            break;
+        }
+        mark_window_published(record.seq);
+        replayed++;
+    }
+
+    ESP_LOGI(TAG, "Replayed %lu windows from RTC memory", (unsigned long)replayed);
+}
+
+// Replay after an outage stops below the windows still on their way: not yet
+// taken from the pcnt ring, held back by the publish offset or until the time is known
+static uint32_t replay_limit_seq(void)
+{
+    uint32_t limit = s_window_next_seq;
+#ifdef CONFIG_ENABLE_PUBLISH_JITTER
+    for (size_t i = 0; i < s_deferred_count; i++) {
+        if (s_deferred[i].tm_message_type == TM_PULSE_COUNT && s_deferred[i].payload.tm_pcnt.seq < limit) {
+            limit = s_deferred[i].payload.tm_pcnt.seq;
+        }
+    }
+#endif
+#ifdef CONFIG_ENABLE_EARLY_ACQUISITION
+    // Held until the time is known
+    for (size_t i = 0; i < s_early_count; i++) {
+        const struct telemetry_message *held = early_at(i);
+        if (held->tm_message_type == TM_PULSE_COUNT && held->payload.tm_pcnt.seq < limit) {
+            limit = held->payload.tm_pcnt.seq;
+        }
+    }
+#endif
+    return limit;
+}
+
+// Windows handed to the network task are marked by it once sent: until it has
+// dealt with all of them, a pending window may just be in its queue
+static bool windows_in_flight(void)
+{
+#ifdef CONFIG_ENABLE_PUBLISH_PIPELINE
+    return publish_pipeline_windows_queued() > 0;
+#else
+    return false;
+#endif
+}
+#endif
+
+// The stats are published as several documents on {base}/stats so that each
+// one fits in s_json_buf whatever options are enabled. All parts of a round
+// carry the same datetime, so a time-series backend merges them into one point.
+static void stats_part_begin(json_writer_t *writer, int64_t datetime, int part)
+{
+    json_writer_init(writer, s_json_buf, sizeof(s_json_buf));
+    json_writer_begin_object(writer, NULL);
+    json_writer_string_int(writer, "datetime", datetime);
+    json_writer_string_int(writer, "part", part);
+}
+
+static void stats_part_publish(json_writer_t *writer, char *topic_stats, int part)
+{
+    json_writer_end_object(writer);
+    const char *json_string = json_writer_finish(writer);
+    if (json_string == NULL) {
+        ESP_LOGE(TAG, "Failed to serialize JSON for STATS part %d", part);
+        return;
+    }
+    mqtt_send_mss(topic_stats, (char *)json_string);
+}
+
+// Publish the telemetry ring and pool counters on {base}/stats
+static void send_stats(char *topic_stats)
+{
+    struct timeval tv_now;
+    json_writer_t writer;
+    char key[32];
+    char value_str[24];
+    size_t n;
+
+    gettimeofday(&tv_now, NULL);
+    int64_t datetime = (int64_t)tv_now.tv_sec * 1000000LL + (int64_t)tv_now.tv_usec;
+
+    // Part 1: telemetry rings, pools and heap
+    stats_part_begin(&writer, datetime, 1);
+
+    for (int i = 0; i < TELEMETRY_STREAM_COUNT; i++) {
+        telemetry_ring_stats_t stats;
+        const char *name = telemetry_stream_name((telemetry_stream_t)i);
+        telemetry_ring_get_stats((telemetry_stream_t)i, &stats);
+
+        snprintf(key, sizeof(key), "ring_%s_pushed", name);
+        json_writer_string_uint(&writer, key, stats.pushed);
+        snprintf(key, sizeof(key), "ring_%s_dropped", name);
+        json_writer_string_uint(&writer, key, stats.dropped);
+        snprintf(key, sizeof(key), "ring_%s_hwm", name);
+        n = json_format_uint(value_str, stats.high_water);
+        value_str[n++] = '/';
+        json_format_uint(value_str + n, stats.capacity);
+        json_writer_string(&writer, key, value_str);
+
+        if (stats.dropped > 0) {
+            ESP_LOGW(TAG, "Ring %s: %lu dropped (high water %lu/%lu)", name, (unsigned long)stats.dropped,
+                     (unsigned long)stats.high_water, (unsigned long)stats.capacity);
+        }
+    }
+
+    // Pool size classes: high-water against capacity to size the pools from field data
+    for (int i = 0; i < TM_POOL_CLASSES; i++) {
+        tm_pool_class_stats_t class_stats;
+        tm_pool_get_class_stats(i, &class_stats);
+
+        snprintf(key, sizeof(key), "pool_%lu_hwm", (unsigned long)class_stats.block_size);
+        n = json_format_uint(value_str, class_stats.high_water);
+        value_str[n++] = '/';
+        json_format_uint(value_str + n, class_stats.blocks);
+        json_writer_string(&writer, key, value_str);
+        snprintf(key, sizeof(key), "pool_%lu_exhausted", (unsigned long)class_stats.block_size);
+        json_writer_string_uint(&writer, key, class_stats.exhausted);
+    }
+
+    tm_pool_stats_t pool_stats;
+    tm_pool_get_stats(&pool_stats);
+    json_writer_string_uint(&writer, "pool_heap_fallback", pool_stats.heap_fallback);
+    json_writer_string_uint(&writer, "pool_failed", pool_stats.failed);
+
+    // Internal heap: a largest free block that keeps shrinking while the free size is
+    // stable means fragmentation
+    json_writer_string_uint(&writer, "heap_free", heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    json_writer_string_uint(&writer, "heap_largest_block", heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+
+    stats_part_publish(&writer, topic_stats, 1);
+
+    // Part 2: network links
+    stats_part_begin(&writer, datetime, 2);
+    // Link outages: the device reconnects with backoff instead of restarting
+    wifi_link_stats_t wifi_stats;
+    wifi_get_link_stats(&wifi_stats);
+    json_writer_string_uint(&writer, "wifi_disconnects", wifi_stats.disconnects);
+    json_writer_string_uint(&writer, "wifi_reconnect_attempts", wifi_stats.attempts);
+    json_writer_string_uint(&writer, "wifi_offline_last_ms", wifi_stats.offline_last_ms);
+    json_writer_string_uint(&writer, "wifi_offline_max_ms", wifi_stats.offline_max_ms);
+    json_writer_string_uint(&writer, "wifi_offline_total_ms", wifi_stats.offline_total_ms);
+    json_writer_string_uint(&writer, "wifi_last_reason", wifi_stats.last_reason);
+    mqtt_link_stats_t mqtt_stats;
+    mqtt_get_link_stats(&mqtt_stats);
+    json_writer_string_uint(&writer, "mqtt_disconnects", mqtt_stats.disconnects);
+    json_writer_string_uint(&writer, "mqtt_offline_last_ms", mqtt_stats.offline_last_ms);
+    json_writer_string_uint(&writer, "mqtt_offline_max_ms", mqtt_stats.offline_max_ms);
+    json_writer_string_uint(&writer, "mqtt_offline_total_ms", mqtt_stats.offline_total_ms);
+#ifdef CONFIG_ENABLE_MQTT_TLS_RESUMPTION
+    mqtt_tls_stats_t tls_stats;
+    mqtt_tls_get_stats(&tls_stats);
+    json_writer_string_uint(&writer, "tls_handshakes", tls_stats.handshakes);
+    json_writer_string_uint(&writer, "tls_offered", tls_stats.offered);
+    json_writer_string_uint(&writer, "tls_resumed", tls_stats.resumed);
+    json_writer_string_uint(&writer, "tls_failures", tls_stats.failures);
+    json_writer_string_uint(&writer, "tls_full_ms", tls_stats.full_last_ms);
+    json_writer_string_uint(&writer, "tls_resumed_ms", tls_stats.resumed_last_ms);
+    json_writer_string_uint(&writer, "tls_heap_last", tls_stats.heap_last_bytes);
+    json_writer_string_uint(&writer, "tls_heap_peak", tls_stats.heap_peak_bytes);
+#endif
+#ifdef CONFIG_ENABLE_MQTT5_TOPIC_ALIASES
+    mqtt5_stats_t mqtt5_stats;
+    mqtt_get_mqtt5_stats(&mqtt5_stats);
+    json_writer_string(&writer, "mqtt_protocol", mqtt5_stats.mqtt5 ? "5" : "3.1.1");
+    json_writer_string(&writer, "mqtt5_fallback", mqtt5_stats.fallback ? "1" : "0");
+    json_writer_string_uint(&writer, "mqtt5_aliased", mqtt5_stats.aliased);
+    json_writer_string_uint(&writer, "mqtt5_topic_bytes_saved", mqtt5_stats.topic_bytes_saved);
+    json_writer_string_uint(&writer, "mqtt5_property_bytes", mqtt5_stats.property_bytes);
+    json_writer_string_int(&writer, "mqtt5_bytes_saved",
+                           (int64_t)mqtt5_stats.topic_bytes_saved - (int64_t)mqtt5_stats.property_bytes);
+#endif
+
+    stats_part_publish(&writer, topic_stats, 2);
+
+    // Part 3: time base and payload formats
+    stats_part_begin(&writer, datetime, 3);
+    // Acquisition starts before the time is known: messages converted afterwards
+    timebase_stats_t time_stats;
+    timebase_get_stats(&time_stats);
+    json_writer_string(&writer, "time_synced", time_stats.state == TIMEBASE_SYNCED ? "1" : "0");
+    json_writer_string_uint(&writer, "time_backfilled", s_backfilled);
+#ifdef CONFIG_ENABLE_EARLY_ACQUISITION
+    json_writer_string_uint(&writer, "time_early_held", s_early_held);
+    json_writer_string_uint(&writer, "time_early_dropped", s_early_dropped);
+#endif
+#ifdef CONFIG_ENABLE_PUBLISH_JITTER
+    json_writer_string_uint(&writer, "publish_offset_ms", (uint32_t)(s_jitter_us / 1000));
+#endif
+#ifdef CONFIG_ENABLE_RTC_WALL_CLOCK
+    json_writer_string_uint(&writer, "time_provisional", s_provisional);
+    json_writer_string_uint(&writer, "time_provisional_error_ms", time_stats.provisional_error_ms);
+    json_writer_string_int(&writer, "time_correction_ms", time_stats.correction_ms);
+    json_writer_string_uint(&writer, "time_rtc_confidence", time_stats.confidence);
+#endif
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+    json_writer_string(&writer, "pburst_format", s_pburst_binary ? "binary" : "json");
+    json_writer_string_uint(&writer, "pburst_msgs", s_pburst_msgs);
+    json_writer_string_uint(&writer, "pburst_json_bytes", s_pburst_json_bytes);
+    json_writer_string_uint(&writer, "pburst_bin_bytes", s_pburst_bin_bytes);
+#endif
+#ifdef CONFIG_ENABLE_PUBLISH_BATCHING
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+    add_batch_stats(&writer, "pburst", &s_pburst_batch.stats);
+#endif
+#ifdef CONFIG_ENABLE_GPIO_PULSE_DETECTION
+    add_batch_stats(&writer, "detect", &s_detect_batch.stats);
+#endif
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+    json_writer_string(&writer, "telemetry_format", s_influx ? "influx" : "json");
+    add_batch_stats(&writer, "influx", &s_line_batch.stats);
+#endif
+#endif
+    stats_part_publish(&writer, topic_stats, 3);
+
+    // Part 4: publication path
+    stats_part_begin(&writer, datetime, 4);
+#ifdef CONFIG_ENABLE_PUBLISH_PIPELINE
+    // Network stage: queue depth and occupancy (the telemetry rings above are the serializer's queues)
+    static uint64_t last_busy_us = 0;
+    static int64_t last_stats_us = 0;
+    int64_t now_us = esp_timer_get_time();
+    publish_pipeline_stats_t pipeline;
+    publish_pipeline_get_stats(&pipeline);
+    json_writer_string_uint(&writer, "pipeline_submitted", pipeline.submitted);
+    json_writer_string_uint(&writer, "pipeline_published", pipeline.published);
+    json_writer_string_uint(&writer, "pipeline_failed", pipeline.failed);
+    json_writer_string_uint(&writer, "pipeline_dropped", pipeline.dropped);
+    n = json_format_uint(value_str, pipeline.depth_max);
+    value_str[n++] = '/';
+    json_format_uint(value_str + n, pipeline.capacity);
+    json_writer_string(&writer, "pipeline_hwm", value_str);
+    json_writer_string_uint(&writer, "pipeline_bytes_max", pipeline.bytes_max);
+    json_writer_string_uint(&writer, "pipeline_wait_avg_us",
+                            pipeline.published + pipeline.failed > 0 ?
+                            pipeline.wait_sum_us / (pipeline.published + pipeline.failed) : 0);
+    json_writer_string_uint(&writer, "pipeline_wait_max_us", pipeline.wait_max_us);
+    json_writer_string_uint(&writer, "pipeline_submit_block_us", pipeline.submit_block_us);
+    if (last_stats_us != 0 && now_us > last_stats_us) {
+        json_writer_string_uint(&writer, "pipeline_busy_pct",
+                                (pipeline.busy_us - last_busy_us) * 100 / (uint64_t)(now_us - last_stats_us));
+    }
+    last_busy_us = pipeline.busy_us;
+    last_stats_us = now_us;
+#endif
+#ifdef CONFIG_ENABLE_MQTT_ADMISSION
+    mqtt_admission_stats_t admission;
+    mqtt_get_admission_stats(&admission);
+    json_writer_string_uint(&writer, "mqtt_queue_bytes", admission.queue_bytes);
+    json_writer_string_uint(&writer, "mqtt_queue_peak", admission.queue_peak);
+    json_writer_string_uint(&writer, "mqtt_queue_limit", admission.queue_limit);
+    uint32_t refused;
+    const char *service;
+    for (size_t i = 0; (service = mqtt_admission_refused(i, &refused)) != NULL; i++) {
+        snprintf(key, sizeof(key), "mqtt_refused_%s", service);
+        json_writer_string_uint(&writer, key, refused);
+    }
+#endif
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+    outbox_stats_t outbox_stats;
+    outbox_get_stats(&outbox_stats);
+    json_writer_string_uint(&writer, "outbox_pending", outbox_stats.pending);
+    json_writer_string_uint(&writer, "outbox_bytes", outbox_stats.pending_bytes);
+    json_writer_string_uint(&writer, "outbox_oldest_age_s", outbox_stats.oldest_age_s);
+    json_writer_string_uint(&writer, "outbox_stored", outbox_stats.stored);
+    json_writer_string_uint(&writer, "outbox_replayed", outbox_stats.replayed);
+    json_writer_string_uint(&writer, "outbox_dropped", outbox_stats.dropped);
+    json_writer_string_uint(&writer, "outbox_too_large", outbox_stats.too_large);
+    json_writer_string_uint(&writer, "outbox_errors", outbox_stats.errors);
+    json_writer_string_uint(&writer, "outbox_capacity", outbox_stats.capacity_bytes);
+#endif
+    stats_part_publish(&writer, topic_stats, 4);
+}
+
+// First status message: boot milestones and how the network came up
+static void send_boot_status(char *topic_status)
+{
+    json_writer_t writer;
+    char key[32];
+
+    json_writer_init(&writer, s_json_buf, sizeof(s_json_buf));
+    json_writer_begin_object(&writer, NULL);
+    json_writer_string(&writer, "status", "mss_sender is running");
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        snprintf(key, sizeof(key), "boot_%s_ms", boot_timing_name((boot_phase_t)i));
+        json_writer_string_uint(&writer, key, boot_timing_get_ms((boot_phase_t)i));
+    }
+    json_writer_string(&writer, "wifi_fast_connect", wifi_fast_connect_name(wifi_get_fast_connect()));
+    json_writer_string(&writer, "ip_mode", wifi_static_ip_enabled() ? "static" : "dhcp");
+    json_writer_end_object(&writer);
+
+    const char *json_string = json_writer_finish(&writer);
+    if (json_string == NULL) {
+        ESP_LOGE(TAG, "Failed to serialize JSON for STATUS");
+        mqtt_send_mss(topic_status, "mss_sender is running");
+        return;
+    }
+    mqtt_send_mss(topic_status, (char *)json_string);
+}
+
+// Topic of a registered message type
+static char *topic_for(uint8_t type)
+{
+    const telemetry_schema_t *schema = telemetry_schema_find(type);
+    return schema ? s_topics[schema - telemetry_schemas] : NULL;
+}
+
+// Default publication: the registry encoder, then one MQTT message
+static void publish_json(const telemetry_schema_t *schema, char *topic, struct telemetry_message *message)
+{
+    json_writer_t writer;
+    json_writer_init(&writer, s_json_buf, sizeof(s_json_buf));
+    const char *json_string = schema->json(&writer, message);
+    if (json_string == NULL) {
+        ESP_LOGE(TAG, "Failed to serialize JSON for %s", schema->service);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Publishing %s on %s", schema->service, topic);
+    mqtt_send_mss(topic, (char *)json_string);
+}
+
+// Message types whose publication does more than publish_json()
+typedef void (*publish_hook_t)(char *topic, struct telemetry_message *message);
+
+static void publish_pulse_count(char *topic, struct telemetry_message *message)
+{
+    int msg_id = send_pulse_count(topic, message);
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+    if (msg_id >= 0) {
+        mark_window_published(message->payload.tm_pcnt.seq);
+    }
+#else
+    (void)msg_id;
+#endif
+}
+
+#ifdef CONFIG_ENABLE_GPIO_PULSE_DETECTION
+static void publish_detection(char *topic, struct telemetry_message *message)
+{
+    static int64_t last_event_time = 0;
+    json_writer_t writer;
+
+    json_writer_init(&writer, s_json_buf, sizeof(s_json_buf));
+    const char *json_string = telemetry_schema_json(&writer, message);
+    if (json_string == NULL) {
+        ESP_LOGE(TAG, "Failed to serialize JSON for PULSE_DETECTION");
+        return;
+    }
+
+    ESP_LOGI(TAG, "Publishing DETECTOR %lu,%lu,%lu at %lld delta %lld us",
+             (unsigned long)message->payload.tm_detect.channel[0],
+             (unsigned long)message->payload.tm_detect.channel[1],
+             (unsigned long)message->payload.tm_detect.channel[2],
+             message->timestamp,
+             message->timestamp - last_event_time);
+    last_event_time = message->timestamp;
+#ifdef CONFIG_ENABLE_PUBLISH_BATCHING
+    publish_batch_add(&s_detect_batch, json_string, writer.len, esp_timer_get_time());
+#else
+    mqtt_send_mss(topic, (char *)json_string);
+#endif
+}
+#endif
+
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+static void publish_pulse_event(char *topic, struct telemetry_message *message)
+{
+    // Validate message data first
+    if (message->payload.tm_rmt_pulse_event.pulses == NULL) {
+        ESP_LOGE(TAG, "RMT pulse event has NULL pulses array (symbols=%u)",
+                 message->payload.tm_rmt_pulse_event.symbols);
+        return;
+    }
+
+    if (message->payload.tm_rmt_pulse_event.symbols == 0) {
+        ESP_LOGW(TAG, "RMT pulse event has 0 symbols, skipping");
+    } else {
+        send_pburst(topic, message);
+    }
+
+    // Free the pooled pulses array after sending
+    tm_pool_free(message->payload.tm_rmt_pulse_event.pulses);
+    message->payload.tm_rmt_pulse_event.pulses = NULL;
+}
+#endif
+
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+static void publish_gle_alert(char *topic, struct telemetry_message *message)
+{
+    static int64_t max_alert_latency_us = 0;
+
+    publish_json(telemetry_schema_find(TM_GLE_ALERT), topic, message);
+
+    int64_t latency_us = esp_timer_get_time() - message->payload.tm_alert.bin_start_us;
+    if (latency_us > max_alert_latency_us) {
+        max_alert_latency_us = latency_us;
+    }
+    ESP_LOGW(TAG, "GLE alert published on %s: %lld us after bin start (max %lld us)",
+             topic, latency_us, max_alert_latency_us);
+}
+#endif
+
+static const struct {
+    uint8_t type;
+    publish_hook_t publish;
+} s_publish_hooks[] = {
+    { TM_PULSE_COUNT, publish_pulse_count },
 #ifdef CONFIG_ENABLE_GPIO_PULSE_DETECTION
-    char topic_detect[80 + strlen("detect") + 1];
+    { TM_PULSE_DETECTION, publish_detection },
 #endif
 #ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
-    char topic_pburst[80 + strlen("pburst") + 1];
+    { TM_RMT_PULSE_EVENT, publish_pulse_event },
+#endif
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+    { TM_GLE_ALERT, publish_gle_alert },
 #endif
-    char topic_timesync[80 + strlen("timesync") + 1];
-#ifdef CONFIG_ENABLE_SPL06
-    char topic_meteo[80 + strlen("meteo") + 1];
+};
+
+// Messages stamped before the first SNTP synchronization carry esp_timer time.
+// After a warm reset they are converted with the provisional RTC time and flagged.
+static void backfill_timestamps(struct telemetry_message *message)
+{
+    bool early = false;
+
+    // GPIO detections are always stamped with esp_timer time
+    if (message->tm_message_type != TM_PULSE_DETECTION && !timebase_is_unix(message->timestamp)) {
+        message->timestamp = timebase_to_unix_us(message->timestamp);
+        early = true;
+    }
+    if (message->tm_message_type == TM_PULSE_COUNT &&
+        !timebase_is_unix(message->payload.tm_pcnt.start_timestamp)) {
+        message->payload.tm_pcnt.start_timestamp = timebase_to_unix_us(message->payload.tm_pcnt.start_timestamp);
+        early = true;
+    }
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+    if (message->tm_message_type == TM_RMT_PULSE_EVENT &&
+        !timebase_is_unix(message->payload.tm_rmt_pulse_event.start_timestamp)) {
+        message->payload.tm_rmt_pulse_event.start_timestamp =
+            timebase_to_unix_us(message->payload.tm_rmt_pulse_event.start_timestamp);
+        early = true;
+    }
+#endif
+    message->time_flags = 0;
+    if (!early) {
+        return;
+    }
+    if (timebase_is_synced()) {
+        s_backfilled++;
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+        // Keep the RTC copy of the window replayable after a reset
+        if (message->tm_message_type == TM_PULSE_COUNT) {
+            rtc_window_ring_backfill();
+        }
+#endif
+    } else {
+        message->time_flags |= TM_TIME_PROVISIONAL;
+        s_provisional++;
+    }
+}
+
+static void publish_message(struct telemetry_message *message)
+{
+    backfill_timestamps(message);
+
+    const telemetry_schema_t *schema = telemetry_schema_find(message->tm_message_type);
+    if (schema == NULL) {
+        ESP_LOGW(TAG, "Unknown message type: %d", message->tm_message_type);
+        return;
+    }
+
+    char *topic = s_topics[schema - telemetry_schemas];
+    for (size_t i = 0; i < sizeof(s_publish_hooks) / sizeof(s_publish_hooks[0]); i++) {
+        if (s_publish_hooks[i].type == message->tm_message_type) {
+            s_publish_hooks[i].publish(topic, message);
+            return;
+        }
+    }
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+    if (s_influx && schema->line != NULL) {
+        batch_line(schema, message);
+        return;
+    }
+#endif
+    publish_json(schema, topic, message);
+}
+
+#ifdef CONFIG_ENABLE_PUBLISH_JITTER
+// FNV-1a of the device id, reduced to 0..CONFIG_PUBLISH_JITTER_SPREAD_MS
+static void jitter_init(const char *device)
+{
+    uint32_t hash = 2166136261u;
+    for (const char *c = device; *c != '\0'; c++) {
+        hash = (hash ^ (uint8_t)*c) * 16777619u;
+    }
+    s_jitter_us = (int64_t)(hash % (CONFIG_PUBLISH_JITTER_SPREAD_MS + 1)) * 1000LL;
+    ESP_LOGI(TAG, "pcnt publish offset: %lld ms", (long long)(s_jitter_us / 1000));
+}
+
+static void deferred_publish_head(void)
+{
+    publish_message(&s_deferred[0]);
+    s_deferred_count--;
+    for (size_t i = 0; i < s_deferred_count; i++) {
+        s_deferred[i] = s_deferred[i + 1];
+        s_deferred_due_us[i] = s_deferred_due_us[i + 1];
+    }
+}
+
+// Hold a window until its publish offset; the timestamps are not touched
+static void defer_message(const struct telemetry_message *message, int64_t now_us)
+{
+    if (s_deferred_count == JITTER_SLOTS) {
+        deferred_publish_head();
+    }
+    s_deferred[s_deferred_count] = *message;
+    s_deferred_due_us[s_deferred_count] = now_us + s_jitter_us;
+    s_deferred_count++;
+}
+
+static void deferred_poll(int64_t now_us)
+{
+    while (s_deferred_count > 0 && s_deferred_due_us[0] <= now_us) {
+        deferred_publish_head();
+    }
+}
+
+static int64_t deferred_deadline_us(void)
+{
+    return (s_deferred_count > 0) ? s_deferred_due_us[0] : INT64_MAX;
+}
 #endif
+
+void mss_sender(void *parameters) {
+	struct telemetry_message message;
+    nmda_init_config_t* nmda_config = (nmda_init_config_t*) parameters;
+    char topic_base[80];
+    char topic_status[80 + strlen("status") + 1];
+    char topic_stats[80 + strlen("stats") + 1];
+    int64_t last_stats_us = 0;
     char* station = nmda_config->mqtt_station;
     char* experiment = nmda_config->mqtt_experiment;
     char* device = nmda_config->mqtt_device_id;
@@ -39,21 +975,97 @@ void mss_sender(void *parameters) {
 
     sprintf(topic_base, "%s/%s/%s", station, experiment, device);
     sprintf(topic_status, "%s/status", topic_base);
-    sprintf(topic_pcnt, "%s/pcnt", topic_base);
-#ifdef CONFIG_ENABLE_GPIO_PULSE_DETECTION
-    sprintf(topic_detect, "%s/detect", topic_base);
+    sprintf(topic_stats, "%s/stats", topic_base);
+    for (size_t i = 0; i < telemetry_schema_count; i++) {
+        snprintf(s_topics[i], sizeof(s_topics[i]), "%s/%s", topic_base, telemetry_schemas[i].service);
+    }
+
+	ESP_LOGI(TAG, "Topic base: %s", topic_base);
+#ifdef CONFIG_ENABLE_PUBLISH_JITTER
+	jitter_init(device);
 #endif
+	telemetry_schema_self_test();
+
 #ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
-    sprintf(topic_pburst, "%s/pburst", topic_base);
+	if (nmda_config->pburst_format != NULL && strcmp(nmda_config->pburst_format, "binary") == 0) {
+		s_pburst_binary = true;
+	} else if (nmda_config->pburst_format != NULL && strcmp(nmda_config->pburst_format, "json") != 0) {
+		ESP_LOGW(TAG, "Unknown pburst_format '%s', using json", nmda_config->pburst_format);
+	}
+	// Never publish a format the reference decoder cannot read back
+	if (s_pburst_binary && pburst_codec_self_test() != ESP_OK) {
+		ESP_LOGE(TAG, "Binary pburst codec self-test failed, using json");
+		s_pburst_binary = false;
+	}
+	ESP_LOGI(TAG, "pburst format: %s", s_pburst_binary ? "binary" : "json");
+#endif
+
+#ifdef CONFIG_ENABLE_PUBLISH_BATCHING
+	bool compress = false;
+#ifdef CONFIG_ENABLE_BATCH_COMPRESSION
+	if (nmda_config->batch_compression != NULL && strcmp(nmda_config->batch_compression, "lzss") == 0) {
+		compress = true;
+	} else if (nmda_config->batch_compression != NULL && strcmp(nmda_config->batch_compression, "none") != 0) {
+		ESP_LOGW(TAG, "Unknown batch_compression '%s', using none", nmda_config->batch_compression);
+	}
+	// The compressor also runs with compression off, to report the ratio
+	if (lzss_self_test() != ESP_OK && compress) {
+		ESP_LOGE(TAG, "LZSS self-test failed, publishing batches uncompressed");
+		compress = false;
+	}
 #endif
-    sprintf(topic_timesync, "%s/timesync", topic_base);
-#ifdef CONFIG_ENABLE_SPL06
-    sprintf(topic_meteo, "%s/meteo", topic_base);
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+	publish_batch_init(&s_pburst_batch, topic_for(TM_RMT_PULSE_EVENT),
+	                   s_pburst_binary ? PUBLISH_BATCH_CONCAT : PUBLISH_BATCH_JSON_ARRAY,
+	                   s_pburst_batch_buf, sizeof(s_pburst_batch_buf), CONFIG_PUBLISH_BATCH_MAX_DELAY_MS, compress);
+#endif
+#ifdef CONFIG_ENABLE_GPIO_PULSE_DETECTION
+	publish_batch_init(&s_detect_batch, topic_for(TM_PULSE_DETECTION), PUBLISH_BATCH_JSON_ARRAY,
+	                   s_detect_batch_buf, sizeof(s_detect_batch_buf), CONFIG_PUBLISH_BATCH_MAX_DELAY_MS, compress);
+#endif
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+	if (nmda_config->telemetry_format != NULL && strcmp(nmda_config->telemetry_format, "influx") == 0) {
+		s_influx = true;
+	} else if (nmda_config->telemetry_format != NULL && strcmp(nmda_config->telemetry_format, "json") != 0) {
+		ESP_LOGW(TAG, "Unknown telemetry_format '%s', using json", nmda_config->telemetry_format);
+	}
+	// Device identity as tags of every line, so one Telegraf consumer serves all stations
+	size_t n = 0;
+	const char *tag_keys[3] = { "station", "experiment", "device" };
+	const char *tag_values[3] = { station, experiment, device };
+	for (int i = 0; i < 3 && n < sizeof(s_influx_tags); i++) {
+		n += snprintf(s_influx_tags + n, sizeof(s_influx_tags) - n, ",%s=", tag_keys[i]);
+		if (n < sizeof(s_influx_tags)) {
+			n += line_writer_escape(s_influx_tags + n, sizeof(s_influx_tags) - n, tag_values[i]);
+		}
+	}
+	snprintf(s_influx_topic, sizeof(s_influx_topic), "%s/influx", topic_base);
+	publish_batch_init(&s_line_batch, s_influx_topic, PUBLISH_BATCH_LINES,
+	                   s_line_batch_buf, sizeof(s_line_batch_buf), CONFIG_PUBLISH_BATCH_MAX_DELAY_MS, compress);
+	ESP_LOGI(TAG, "Telemetry format: %s%s%s", s_influx ? "influx on " : "json", s_influx ? s_influx_topic : "",
+	         s_influx ? s_influx_tags : "");
+#endif
+	ESP_LOGI(TAG, "Publish batching: %d bytes, %d ms, %s", CONFIG_PUBLISH_BATCH_MAX_BYTES,
+	         CONFIG_PUBLISH_BATCH_MAX_DELAY_MS, compress ? "lzss" : "uncompressed");
 #endif
 
-	ESP_LOGI(TAG, "Topic base: %s", topic_base);
+#ifdef CONFIG_ENABLE_JSON_BENCHMARK
+	// Before MQTT starts, so nothing else competes for the CPU or the pool
+	json_benchmark_run();
+#endif
+
+	// Producers wake this task when they push on any telemetry ring
+	telemetry_rings_set_consumer(xTaskGetCurrentTaskHandle());
 
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+	// Before the client starts: publications made while it connects already go there
+	outbox_init();
+#endif
 	mqtt_setup(nmda_config);
+#ifdef CONFIG_ENABLE_PUBLISH_PIPELINE
+	// From here on publications are queued for the network task; synchronous if it failed
+	publish_pipeline_start();
+#endif
 	
 	// Wait for MQTT connection
 	ESP_LOGI(TAG, "Waiting for MQTT connection...");
@@ -63,303 +1075,123 @@ void mss_sender(void *parameters) {
 		ESP_LOGI(TAG, "MQTT connected successfully");
 	}
 	
-	mqtt_send_mss(topic_status, "mss_sender is running");
+	send_boot_status(topic_status);
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+	// Windows of this boot are still in the pcnt ring: only the previous runs
+	replay_rtc_windows(topic_for(TM_PULSE_COUNT), rtc_window_ring_boot_seq());
+#endif
 	ESP_LOGI(TAG, "MQTT sender ready");
 
+	last_stats_us = esp_timer_get_time();
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+	// The network task of the pipeline replays the outbox when it runs
+	bool replay_outbox = true;
+#ifdef CONFIG_ENABLE_PUBLISH_PIPELINE
+	replay_outbox = !publish_pipeline_running();
+#endif
+#endif
+
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+	bool was_connected = mqtt_is_connected();
+	bool replay_windows = false;
+	s_window_next_seq = rtc_window_ring_boot_seq();
+#endif
+
 	while(true) {
-		ESP_LOGD(TAG, "Waiting for message from telemetry queue...");
-		if (xQueueReceive(telemetry_queue, &message, portMAX_DELAY)) {
-		    char *json_string = NULL;
-		    cJSON *json = NULL;
-		    
-		    switch (message.tm_message_type) {
-			case TM_METEO:
-			    break;
-
-			case TM_PULSE_COUNT:
-                {
-                    json = cJSON_CreateObject();
-                    if (json == NULL) {
-                        ESP_LOGE(TAG, "Failed to create JSON object for PULSE_COUNT");
-                        break;
-                    }
-                    
-                    // Create string values for timestamps and counts (as per original format)
-                    char start_ts_str[32];
-                    char end_ts_str[32];
-                    char ch01_str[32];
-                    char ch02_str[32];
-                    char ch03_str[32];
-                    char interval_str[16];
-                    
-                    snprintf(start_ts_str, sizeof(start_ts_str), "%lld", message.payload.tm_pcnt.start_timestamp);
-                    snprintf(end_ts_str, sizeof(end_ts_str), "%lld", message.timestamp);
-                    snprintf(ch01_str, sizeof(ch01_str), "%lu", (unsigned long)message.payload.tm_pcnt.channel[0]);
-                    snprintf(ch02_str, sizeof(ch02_str), "%lu", (unsigned long)message.payload.tm_pcnt.channel[1]);
-                    snprintf(ch03_str, sizeof(ch03_str), "%lu", (unsigned long)message.payload.tm_pcnt.channel[2]);
-                    snprintf(interval_str, sizeof(interval_str), "%u", message.payload.tm_pcnt.integration_time_sec);
-                    
-                    cJSON_AddStringToObject(json, "start_datetime", start_ts_str);
-                    cJSON_AddStringToObject(json, "datetime", end_ts_str);
-                    cJSON_AddStringToObject(json, "ch01", ch01_str);
-                    cJSON_AddStringToObject(json, "ch02", ch02_str);
-                    cJSON_AddStringToObject(json, "ch03", ch03_str);
-                    cJSON_AddStringToObject(json, "Interval_s", interval_str);
-                    
-                    json_string = cJSON_PrintUnformatted(json);
-                    if (json_string == NULL) {
-                        ESP_LOGE(TAG, "Failed to print JSON for PULSE_COUNT");
-                        cJSON_Delete(json);
-                        break;
-                    }
-                    
-                    ESP_LOGI(TAG, "Publishing PULSECOUNT on %s: ch1=%lu, ch2=%lu, ch3=%lu, interval=%u", 
-                             topic_pcnt, 
-                             (unsigned long)message.payload.tm_pcnt.channel[0],
-                             (unsigned long)message.payload.tm_pcnt.channel[1],
-                             (unsigned long)message.payload.tm_pcnt.channel[2],
-                             message.payload.tm_pcnt.integration_time_sec);
-                    mqtt_send_mss(topic_pcnt, json_string);
-                    ESP_LOGI(TAG, "PULSECOUNT message published successfully");
-                    
-                    free(json_string);
-                    cJSON_Delete(json);
-                }
-			    break;
+		// Wake up at least once per second so the stats are published on time
+		int64_t now_us = esp_timer_get_time();
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+		// Windows that could not be published during an outage are still in RTC memory
+		bool connected = mqtt_is_connected();
+		if (connected && !was_connected) {
+			replay_windows = true;
+		}
+		if (replay_windows && connected && !windows_in_flight()) {
+			replay_windows = false;
+			if (rtc_window_ring_pending_count() > 0) {
+				replay_rtc_windows(topic_for(TM_PULSE_COUNT), replay_limit_seq());
+			}
+		}
+		was_connected = connected;
+#endif
+		if (now_us - last_stats_us >= (int64_t)CONFIG_TELEMETRY_STATS_PERIOD_SEC * 1000000LL) {
+			last_stats_us = now_us;
+			send_stats(topic_stats);
+		}
 
-#ifdef CONFIG_ENABLE_GPIO_PULSE_DETECTION
-            case TM_PULSE_DETECTION:
-                {
-                    json = cJSON_CreateObject();
-                    if (json == NULL) {
-                        ESP_LOGE(TAG, "Failed to create JSON object for PULSE_DETECTION");
-                        break;
-                    }
-                    
-                    char ts_str[32];
-                    char ch01_str[32];
-                    char ch02_str[32];
-                    char ch03_str[32];
-                    
-                    snprintf(ts_str, sizeof(ts_str), "%lld", message.timestamp);
-                    snprintf(ch01_str, sizeof(ch01_str), "%lu", (unsigned long)message.payload.tm_detect.channel[0]);
-                    snprintf(ch02_str, sizeof(ch02_str), "%lu", (unsigned long)message.payload.tm_detect.channel[1]);
-                    snprintf(ch03_str, sizeof(ch03_str), "%lu", (unsigned long)message.payload.tm_detect.channel[2]);
-                    
-                    cJSON_AddStringToObject(json, "datetime", ts_str);
-                    cJSON_AddStringToObject(json, "ch01", ch01_str);
-                    cJSON_AddStringToObject(json, "ch02", ch02_str);
-                    cJSON_AddStringToObject(json, "ch03", ch03_str);
-                    
-                    json_string = cJSON_PrintUnformatted(json);
-                    if (json_string == NULL) {
-                        ESP_LOGE(TAG, "Failed to print JSON for PULSE_DETECTION");
-                        cJSON_Delete(json);
-                        break;
-                    }
-                    
-                    ESP_LOGI(TAG, "Publishing DETECTOR %lu,%lu,%lu at %lld delta %lld us",
-                             (unsigned long)message.payload.tm_detect.channel[0],
-                             (unsigned long)message.payload.tm_detect.channel[1],
-                             (unsigned long)message.payload.tm_detect.channel[2],
-                             message.timestamp,
-                             message.timestamp - last_event_time);
-                    last_event_time = message.timestamp;
-                    mqtt_send_mss(topic_detect, json_string);
-                    
-                    free(json_string);
-                    cJSON_Delete(json);
-                }
-			    break;
+		TickType_t wait = pdMS_TO_TICKS(1000);
+#ifdef CONFIG_ENABLE_PUBLISH_BATCHING
+		// Do not sleep past the deadline of a pending batch (rounded up to a whole tick)
+		int64_t batch_deadline_us = batches_deadline_us();
+		if (batch_deadline_us != INT64_MAX) {
+			int64_t left_ms = (batch_deadline_us - now_us + 999) / 1000;
+			TickType_t left = (left_ms <= 0) ? 0 : (TickType_t)((left_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+			if (left < wait) wait = left;
+		}
+#endif
+#ifdef CONFIG_ENABLE_PUBLISH_JITTER
+		int64_t deferred_us = deferred_deadline_us();
+		if (deferred_us != INT64_MAX) {
+			int64_t left_ms = (deferred_us - now_us + 999) / 1000;
+			TickType_t left = (left_ms <= 0) ? 0 : (TickType_t)((left_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+			if (left < wait) wait = left;
+		}
+#endif
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+		// Replay pace while there is a backlog and the broker is reachable
+		if (replay_outbox && outbox_has_pending() && mqtt_is_connected()) {
+			TickType_t replay = pdMS_TO_TICKS(1000 / CONFIG_OUTBOX_REPLAY_PER_SEC);
+			if (replay < wait) wait = replay;
+		}
 #endif
 
-#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
-            case TM_RMT_PULSE_EVENT:
-                {
-                    // Validate message data first
-                    if (message.payload.tm_rmt_pulse_event.pulses == NULL) {
-                        ESP_LOGE(TAG, "RMT pulse event has NULL pulses array (symbols=%u)", 
-                                message.payload.tm_rmt_pulse_event.symbols);
-                        break;
-                    }
-                    
-                    if (message.payload.tm_rmt_pulse_event.symbols == 0) {
-                        ESP_LOGW(TAG, "RMT pulse event has 0 symbols, skipping");
-                        // Free pulses array if it exists
-                        if (message.payload.tm_rmt_pulse_event.pulses != NULL) {
-                            heap_caps_free(message.payload.tm_rmt_pulse_event.pulses);
-                        }
-                        break;
-                    }
-                    
-                    // Validate topic is not empty (topic_pburst is an array, not a pointer)
-                    if (topic_pburst[0] == '\0') {
-                        ESP_LOGE(TAG, "Pburst topic is empty, not sending");
-                        // Free pulses array
-                        heap_caps_free(message.payload.tm_rmt_pulse_event.pulses);
-                        break;
-                    }
-                    
-                    // Create JSON object
-                    json = cJSON_CreateObject();
-                    if (json == NULL) {
-                        ESP_LOGE(TAG, "Failed to create JSON object for RMT_PULSE_EVENT");
-                        heap_caps_free(message.payload.tm_rmt_pulse_event.pulses);
-                        break;
-                    }
-                    
-                    // Add start_datetime (as string to match original format)
-                    char start_ts_str[32];
-                    snprintf(start_ts_str, sizeof(start_ts_str), "%" PRId64, 
-                            message.payload.tm_rmt_pulse_event.start_timestamp);
-                    cJSON_AddStringToObject(json, "start_datetime", start_ts_str);
-                    
-                    // Add channel (as string "ch1", "ch2", "ch3")
-                    char channel_str[8];
-                    snprintf(channel_str, sizeof(channel_str), "ch%u", 
-                            message.payload.tm_rmt_pulse_event.channel);
-                    cJSON_AddStringToObject(json, "channel", channel_str);
-                    
-                    // Add symbols count
-                    cJSON_AddNumberToObject(json, "symbols", message.payload.tm_rmt_pulse_event.symbols);
-                    
-                    // Create pulses array
-                    cJSON *pulses_array = cJSON_CreateArray();
-                    if (pulses_array == NULL) {
-                        ESP_LOGE(TAG, "Failed to create pulses array");
-                        cJSON_Delete(json);
-                        heap_caps_free(message.payload.tm_rmt_pulse_event.pulses);
-                        break;
-                    }
-                    
-                    // Add each pulse as an object to the array
-                    for (uint8_t i = 0; i < message.payload.tm_rmt_pulse_event.symbols; i++) {
-                        cJSON *pulse_obj = cJSON_CreateObject();
-                        if (pulse_obj == NULL) {
-                            ESP_LOGW(TAG, "Failed to create pulse object %u, stopping at %u pulses", 
-                                    i, i);
-                            break;
-                        }
-                        
-                        // Add duration_us and separation_us as numbers
-                        cJSON_AddNumberToObject(pulse_obj, "duration_us", 
-                                message.payload.tm_rmt_pulse_event.pulses[i].duration_us);
-                        cJSON_AddNumberToObject(pulse_obj, "separation_us", 
-                                message.payload.tm_rmt_pulse_event.pulses[i].separation_us);
-                        
-                        // Add pulse object to array
-                        cJSON_AddItemToArray(pulses_array, pulse_obj);
-                    }
-                    
-                    // Add pulses array to main object
-                    cJSON_AddItemToObject(json, "pulses", pulses_array);
-                    
-                    // Print JSON to string
-                    json_string = cJSON_PrintUnformatted(json);
-                    if (json_string == NULL) {
-                        ESP_LOGE(TAG, "Failed to print JSON for RMT_PULSE_EVENT");
-                        cJSON_Delete(json);
-                        heap_caps_free(message.payload.tm_rmt_pulse_event.pulses);
-                        break;
-                    }
-                    
-                    // Send via MQTT
-                    mqtt_send_mss(topic_pburst, json_string);
-                    
-                    // Free JSON string and object
-                    free(json_string);
-                    cJSON_Delete(json);
-                    
-                    // Free the dynamically allocated pulses array after sending
-                    heap_caps_free(message.payload.tm_rmt_pulse_event.pulses);
-                    message.payload.tm_rmt_pulse_event.pulses = NULL;
-                }
-                break;
-#endif
-
-            case TM_TIME_SYNCHRONIZER:
-                {
-                    json = cJSON_CreateObject();
-                    if (json == NULL) {
-                        ESP_LOGE(TAG, "Failed to create JSON object for TIME_SYNCHRONIZER");
-                        break;
-                    }
-                    
-                    char ts_str[32];
-                    char cpu_str[32];
-                    
-                    snprintf(ts_str, sizeof(ts_str), "%lld", message.timestamp);
-                    snprintf(cpu_str, sizeof(cpu_str), "%lu", (unsigned long)message.payload.tm_sync.cpu_count);
-                    
-                    cJSON_AddStringToObject(json, "datetime", ts_str);
-                    cJSON_AddStringToObject(json, "cpu_lnd", cpu_str);
-                    
-                    json_string = cJSON_PrintUnformatted(json);
-                    if (json_string == NULL) {
-                        ESP_LOGE(TAG, "Failed to print JSON for TIME_SYNCHRONIZER");
-                        cJSON_Delete(json);
-                        break;
-                    }
-                    
-                    ESP_LOGI(TAG, "Publishing TIME_SYNC on %s", topic_timesync);
-                    mqtt_send_mss(topic_timesync, json_string);
-                    
-                    free(json_string);
-                    cJSON_Delete(json);
-                }
-                break;
-
-#ifdef CONFIG_ENABLE_SPL06
-            case TM_SPL06:
-                {
-                    json = cJSON_CreateObject();
-                    if (json == NULL) {
-                        ESP_LOGE(TAG, "Failed to create JSON object for SPL06");
-                        break;
-                    }
-                    
-                    char ts_str[32];
-                    char pressure_pa_str[32];
-                    char pressure_hpa_str[32];
-                    char temp_str[32];
-                    char qnh_str[32];
-                    
-                    snprintf(ts_str, sizeof(ts_str), "%lld", message.timestamp);
-                    snprintf(pressure_pa_str, sizeof(pressure_pa_str), "%.2f", message.payload.tm_spl06.pressure_pa);
-                    snprintf(pressure_hpa_str, sizeof(pressure_hpa_str), "%.2f", message.payload.tm_spl06.pressure_hpa);
-                    snprintf(temp_str, sizeof(temp_str), "%.2f", message.payload.tm_spl06.temperature_celsius);
-                    snprintf(qnh_str, sizeof(qnh_str), "%.2f", message.payload.tm_spl06.qnh_hpa);
-                    
-                    cJSON_AddStringToObject(json, "datetime", ts_str);
-                    cJSON_AddStringToObject(json, "pressure_pa", pressure_pa_str);
-                    cJSON_AddStringToObject(json, "pressure_hpa", pressure_hpa_str);
-                    cJSON_AddStringToObject(json, "temperature_celsius", temp_str);
-                    cJSON_AddStringToObject(json, "qnh_hpa", qnh_str);
-                    
-                    json_string = cJSON_PrintUnformatted(json);
-                    if (json_string == NULL) {
-                        ESP_LOGE(TAG, "Failed to print JSON for SPL06");
-                        cJSON_Delete(json);
-                        break;
-                    }
-                    
-                    ESP_LOGI(TAG, "Publishing METEO on %s", topic_meteo);
-                    mqtt_send_mss(topic_meteo, json_string);
-                    ESP_LOGI(TAG, "METEO message published successfully");
-                    
-                    free(json_string);
-                    cJSON_Delete(json);
-                }
-                break;
-#endif
-
-			default:
-			    ESP_LOGW(TAG, "Unknown message type: %d", message.tm_message_type);
-			    break;
-		    }
-		    ESP_LOGD(TAG, "Message processing completed, waiting for next message...");
-		} else {
-		    ESP_LOGW(TAG, "Failed to receive message from queue");
+		// Until the time is known the early messages are held back; they are
+		// backfilled to Unix time when published
+		bool received = false;
+		bool time_known = (timebase_state() != TIMEBASE_NONE);
+#ifdef CONFIG_ENABLE_EARLY_ACQUISITION
+		// The held messages are older than anything still in the rings
+		received = time_known && early_take(&message);
+		bool take = !received;
+#else
+		bool take = time_known;
+		if (!take) {
+			vTaskDelay(wait > 0 ? wait : 1);
+		}
+#endif
+		if (take) {
+			ESP_LOGD(TAG, "Waiting for message from telemetry rings...");
+			received = telemetry_rings_receive(&message, wait);
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+			if (received && message.tm_message_type == TM_PULSE_COUNT) {
+				s_window_next_seq = message.payload.tm_pcnt.seq + 1;
+			}
+#endif
+#ifdef CONFIG_ENABLE_EARLY_ACQUISITION
+			if (received && !time_known) {
+				early_hold(&message);
+				received = false;
+			}
+#endif
+		}
+#ifdef CONFIG_ENABLE_PUBLISH_BATCHING
+		batches_poll(esp_timer_get_time());
+#endif
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+		if (replay_outbox) {
+			outbox_poll(esp_timer_get_time());
+		}
+#endif
+#ifdef CONFIG_ENABLE_PUBLISH_JITTER
+		deferred_poll(esp_timer_get_time());
+		if (received && message.tm_message_type == TM_PULSE_COUNT && s_jitter_us > 0) {
+			defer_message(&message, esp_timer_get_time());
+			received = false;
+		}
+#endif
+		if (received) {
+			publish_message(&message);
+			ESP_LOGD(TAG, "Message processing completed, waiting for next message...");
 		}
 	}
 }
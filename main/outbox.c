@@ -0,0 +1,477 @@
+#include "outbox.h"
+
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+
+#include <string.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "mqtt.h"
+
+#define TAG "OUTBOX"
+
+#define OUTBOX_PARTITION_LABEL "outbox"
+#define OUTBOX_SECTOR_SIZE     4096
+#define OUTBOX_SECTOR_MAGIC    0x424F4D4EUL    // "NMOB"
+#define OUTBOX_RECORD_MAGIC    0xA55A
+#define OUTBOX_PENDING         0xFF            // Erased flash
+#define OUTBOX_DELIVERED       0x00            // Programmed in place after the PUBACK
+
+// Wall clock before this (2020-01-01) means SNTP has not synchronized yet
+#define OUTBOX_VALID_TIME_S    1577836800UL
+
+/*
+ * Flash layout: a ring of 4 KB sectors. Each sector starts with a header whose
+ * sequence number grows with every sector opened, so the ring order survives
+ * a reset. Records follow back to back:
+ *
+ *   outbox_record_hdr_t | topic (no NUL) | payload | padding to 4 bytes
+ *
+ * The header is programmed after the topic and payload, so a valid header
+ * always describes a complete record. Delivery clears the state byte (a
+ * single 1 -> 0 write, no erase).
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+} outbox_sector_hdr_t;
+
+typedef struct {
+    uint16_t magic;
+    uint8_t state;
+    uint8_t topic_len;
+    uint16_t payload_len;
+    uint16_t crc;           // CRC16 of topic and payload
+    uint32_t seq;           // Record sequence number
+    uint32_t stored_s;      // Wall clock when stored (seconds Unix)
+} outbox_record_hdr_t;
+
+_Static_assert(sizeof(outbox_record_hdr_t) == 16, "outbox record header layout");
+
+#define FIRST_RECORD      ((uint32_t)sizeof(outbox_sector_hdr_t))
+#define MAX_RECORD_DATA   (OUTBOX_SECTOR_SIZE - FIRST_RECORD - sizeof(outbox_record_hdr_t))
+
+typedef struct {
+    uint32_t sector;
+    uint32_t off;
+} outbox_pos_t;
+
+static const esp_partition_t *s_part = NULL;
+static uint32_t s_sectors;
+static uint32_t s_used;             // Sectors in the ring, from s_tail to s_head.sector
+static uint32_t s_tail;             // Oldest sector
+static outbox_pos_t s_head;         // Where the next record is written
+static uint32_t s_head_seq;         // Sequence number of the head sector
+static uint32_t s_record_seq;       // Sequence number of the next record
+static outbox_pos_t s_read;         // No pending record before this position
+
+static outbox_stats_t s_stats;
+static uint32_t s_oldest_stored_s;
+
+// Replay: one record in flight at a time
+static int s_inflight_msg_id = -1;
+static outbox_pos_t s_inflight;
+static outbox_record_hdr_t s_inflight_hdr;
+static int64_t s_inflight_us;
+static int64_t s_next_replay_us;
+static volatile int s_acked_msg_id = -1;    // Written by the MQTT task
+static volatile uint32_t s_inflight_bytes;  // Read by the admission control of mqtt.c
+
+static char s_topic[256];
+static uint8_t s_payload[MAX_RECORD_DATA + 1];
+
+static inline uint32_t record_size(const outbox_record_hdr_t *hdr)
+{
+    return (sizeof(*hdr) + hdr->topic_len + hdr->payload_len + 3) & ~3u;
+}
+
+static inline size_t addr(const outbox_pos_t *pos)
+{
+    return (size_t)pos->sector * OUTBOX_SECTOR_SIZE + pos->off;
+}
+
+static inline uint32_t next_sector(uint32_t sector)
+{
+    return (sector + 1) % s_sectors;
+}
+
+static bool read_sector_hdr(uint32_t sector, outbox_sector_hdr_t *hdr)
+{
+    return esp_partition_read(s_part, (size_t)sector * OUTBOX_SECTOR_SIZE, hdr, sizeof(*hdr)) == ESP_OK &&
+           hdr->magic == OUTBOX_SECTOR_MAGIC;
+}
+
+// Header of the record at pos; false past the last record of the sector
+static bool read_record_hdr(const outbox_pos_t *pos, outbox_record_hdr_t *hdr)
+{
+    if (pos->off + sizeof(*hdr) > OUTBOX_SECTOR_SIZE) {
+        return false;
+    }
+    if (pos->sector == s_head.sector && pos->off >= s_head.off) {
+        return false;
+    }
+    if (esp_partition_read(s_part, addr(pos), hdr, sizeof(*hdr)) != ESP_OK) {
+        return false;
+    }
+    return hdr->magic == OUTBOX_RECORD_MAGIC && pos->off + record_size(hdr) <= OUTBOX_SECTOR_SIZE;
+}
+
+// First pending record at or after *pos; false when the ring has none left
+static bool find_pending(outbox_pos_t *pos, outbox_record_hdr_t *hdr)
+{
+    while (s_used > 0) {
+        if (read_record_hdr(pos, hdr)) {
+            if (hdr->state == OUTBOX_PENDING) {
+                return true;
+            }
+            pos->off += record_size(hdr);
+        } else if (pos->sector != s_head.sector) {
+            pos->sector = next_sector(pos->sector);
+            pos->off = FIRST_RECORD;
+        } else {
+            return false;
+        }
+    }
+    return false;
+}
+
+// Refresh the age reference after the oldest pending record changed
+static void update_oldest(void)
+{
+    outbox_pos_t pos = s_read;
+    outbox_record_hdr_t hdr;
+    s_oldest_stored_s = find_pending(&pos, &hdr) ? hdr.stored_s : 0;
+}
+
+// Reclaim the oldest sector; its undelivered records are lost
+static void drop_tail(void)
+{
+    outbox_pos_t pos = { s_tail, FIRST_RECORD };
+    outbox_record_hdr_t hdr;
+    uint32_t dropped = 0;
+
+    while (read_record_hdr(&pos, &hdr)) {
+        if (hdr.state == OUTBOX_PENDING) {
+            dropped++;
+            s_stats.pending_bytes -= hdr.payload_len;
+        }
+        pos.off += record_size(&hdr);
+    }
+    s_stats.pending -= dropped;
+    s_stats.dropped += dropped;
+    if (dropped > 0) {
+        ESP_LOGW(TAG, "Outbox full: dropped %lu undelivered records", (unsigned long)dropped);
+    }
+
+    if (s_inflight_msg_id >= 0 && s_inflight.sector == s_tail) {
+        s_inflight_msg_id = -1;
+        s_inflight_bytes = 0;
+    }
+    s_tail = next_sector(s_tail);
+    s_used--;
+    if (s_read.sector == pos.sector) {   // Still in the reclaimed sector
+        s_read.sector = s_tail;
+        s_read.off = FIRST_RECORD;
+    }
+    update_oldest();
+}
+
+// Erase the sector after the head and make it the new head
+static esp_err_t open_sector(void)
+{
+    uint32_t sector = next_sector(s_head.sector);
+
+    if (s_used == s_sectors) {
+        drop_tail();
+    }
+    esp_err_t err = esp_partition_erase_range(s_part, (size_t)sector * OUTBOX_SECTOR_SIZE, OUTBOX_SECTOR_SIZE);
+    if (err != ESP_OK) {
+        return err;
+    }
+    outbox_sector_hdr_t hdr = { .magic = OUTBOX_SECTOR_MAGIC, .seq = s_head_seq + 1 };
+    err = esp_partition_write(s_part, (size_t)sector * OUTBOX_SECTOR_SIZE, &hdr, sizeof(hdr));
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (s_used == 0) {
+        s_tail = sector;
+        s_read.sector = sector;
+        s_read.off = FIRST_RECORD;
+    }
+    s_used++;
+    s_head.sector = sector;
+    s_head.off = FIRST_RECORD;
+    s_head_seq = hdr.seq;
+    return ESP_OK;
+}
+
+esp_err_t outbox_init(void)
+{
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, OUTBOX_PARTITION_LABEL);
+    if (s_part == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition in this table (use partitions_8mb_outbox.csv): "
+                 "unpublished messages will be lost", OUTBOX_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    s_sectors = s_part->size / OUTBOX_SECTOR_SIZE;
+    if (s_sectors < 2) {
+        ESP_LOGE(TAG, "Partition '%s' too small (%lu bytes)", OUTBOX_PARTITION_LABEL, (unsigned long)s_part->size);
+        s_part = NULL;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_oldest_stored_s = 0;
+    s_record_seq = 0;
+    s_inflight_msg_id = -1;
+    s_inflight_bytes = 0;
+    s_stats.capacity_bytes = s_sectors * OUTBOX_SECTOR_SIZE;
+
+    // Head: the valid sector with the highest sequence number
+    outbox_sector_hdr_t sector_hdr;
+    bool found = false;
+    uint32_t head = 0;
+    for (uint32_t i = 0; i < s_sectors; i++) {
+        if (read_sector_hdr(i, &sector_hdr) && (!found || sector_hdr.seq > s_head_seq)) {
+            found = true;
+            head = i;
+            s_head_seq = sector_hdr.seq;
+        }
+    }
+    if (!found) {
+        // Empty ring: the first store opens sector 0
+        s_head.sector = s_sectors - 1;
+        s_head.off = OUTBOX_SECTOR_SIZE;
+        s_head_seq = 0;
+        s_used = 0;
+        ESP_LOGI(TAG, "Empty outbox, %lu KB", (unsigned long)(s_stats.capacity_bytes / 1024));
+        return ESP_OK;
+    }
+
+    // Tail: walk back while the sequence numbers are consecutive
+    s_tail = head;
+    s_used = 1;
+    while (s_used < s_sectors) {
+        uint32_t prev = (s_tail + s_sectors - 1) % s_sectors;
+        if (!read_sector_hdr(prev, &sector_hdr) || sector_hdr.seq != s_head_seq - s_used) {
+            break;
+        }
+        s_tail = prev;
+        s_used++;
+    }
+
+    // Count the pending records. The scan stops at the first byte that is not a
+    // record header, so a write torn by a reset ends the head sector
+    s_head.sector = head;
+    s_head.off = OUTBOX_SECTOR_SIZE;
+    outbox_pos_t pos = { s_tail, FIRST_RECORD };
+    outbox_record_hdr_t hdr;
+    bool first = true;
+    while (true) {
+        if (read_record_hdr(&pos, &hdr)) {
+            if (hdr.state == OUTBOX_PENDING) {
+                if (first) {
+                    s_read = pos;
+                    s_oldest_stored_s = hdr.stored_s;
+                    first = false;
+                }
+                s_stats.pending++;
+                s_stats.pending_bytes += hdr.payload_len;
+            }
+            s_record_seq = hdr.seq + 1;
+            pos.off += record_size(&hdr);
+        } else if (pos.sector != head) {
+            pos.sector = next_sector(pos.sector);
+            pos.off = FIRST_RECORD;
+        } else {
+            break;
+        }
+    }
+    if (first) {
+        s_read = pos;
+    }
+    // New records go to a fresh sector: the end of the head sector may hold
+    // the data of a record whose header was never written
+    s_head.off = OUTBOX_SECTOR_SIZE;
+
+    ESP_LOGI(TAG, "Outbox: %lu sectors of %lu in use, %lu pending records (%lu bytes)",
+             (unsigned long)s_used, (unsigned long)s_sectors, (unsigned long)s_stats.pending,
+             (unsigned long)s_stats.pending_bytes);
+    return ESP_OK;
+}
+
+esp_err_t outbox_store(const char *topic, const uint8_t *payload, size_t len)
+{
+    if (s_part == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    size_t topic_len = strlen(topic);
+    if (topic_len > 255 || topic_len + len > MAX_RECORD_DATA) {
+        s_stats.too_large++;
+        ESP_LOGW(TAG, "Message of %u bytes to %s does not fit in the outbox", (unsigned)len, topic);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    struct timeval tv_now;
+    gettimeofday(&tv_now, NULL);
+    outbox_record_hdr_t hdr = {
+        .magic = OUTBOX_RECORD_MAGIC,
+        .state = OUTBOX_PENDING,
+        .topic_len = (uint8_t)topic_len,
+        .payload_len = (uint16_t)len,
+        .seq = s_record_seq,
+        .stored_s = (uint32_t)tv_now.tv_sec,
+    };
+    hdr.crc = esp_rom_crc16_le(0, (const uint8_t *)topic, topic_len);
+    hdr.crc = esp_rom_crc16_le(hdr.crc, payload, len);
+
+    esp_err_t err = ESP_OK;
+    if (s_head.off + record_size(&hdr) > OUTBOX_SECTOR_SIZE) {
+        err = open_sector();
+    }
+    size_t base = addr(&s_head);
+    if (err == ESP_OK) {
+        err = esp_partition_write(s_part, base + sizeof(hdr), topic, topic_len);
+    }
+    if (err == ESP_OK && len > 0) {
+        err = esp_partition_write(s_part, base + sizeof(hdr) + topic_len, payload, len);
+    }
+    if (err == ESP_OK) {
+        err = esp_partition_write(s_part, base, &hdr, sizeof(hdr));
+    }
+    if (err != ESP_OK) {
+        // Never write over what may be half programmed: continue in a new sector
+        s_head.off = OUTBOX_SECTOR_SIZE;
+        s_stats.errors++;
+        ESP_LOGE(TAG, "Failed to store message to %s: %s", topic, esp_err_to_name(err));
+        return err;
+    }
+
+    if (s_stats.pending == 0) {
+        ESP_LOGW(TAG, "Broker unreachable, storing publications in flash");
+        s_oldest_stored_s = hdr.stored_s;
+    }
+    s_head.off += record_size(&hdr);
+    s_record_seq++;
+    s_stats.pending++;
+    s_stats.pending_bytes += len;
+    s_stats.stored++;
+    return ESP_OK;
+}
+
+// Mark the record at pos delivered and move the read position past it
+static void mark_delivered(const outbox_pos_t *pos, const outbox_record_hdr_t *hdr)
+{
+    uint8_t state = OUTBOX_DELIVERED;
+    if (esp_partition_write(s_part, addr(pos) + offsetof(outbox_record_hdr_t, state), &state, 1) != ESP_OK) {
+        // Replayed again after the next reset: a duplicate, never a loss
+        s_stats.errors++;
+    }
+    s_stats.pending--;
+    s_stats.pending_bytes -= hdr->payload_len;
+    if (s_read.sector == pos->sector && s_read.off == pos->off) {
+        s_read.off += record_size(hdr);
+    }
+    update_oldest();
+    if (s_stats.pending == 0) {
+        ESP_LOGI(TAG, "Outbox drained (%lu replayed since boot)", (unsigned long)s_stats.replayed);
+    }
+}
+
+void outbox_poll(int64_t now_us)
+{
+    if (s_part == NULL) {
+        return;
+    }
+
+    if (s_inflight_msg_id >= 0) {
+        if (s_acked_msg_id == s_inflight_msg_id) {
+            s_inflight_msg_id = -1;
+            s_inflight_bytes = 0;
+            s_stats.replayed++;
+            mark_delivered(&s_inflight, &s_inflight_hdr);
+        } else if (now_us - s_inflight_us >= (int64_t)CONFIG_OUTBOX_ACK_TIMEOUT_SEC * 1000000LL) {
+            ESP_LOGW(TAG, "No PUBACK for record %lu, replaying it again", (unsigned long)s_inflight_hdr.seq);
+            s_inflight_msg_id = -1;
+            s_inflight_bytes = 0;
+        } else {
+            return;
+        }
+    }
+
+    if (s_stats.pending == 0 || now_us < s_next_replay_us || !mqtt_is_connected()) {
+        return;
+    }
+
+    outbox_record_hdr_t hdr;
+    if (!find_pending(&s_read, &hdr)) {
+        ESP_LOGW(TAG, "Counted %lu pending records but found none", (unsigned long)s_stats.pending);
+        s_stats.pending = 0;
+        s_stats.pending_bytes = 0;
+        s_oldest_stored_s = 0;
+        return;
+    }
+
+    size_t base = addr(&s_read) + sizeof(hdr);
+    if (esp_partition_read(s_part, base, s_topic, hdr.topic_len) != ESP_OK ||
+        esp_partition_read(s_part, base + hdr.topic_len, s_payload, hdr.payload_len) != ESP_OK) {
+        s_stats.errors++;
+        s_next_replay_us = now_us + 1000000;
+        return;
+    }
+    s_topic[hdr.topic_len] = '\0';
+    s_payload[hdr.payload_len] = '\0';
+
+    uint16_t crc = esp_rom_crc16_le(0, (const uint8_t *)s_topic, hdr.topic_len);
+    crc = esp_rom_crc16_le(crc, s_payload, hdr.payload_len);
+    if (crc != hdr.crc || hdr.topic_len == 0) {
+        ESP_LOGE(TAG, "Corrupt record %lu skipped", (unsigned long)hdr.seq);
+        s_stats.errors++;
+        mark_delivered(&s_read, &hdr);
+        return;
+    }
+
+    int msg_id = mqtt_send_acked(s_topic, s_payload, hdr.payload_len);
+    if (msg_id <= 0) {
+        s_next_replay_us = now_us + 1000000;
+        return;
+    }
+    s_inflight_msg_id = msg_id;
+    s_inflight_bytes = hdr.topic_len + hdr.payload_len;
+    s_inflight = s_read;
+    s_inflight_hdr = hdr;
+    s_inflight_us = now_us;
+    s_next_replay_us = now_us + 1000000 / CONFIG_OUTBOX_REPLAY_PER_SEC;
+}
+
+bool outbox_has_pending(void)
+{
+    return s_stats.pending > 0;
+}
+
+size_t outbox_inflight_bytes(void)
+{
+    return s_inflight_bytes;
+}
+
+void outbox_on_published(int msg_id)
+{
+    s_acked_msg_id = msg_id;
+}
+
+void outbox_get_stats(outbox_stats_t *stats)
+{
+    *stats = s_stats;
+    stats->oldest_age_s = 0;
+    if (s_stats.pending > 0 && s_oldest_stored_s >= OUTBOX_VALID_TIME_S) {
+        struct timeval tv_now;
+        gettimeofday(&tv_now, NULL);
+        if ((uint32_t)tv_now.tv_sec > s_oldest_stored_s) {
+            stats->oldest_age_s = (uint32_t)tv_now.tv_sec - s_oldest_stored_s;
+        }
+    }
+}
+
+#endif // CONFIG_ENABLE_MQTT_OUTBOX
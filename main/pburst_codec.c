@@ -0,0 +1,110 @@
+#include "pburst_codec.h"
+
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+
+#include <stdbool.h>
+#include <string.h>
+#include "esp_log.h"
+#include "rmt_pulse_capture.h"
+
+static const char *TAG = "PBURST_CODEC";
+
+// Largest group produced by the capture (mem_block_symbols of each RX channel)
+#define SELF_TEST_MAX_PULSES 64
+
+size_t pburst_encode(uint8_t *buf, size_t size, const struct telemetry_message *message)
+{
+    pburst_writer_t writer;
+    pburst_bin_header_t header = {
+        .channel = message->payload.tm_rmt_pulse_event.channel,
+        .resolution_hz = RMT_PULSE_RESOLUTION_HZ,
+        .start_timestamp = message->payload.tm_rmt_pulse_event.start_timestamp,
+        .num_pulses = message->payload.tm_rmt_pulse_event.symbols,
+    };
+
+    pburst_writer_init(&writer, buf, size);
+    pburst_write_header(&writer, &header);
+    for (uint8_t i = 0; i < header.num_pulses; i++) {
+        pburst_write_pulse(&writer, message->payload.tm_rmt_pulse_event.pulses[i].duration_ticks,
+                           message->payload.tm_rmt_pulse_event.pulses[i].separation_us);
+    }
+    return pburst_writer_finish(&writer);
+}
+
+// Encode a message, decode it and compare
+static bool round_trip(const char *name, uint8_t channel, int64_t start_timestamp,
+                       const rmt_pulse_t *pulses, uint8_t n)
+{
+    static uint8_t buf[PBURST_BIN_MAX_SIZE(SELF_TEST_MAX_PULSES)];
+    static pburst_pulse_t decoded[SELF_TEST_MAX_PULSES];
+    struct telemetry_message message;
+    pburst_bin_header_t header;
+
+    memset(&message, 0, sizeof(message));
+    message.tm_message_type = TM_RMT_PULSE_EVENT;
+    message.payload.tm_rmt_pulse_event.channel = channel;
+    message.payload.tm_rmt_pulse_event.symbols = n;
+    message.payload.tm_rmt_pulse_event.start_timestamp = start_timestamp;
+    message.payload.tm_rmt_pulse_event.pulses = (rmt_pulse_t *)pulses;
+
+    size_t len = pburst_encode(buf, sizeof(buf), &message);
+    if (len == 0 || len > PBURST_BIN_MAX_SIZE(n)) {
+        ESP_LOGE(TAG, "%s: encode failed (%u bytes)", name, (unsigned)len);
+        return false;
+    }
+    pburst_status_t status = pburst_decode(buf, len, &header, decoded, SELF_TEST_MAX_PULSES);
+    if (status != PBURST_OK) {
+        ESP_LOGE(TAG, "%s: decode failed: %s", name, pburst_status_name(status));
+        return false;
+    }
+    if (header.channel != channel || header.start_timestamp != start_timestamp ||
+        header.num_pulses != n || header.resolution_hz != RMT_PULSE_RESOLUTION_HZ) {
+        ESP_LOGE(TAG, "%s: header mismatch", name);
+        return false;
+    }
+    for (uint8_t i = 0; i < n; i++) {
+        if (decoded[i].duration_ticks != pulses[i].duration_ticks ||
+            decoded[i].duration_us != pulses[i].duration_us ||
+            decoded[i].separation_us != pulses[i].separation_us) {
+            ESP_LOGE(TAG, "%s: pulse %u mismatch", name, i);
+            return false;
+        }
+    }
+    return true;
+}
+
+esp_err_t pburst_codec_self_test(void)
+{
+    static rmt_pulse_t pulses[SELF_TEST_MAX_PULSES];
+    const uint32_t ticks_per_us = RMT_PULSE_RESOLUTION_HZ / 1000000;
+    bool ok = true;
+
+    // Single pulse, first of the channel (separation unknown)
+    pulses[0] = (rmt_pulse_t){ .duration_ticks = 9, .duration_us = 9 / ticks_per_us, .separation_us = -1 };
+    ok &= round_trip("single", 1, 1718000000123456LL, pulses, 1);
+
+    // Field limits: zero and maximum RMT durations, extreme separations and timestamps
+    pulses[0] = (rmt_pulse_t){ .duration_ticks = 0, .duration_us = 0, .separation_us = 0 };
+    pulses[1] = (rmt_pulse_t){ .duration_ticks = UINT16_MAX, .duration_us = UINT16_MAX / ticks_per_us, .separation_us = INT64_MAX };
+    pulses[2] = (rmt_pulse_t){ .duration_ticks = 1, .duration_us = 1 / ticks_per_us, .separation_us = INT64_MIN };
+    ok &= round_trip("limits", 3, INT64_MIN, pulses, 3);
+
+    // Largest group, pseudo-random pulses
+    uint32_t lcg = 0x2545F491;
+    for (int i = 0; i < SELF_TEST_MAX_PULSES; i++) {
+        lcg = lcg * 1664525u + 1013904223u;
+        uint16_t ticks = (uint16_t)(lcg >> 20);
+        pulses[i].duration_ticks = ticks;
+        pulses[i].duration_us = ticks / ticks_per_us;
+        pulses[i].separation_us = (i == 0) ? -1 : (int64_t)((lcg >> 4) % 5000000);
+    }
+    ok &= round_trip("full_group", 2, 1718000000000000LL, pulses, SELF_TEST_MAX_PULSES);
+
+    if (ok) {
+        ESP_LOGI(TAG, "Binary pburst codec self-test passed");
+        return ESP_OK;
+    }
+    return ESP_FAIL;
+}
+
+#endif // CONFIG_ENABLE_RMT_PULSE_DETECTION
@@ -0,0 +1,112 @@
+#include "pburst_wire.h"
+
+#include "varint.h"
+
+void pburst_writer_init(pburst_writer_t *w, uint8_t *buf, size_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->overflow = false;
+}
+
+void pburst_write_header(pburst_writer_t *w, const pburst_bin_header_t *header)
+{
+    varint_put_byte(w->buf, w->size, &w->len, &w->overflow, PBURST_BIN_MAGIC);
+    varint_put_byte(w->buf, w->size, &w->len, &w->overflow, PBURST_BIN_VERSION);
+    varint_put_byte(w->buf, w->size, &w->len, &w->overflow, header->channel);
+    varint_put_u(w->buf, w->size, &w->len, &w->overflow, header->resolution_hz);
+    varint_put_s(w->buf, w->size, &w->len, &w->overflow, header->start_timestamp);
+    varint_put_u(w->buf, w->size, &w->len, &w->overflow, header->num_pulses);
+}
+
+void pburst_write_pulse(pburst_writer_t *w, uint16_t duration_ticks, int64_t separation_us)
+{
+    varint_put_u(w->buf, w->size, &w->len, &w->overflow, duration_ticks);
+    varint_put_s(w->buf, w->size, &w->len, &w->overflow, separation_us);
+}
+
+size_t pburst_writer_finish(const pburst_writer_t *w)
+{
+    return w->overflow ? 0 : w->len;
+}
+
+// varint_get_u() status as pburst_status_t
+static pburst_status_t get_uvarint(const uint8_t *buf, size_t len, size_t *pos, uint64_t *value)
+{
+    switch (varint_get_u(buf, len, pos, value)) {
+    case 0:
+        return PBURST_OK;
+    case -1:
+        return PBURST_ERR_SIZE;
+    default:
+        return PBURST_ERR_FIELD;
+    }
+}
+
+pburst_status_t pburst_decode_next(const uint8_t *buf, size_t len, size_t *consumed,
+                                   pburst_bin_header_t *header, pburst_pulse_t *pulses, size_t max_pulses)
+{
+    size_t pos;
+    uint64_t v;
+    pburst_status_t err;
+
+    if (len < 3) {
+        return PBURST_ERR_SIZE;
+    }
+    if (buf[0] != PBURST_BIN_MAGIC || buf[1] != PBURST_BIN_VERSION) {
+        return PBURST_ERR_VERSION;
+    }
+    header->channel = buf[2];
+    pos = 3;
+
+    if ((err = get_uvarint(buf, len, &pos, &v)) != PBURST_OK) return err;
+    if (v < 1000000 || v > UINT32_MAX) {
+        return PBURST_ERR_FIELD;  // Durations are converted with whole ticks per microsecond
+    }
+    header->resolution_hz = (uint32_t)v;
+    if ((err = get_uvarint(buf, len, &pos, &v)) != PBURST_OK) return err;
+    header->start_timestamp = varint_unzigzag(v);
+    if ((err = get_uvarint(buf, len, &pos, &v)) != PBURST_OK) return err;
+    if (v > UINT8_MAX || v > max_pulses) {
+        return PBURST_ERR_SIZE;
+    }
+    header->num_pulses = (uint8_t)v;
+
+    uint32_t ticks_per_us = header->resolution_hz / 1000000;
+    for (uint8_t i = 0; i < header->num_pulses; i++) {
+        if ((err = get_uvarint(buf, len, &pos, &v)) != PBURST_OK) return err;
+        if (v > UINT16_MAX) {
+            return PBURST_ERR_FIELD;
+        }
+        pulses[i].duration_ticks = (uint16_t)v;
+        pulses[i].duration_us = (uint32_t)v / ticks_per_us;
+        if ((err = get_uvarint(buf, len, &pos, &v)) != PBURST_OK) return err;
+        pulses[i].separation_us = varint_unzigzag(v);
+    }
+
+    *consumed = pos;
+    return PBURST_OK;
+}
+
+pburst_status_t pburst_decode(const uint8_t *buf, size_t len, pburst_bin_header_t *header,
+                              pburst_pulse_t *pulses, size_t max_pulses)
+{
+    size_t consumed;
+    pburst_status_t err = pburst_decode_next(buf, len, &consumed, header, pulses, max_pulses);
+    if (err != PBURST_OK) {
+        return err;
+    }
+    return consumed == len ? PBURST_OK : PBURST_ERR_SIZE;
+}
+
+const char *pburst_status_name(pburst_status_t status)
+{
+    switch (status) {
+    case PBURST_OK:          return "ok";
+    case PBURST_ERR_VERSION: return "unknown magic or version";
+    case PBURST_ERR_SIZE:    return "bad size";
+    case PBURST_ERR_FIELD:   return "field out of range";
+    default:                 return "unknown";
+    }
+}
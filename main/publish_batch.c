@@ -0,0 +1,204 @@
+#include "publish_batch.h"
+
+#ifdef CONFIG_ENABLE_PUBLISH_BATCHING
+
+#include <string.h>
+#include "esp_log.h"
+#include "mqtt.h"
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+#include "outbox.h"
+#endif
+
+#ifdef CONFIG_ENABLE_BATCH_COMPRESSION
+#include "esp_timer.h"
+#include "lzss.h"
+
+// Compressed batch of any topic; only mss_sender flushes batches
+static uint8_t s_lz_buf[CONFIG_PUBLISH_BATCH_MAX_BYTES];
+
+// Without batch_compression=lzss one batch in this many is compressed, only to
+// report the ratio the station would get
+#define LZ_SAMPLE_EVERY 16
+#endif
+
+static const char *TAG = "PUBLISH_BATCH";
+
+static const char *s_flush_names[PUBLISH_BATCH_FLUSH_REASONS] = { "size", "delay", "forced" };
+
+// Bytes kept free for the framing: JSON '[' or ',' plus "]\0", the NUL after text lines
+static size_t framing(const publish_batch_t *batch)
+{
+    switch (batch->format) {
+    case PUBLISH_BATCH_JSON_ARRAY:
+        return 3;
+    case PUBLISH_BATCH_LINES:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+void publish_batch_init(publish_batch_t *batch, char *topic, publish_batch_format_t format,
+                        uint8_t *buf, size_t budget, uint32_t max_delay_ms, bool compress)
+{
+    memset(batch, 0, sizeof(*batch));
+    batch->topic = topic;
+    batch->format = format;
+    batch->buf = buf;
+    batch->budget = budget;
+    batch->max_delay_us = (int64_t)max_delay_ms * 1000LL;
+    batch->compress = compress;
+}
+
+// JSON and line payloads are published as text; binary and compressed ones with their length.
+// A payload the client does not take (refused by admission, pipeline full) goes to the
+// outbox to be replayed; only what the outbox cannot keep either is lost.
+static int publish(publish_batch_t *batch, const uint8_t *payload, size_t len, bool text)
+{
+    int msg_id;
+    if (text) {
+        // mqtt_send_mss() publishes up to the terminator
+        msg_id = mqtt_send_mss(batch->topic, (char *)payload);
+    } else {
+        msg_id = mqtt_send_bin(batch->topic, payload, len);
+    }
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+    if (msg_id < 0 && outbox_store(batch->topic, payload, len) == ESP_OK) {
+        batch->stats.stored++;
+        msg_id = 0;
+    }
+#endif
+    return msg_id;
+}
+
+static void account(publish_batch_t *batch, uint32_t records, size_t len, int64_t wait_us,
+                    publish_batch_flush_t reason, int msg_id)
+{
+    if (msg_id < 0) {
+        batch->stats.failed++;
+        batch->stats.lost_records += records;
+        ESP_LOGW(TAG, "Batch of %lu records on %s lost (%u bytes, oldest queued %lld ms ago)",
+                 (unsigned long)records, batch->topic, (unsigned)len, (long long)(wait_us / 1000));
+        return;
+    }
+    batch->stats.batches++;
+    batch->stats.records += records;
+    if (records > batch->stats.max_records) {
+        batch->stats.max_records = records;
+    }
+    batch->stats.flushes[reason]++;
+    batch->stats.bytes += len;
+    batch->stats.delay_sum_us += (uint64_t)wait_us;
+    if (wait_us > batch->stats.delay_max_us) {
+        batch->stats.delay_max_us = (uint32_t)wait_us;
+    }
+    ESP_LOGD(TAG, "%s: %lu records, %u bytes, waited %lld us (%s)", batch->topic,
+             (unsigned long)records, (unsigned)len, (long long)wait_us, s_flush_names[reason]);
+}
+
+int publish_batch_flush(publish_batch_t *batch, publish_batch_flush_t reason, int64_t now_us)
+{
+    if (batch->records == 0) {
+        return 0;
+    }
+    // framing() always leaves room for the closing bracket and the terminator
+    if (batch->format == PUBLISH_BATCH_JSON_ARRAY) {
+        batch->buf[batch->len++] = ']';
+    }
+    bool text = (batch->format != PUBLISH_BATCH_CONCAT);
+    if (text) {
+        batch->buf[batch->len] = '\0';  // Not counted in len
+    }
+    const uint8_t *payload = batch->buf;
+    size_t payload_len = batch->len;
+#ifdef CONFIG_ENABLE_BATCH_COMPRESSION
+    // len excludes the terminator: a decompressed JSON batch is the bare array
+    if (batch->compress || batch->lz_flushes++ % LZ_SAMPLE_EVERY == 0) {
+        int64_t lz_start_us = esp_timer_get_time();
+        size_t lz_len = lzss_compress(s_lz_buf, sizeof(s_lz_buf), batch->buf, batch->len);
+        batch->stats.lz_cpu_us += (uint64_t)(esp_timer_get_time() - lz_start_us);
+        batch->stats.lz_batches++;
+        batch->stats.lz_in_bytes += batch->len;
+        if (lz_len == 0 || lz_len >= batch->len) {
+            batch->stats.lz_incompressible++;
+            batch->stats.lz_out_bytes += batch->len;
+        } else {
+            batch->stats.lz_out_bytes += lz_len;
+            if (batch->compress) {
+                payload = s_lz_buf;
+                payload_len = lz_len;
+                text = false;
+            }
+        }
+    }
+#endif
+    int msg_id = publish(batch, payload, payload_len, text);
+    account(batch, batch->records, payload_len, now_us - batch->first_us, reason, msg_id);
+    batch->len = 0;
+    batch->records = 0;
+    batch->last_msg_id = msg_id;
+    return msg_id;
+}
+
+void publish_batch_add(publish_batch_t *batch, const void *record, size_t len, int64_t now_us)
+{
+    size_t overhead = framing(batch);
+
+    if (batch->records > 0 && batch->len + len + overhead > batch->budget) {
+        publish_batch_flush(batch, PUBLISH_BATCH_FLUSH_SIZE, now_us);
+    }
+
+    if (len + overhead > batch->budget) {
+        // Too large to batch: published alone, unwrapped, as without batching (text
+        // records are NUL-terminated by the caller)
+        int msg_id = publish(batch, record, len, batch->format != PUBLISH_BATCH_CONCAT);
+        account(batch, 1, len, 0, PUBLISH_BATCH_FLUSH_SIZE, msg_id);
+        return;
+    }
+
+    if (batch->format == PUBLISH_BATCH_JSON_ARRAY) {
+        batch->buf[batch->len++] = (batch->records == 0) ? '[' : ',';
+    }
+    memcpy(batch->buf + batch->len, record, len);
+    publish_batch_commit(batch, len, now_us);
+}
+
+uint8_t *publish_batch_tail(publish_batch_t *batch, size_t *room)
+{
+    size_t used = batch->len + framing(batch);
+    *room = (used < batch->budget) ? batch->budget - used : 0;
+    return batch->buf + batch->len;
+}
+
+void publish_batch_commit(publish_batch_t *batch, size_t len, int64_t now_us)
+{
+    if (batch->records == 0) {
+        batch->first_us = now_us;
+    }
+    batch->len += len;
+    batch->records++;
+
+    // A full budget will not take another record: no point waiting for the delay
+    if (batch->len + framing(batch) >= batch->budget) {
+        publish_batch_flush(batch, PUBLISH_BATCH_FLUSH_SIZE, now_us);
+    }
+}
+
+void publish_batch_poll(publish_batch_t *batch, int64_t now_us)
+{
+    if (batch->records > 0 && now_us >= publish_batch_deadline_us(batch)) {
+        publish_batch_flush(batch, PUBLISH_BATCH_FLUSH_DELAY, now_us);
+    }
+}
+
+int64_t publish_batch_deadline_us(const publish_batch_t *batch)
+{
+    return (batch->records > 0) ? batch->first_us + batch->max_delay_us : INT64_MAX;
+}
+
+const char *publish_batch_flush_name(publish_batch_flush_t reason)
+{
+    return (reason < PUBLISH_BATCH_FLUSH_REASONS) ? s_flush_names[reason] : "unknown";
+}
+
+#endif // CONFIG_ENABLE_PUBLISH_BATCHING
@@ -0,0 +1,244 @@
+#include "publish_pipeline.h"
+
+#ifdef CONFIG_ENABLE_PUBLISH_PIPELINE
+
+#include <stdatomic.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mqtt.h"
+#include "tm_pool.h"
+
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+#include "outbox.h"
+#endif
+
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+#include "rtc_window_ring.h"
+#endif
+
+static const char *TAG = "PUBLISH_PIPELINE";
+
+// Ready buffer: one pool block with the header, the topic and the payload,
+// both NUL-terminated
+typedef struct {
+    int64_t submitted_us;
+    uint32_t len;
+    bool window_marker;     // No topic nor payload: the previous buffer carried window window_seq
+    uint32_t window_seq;
+    char topic[];
+} pipeline_item_t;
+
+static QueueHandle_t s_queue = NULL;
+
+// Written by the serializer
+static uint32_t s_submitted;
+static uint32_t s_dropped;
+static uint32_t s_depth_max;
+static uint32_t s_bytes_max;
+static uint64_t s_submit_block_us;
+// Written by the network task
+static uint32_t s_published;
+static uint32_t s_failed;
+static uint32_t s_wait_max_us;
+static uint64_t s_wait_sum_us;
+static uint64_t s_busy_us;
+static bool s_last_ok;
+// Both
+static _Atomic uint32_t s_bytes;
+static _Atomic uint32_t s_windows;      // Window markers queued
+
+static void publish_item(pipeline_item_t *item)
+{
+    size_t topic_len = strlen(item->topic);
+    const uint8_t *payload = (const uint8_t *)item->topic + topic_len + 1;
+    int64_t start_us = esp_timer_get_time();
+
+    uint32_t wait_us = (uint32_t)(start_us - item->submitted_us);
+    s_wait_sum_us += wait_us;
+    if (wait_us > s_wait_max_us) {
+        s_wait_max_us = wait_us;
+    }
+
+    int msg_id = mqtt_publish_now(item->topic, payload, item->len);
+    s_busy_us += (uint64_t)(esp_timer_get_time() - start_us);
+    s_last_ok = (msg_id >= 0);
+    if (msg_id < 0) {
+        s_failed++;
+        ESP_LOGE(TAG, "Failed to publish %lu bytes to %s (error: %d)", (unsigned long)item->len,
+                 item->topic, msg_id);
+    } else {
+        s_published++;
+    }
+
+    atomic_fetch_sub(&s_bytes, item->len);
+    tm_pool_free(item);
+}
+
+static void publish_task(void *parameters)
+{
+    pipeline_item_t *item;
+
+    ESP_LOGI(TAG, "Network stage running on core %d", xPortGetCoreID());
+    while (true) {
+        TickType_t wait = pdMS_TO_TICKS(1000);
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+        // Replay pace while there is a backlog and the broker is reachable
+        if (outbox_has_pending() && mqtt_is_connected()) {
+            wait = pdMS_TO_TICKS(1000 / CONFIG_OUTBOX_REPLAY_PER_SEC);
+        }
+#endif
+        if (xQueueReceive(s_queue, &item, wait) == pdTRUE) {
+            if (item->window_marker) {
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+                // The window is out only if the client (or the outbox) took its buffer
+                if (s_last_ok) {
+                    rtc_window_ring_mark_published(item->window_seq);
+                }
+#endif
+                tm_pool_free(item);
+                atomic_fetch_sub(&s_windows, 1);
+            } else {
+                publish_item(item);
+            }
+        }
+#ifdef CONFIG_ENABLE_MQTT_OUTBOX
+        outbox_poll(esp_timer_get_time());
+#endif
+    }
+}
+
+esp_err_t publish_pipeline_start(void)
+{
+    s_queue = xQueueCreate(CONFIG_PUBLISH_PIPELINE_DEPTH, sizeof(pipeline_item_t *));
+    if (s_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create the pipeline queue");
+        return ESP_ERR_NO_MEM;
+    }
+    // Core 0: next to the WiFi and lwIP tasks, away from acquisition
+    if (xTaskCreatePinnedToCore(&publish_task, "MQTT publish", 4096, NULL, 5, NULL, 0) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the network task");
+        vQueueDelete(s_queue);
+        s_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Publish pipeline: %d buffers", CONFIG_PUBLISH_PIPELINE_DEPTH);
+    return ESP_OK;
+}
+
+bool publish_pipeline_running(void)
+{
+    return s_queue != NULL;
+}
+
+// Queue a ready buffer; the serializer waits for room up to the submit timeout
+static bool enqueue(pipeline_item_t *item)
+{
+    if (xQueueSend(s_queue, &item, 0) == pdTRUE) {
+        return true;
+    }
+    // Network stage saturated: hold the serializer back, not the acquisition
+    if (xQueueSend(s_queue, &item, pdMS_TO_TICKS(CONFIG_PUBLISH_PIPELINE_SUBMIT_TIMEOUT_MS)) != pdTRUE) {
+        return false;
+    }
+    s_submit_block_us += (uint64_t)(esp_timer_get_time() - item->submitted_us);
+    return true;
+}
+
+int publish_pipeline_submit(const char *topic, const void *data, size_t len)
+{
+    size_t topic_len = strlen(topic);
+    pipeline_item_t *item = tm_pool_alloc(sizeof(*item) + topic_len + 1 + len + 1);
+    if (item == NULL) {
+        if (s_dropped++ == 0) {
+            ESP_LOGW(TAG, "No buffer for %u bytes to %s, dropped", (unsigned)len, topic);
+        }
+        return -1;
+    }
+    char *payload = item->topic + topic_len + 1;
+    memcpy(item->topic, topic, topic_len + 1);
+    memcpy(payload, data, len);
+    payload[len] = '\0';
+    item->len = (uint32_t)len;
+    item->window_marker = false;
+    item->submitted_us = esp_timer_get_time();
+
+    uint32_t bytes = atomic_fetch_add(&s_bytes, (uint32_t)len) + (uint32_t)len;
+    if (!enqueue(item)) {
+        atomic_fetch_sub(&s_bytes, (uint32_t)len);
+        tm_pool_free(item);
+        if (s_dropped++ == 0) {
+            ESP_LOGW(TAG, "Pipeline full for %d ms, dropped %u bytes to %s",
+                     CONFIG_PUBLISH_PIPELINE_SUBMIT_TIMEOUT_MS, (unsigned)len, topic);
+        }
+        return -1;
+    }
+
+    s_submitted++;
+    uint32_t depth = (uint32_t)uxQueueMessagesWaiting(s_queue);
+    if (depth > s_depth_max) {
+        s_depth_max = depth;
+    }
+    if (bytes > s_bytes_max) {
+        s_bytes_max = bytes;
+    }
+    return 0;
+}
+
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+int publish_pipeline_mark_window(uint32_t seq)
+{
+    pipeline_item_t *item = tm_pool_alloc(sizeof(*item) + 1);
+    if (item == NULL) {
+        return -1;
+    }
+    item->len = 0;
+    item->topic[0] = '\0';
+    item->window_marker = true;
+    item->window_seq = seq;
+    item->submitted_us = esp_timer_get_time();
+    atomic_fetch_add(&s_windows, 1);
+    if (!enqueue(item)) {
+        atomic_fetch_sub(&s_windows, 1);
+        tm_pool_free(item);
+        return -1;
+    }
+    return 0;
+}
+
+uint32_t publish_pipeline_windows_queued(void)
+{
+    return atomic_load(&s_windows);
+}
+#endif
+
+size_t publish_pipeline_bytes(void)
+{
+    return atomic_load(&s_bytes);
+}
+
+void publish_pipeline_get_stats(publish_pipeline_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->capacity = CONFIG_PUBLISH_PIPELINE_DEPTH;
+    if (s_queue == NULL) {
+        return;
+    }
+    stats->submitted = s_submitted;
+    stats->published = s_published;
+    stats->failed = s_failed;
+    stats->dropped = s_dropped;
+    stats->depth = (uint32_t)uxQueueMessagesWaiting(s_queue);
+    stats->depth_max = s_depth_max;
+    stats->bytes = atomic_load(&s_bytes);
+    stats->bytes_max = s_bytes_max;
+    stats->wait_max_us = s_wait_max_us;
+    stats->wait_sum_us = s_wait_sum_us;
+    stats->submit_block_us = s_submit_block_us;
+    stats->busy_us = s_busy_us;
+}
+
+#endif // CONFIG_ENABLE_PUBLISH_PIPELINE
@@ -14,7 +14,11 @@ void IRAM_ATTR detection_isr_handler(void* arg) {
 
     message.tm_message_type = TM_PULSE_DETECTION;
 
-    xQueueSendFromISR(telemetry_queue, &message, NULL);
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    telemetry_ring_push_from_isr(TELEMETRY_STREAM_DETECT, &message, &higher_priority_task_woken);
+    if (higher_priority_task_woken) {
+        portYIELD_FROM_ISR();
+    }
 }
 
 void init_GPIO() {
@@ -55,6 +59,21 @@ void reconfigure_GPIO_interrupts(void) {
     ESP_LOGI("PULSE_DETECTION", "GPIO interrupts reconfigured");
 }
 
+// Habilitar/deshabilitar la interrupción de detección de un canal
+// (cuarentena de canal ruidoso, ver channel_health.c)
+void set_GPIO_detection_enabled(int channel_index, bool enabled) {
+    static const int pins[3] = {PIN_PULSE_IN_CH1, PIN_PULSE_IN_CH2, PIN_PULSE_IN_CH3};
+
+    if (channel_index < 0 || channel_index >= 3) {
+        return;
+    }
+    if (enabled) {
+        gpio_intr_enable(pins[channel_index]);
+    } else {
+        gpio_intr_disable(pins[channel_index]);
+    }
+}
+
 #else // CONFIG_ENABLE_GPIO_PULSE_DETECTION
 
 // Stub functions when GPIO pulse detection is disabled
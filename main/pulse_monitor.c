@@ -4,6 +4,28 @@
 #include <string.h>
 #include <inttypes.h>
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "timebase.h"
+
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+#include "rtc_window_ring.h"
+#endif
+
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+#include "rmt_pulse_capture.h"
+#endif
+
+#ifdef CONFIG_ENABLE_CHANNEL_HEALTH
+#include "channel_health.h"
+#endif
+
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+#include "gle_detector.h"
+#endif
+
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+#include "baro_correction.h"
+#endif
 
 static const char *TAG = "PULSE_MONITOR";
 
@@ -11,6 +33,19 @@ static const char *TAG = "PULSE_MONITOR";
 static pcnt_unit_handle_t pcnt_units[3] = {NULL, NULL, NULL};
 static pcnt_channel_handle_t pcnt_channels[3] = {NULL, NULL, NULL};
 
+#ifdef CONFIG_ENABLE_PCNT_GATE
+// Unidades "gated": misma entrada de pulsos, pero con la línea de veto/gate en la
+// entrada de nivel del canal PCNT. Cada canal PCNT de una unidad suma en el mismo
+// contador, así que la cuenta con gate necesita su propia unidad (6 de las 8 del ESP32).
+static pcnt_unit_handle_t pcnt_gated_units[3] = {NULL, NULL, NULL};
+static pcnt_channel_handle_t pcnt_gated_channels[3] = {NULL, NULL, NULL};
+static const int pcnt_gate_gpios[3] = {
+    CONFIG_PCNT_GATE_GPIO_CH1,
+    CONFIG_PCNT_GATE_GPIO_CH2,
+    CONFIG_PCNT_GATE_GPIO_CH3,
+};
+#endif
+
 // Calcular el próximo segundo alineado (10, 20, 30, 40, 50, 0)
 static int calculate_next_aligned_second(time_t current_time) {
     int current_second = current_time % 60;
@@ -32,9 +67,14 @@ static int calculate_next_aligned_second(time_t current_time) {
 
 // Calcular el tiempo de espera hasta el siguiente segundo alineado en milisegundos
 // Retorna el tiempo en milisegundos y actualiza next_aligned con el segundo objetivo
+// Antes de la primera sincronización SNTP se alinea sobre la hora provisional del RTC
+// o, sin ella, sobre el reloj esp_timer
 static int64_t calculate_wait_time_to_aligned_second(int *next_aligned) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
+    int64_t now_us = timebase_wall_now_us();
+    struct timeval tv = {
+        .tv_sec = (time_t)(now_us / 1000000LL),
+        .tv_usec = (suseconds_t)(now_us % 1000000LL),
+    };
     
     time_t now = tv.tv_sec;
     int current_second = now % 60;
@@ -73,24 +113,20 @@ static int64_t calculate_wait_time_to_aligned_second(int *next_aligned) {
     return wait_ms;
 }
 
-esp_err_t pulse_counter_init(int channel_index, int pulse_gpio_num) {
-    if (channel_index < 0 || channel_index >= 3) {
-        ESP_LOGE(TAG, "Invalid channel index: %d", channel_index);
-        return ESP_ERR_INVALID_ARG;
-    }
-    
-    if (pcnt_units[channel_index] != NULL) {
-        ESP_LOGW(TAG, "Channel %d already initialized", channel_index);
-        return ESP_ERR_INVALID_STATE;
-    }
-    
+// Crear, configurar y arrancar una unidad PCNT con un canal que cuenta flancos de
+// subida en pulse_gpio_num. Si level_gpio_num >= 0, esa entrada controla el conteo
+// según level_high_action / level_low_action.
+static esp_err_t pcnt_unit_setup(int channel_index, int pulse_gpio_num, int level_gpio_num,
+                                 pcnt_channel_level_action_t level_high_action,
+                                 pcnt_channel_level_action_t level_low_action,
+                                 pcnt_unit_handle_t *unit, pcnt_channel_handle_t *channel) {
     // 1. Crear unidad PCNT
     pcnt_unit_config_t unit_config = {
         .high_limit = 32767,  // Máximo valor int16_t
         .low_limit = -32768,  // Mínimo valor int16_t
     };
     
-    esp_err_t ret = pcnt_new_unit(&unit_config, &pcnt_units[channel_index]);
+    esp_err_t ret = pcnt_new_unit(&unit_config, unit);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to create PCNT unit for channel %d: %s", 
                  channel_index, esp_err_to_name(ret));
@@ -100,16 +136,15 @@ esp_err_t pulse_counter_init(int channel_index, int pulse_gpio_num) {
     // 2. Crear canal
     pcnt_chan_config_t chan_config = {
         .edge_gpio_num = pulse_gpio_num,
-        .level_gpio_num = -1,  // No usado
+        .level_gpio_num = level_gpio_num,  // -1 = no usado
     };
     
-    ret = pcnt_new_channel(pcnt_units[channel_index], &chan_config, 
-                           &pcnt_channels[channel_index]);
+    ret = pcnt_new_channel(*unit, &chan_config, channel);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to create PCNT channel for channel %d: %s", 
                  channel_index, esp_err_to_name(ret));
-        pcnt_del_unit(pcnt_units[channel_index]);
-        pcnt_units[channel_index] = NULL;
+        pcnt_del_unit(*unit);
+        *unit = NULL;
         return ret;
     }
     
@@ -122,7 +157,7 @@ esp_err_t pulse_counter_init(int channel_index, int pulse_gpio_num) {
     // Probando configuración invertida: contar solo en flanco de subida
     // Si esto funciona correctamente (10 cuentas en lugar de 20), entonces
     // el problema es cómo el PCNT interpreta los flancos
-    ret = pcnt_channel_set_edge_action(pcnt_channels[channel_index],
+    ret = pcnt_channel_set_edge_action(*channel,
                                         PCNT_CHANNEL_EDGE_ACTION_INCREASE,  // Positivo (subida): incrementar
                                         PCNT_CHANNEL_EDGE_ACTION_HOLD);     // Negativo (bajada): mantener (no contar)
     if (ret != ESP_OK) {
@@ -131,10 +166,8 @@ esp_err_t pulse_counter_init(int channel_index, int pulse_gpio_num) {
         goto cleanup;
     }
     
-    // 4. Configurar acciones de nivel (no usado, pero necesario)
-    ret = pcnt_channel_set_level_action(pcnt_channels[channel_index],
-                                         PCNT_CHANNEL_LEVEL_ACTION_KEEP,
-                                         PCNT_CHANNEL_LEVEL_ACTION_KEEP);
+    // 4. Configurar acciones de nivel (KEEP/KEEP si no hay entrada de nivel)
+    ret = pcnt_channel_set_level_action(*channel, level_high_action, level_low_action);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set level action for channel %d: %s", 
                  channel_index, esp_err_to_name(ret));
@@ -146,7 +179,7 @@ esp_err_t pulse_counter_init(int channel_index, int pulse_gpio_num) {
     pcnt_glitch_filter_config_t filter_config = {
         .max_glitch_ns = 1300,  // ~1.3μs
     };
-    ret = pcnt_unit_set_glitch_filter(pcnt_units[channel_index], &filter_config);
+    ret = pcnt_unit_set_glitch_filter(*unit, &filter_config);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set glitch filter for channel %d: %s", 
                  channel_index, esp_err_to_name(ret));
@@ -154,7 +187,7 @@ esp_err_t pulse_counter_init(int channel_index, int pulse_gpio_num) {
     }
     
     // 6. Inicializar contador
-    ret = pcnt_unit_clear_count(pcnt_units[channel_index]);
+    ret = pcnt_unit_clear_count(*unit);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to clear count for channel %d: %s", 
                  channel_index, esp_err_to_name(ret));
@@ -162,7 +195,7 @@ esp_err_t pulse_counter_init(int channel_index, int pulse_gpio_num) {
     }
     
     // 7. Habilitar unidad PCNT (requerido antes de iniciar)
-    ret = pcnt_unit_enable(pcnt_units[channel_index]);
+    ret = pcnt_unit_enable(*unit);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to enable PCNT unit for channel %d: %s", 
                  channel_index, esp_err_to_name(ret));
@@ -170,28 +203,75 @@ esp_err_t pulse_counter_init(int channel_index, int pulse_gpio_num) {
     }
     
     // 8. Iniciar contador
-    ret = pcnt_unit_start(pcnt_units[channel_index]);
+    ret = pcnt_unit_start(*unit);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to start PCNT unit for channel %d: %s", 
                  channel_index, esp_err_to_name(ret));
         goto cleanup;
     }
     
-    ESP_LOGI(TAG, "PCNT channel %d initialized on GPIO %d", channel_index, pulse_gpio_num);
     return ESP_OK;
     
 cleanup:
-    if (pcnt_channels[channel_index]) {
-        pcnt_del_channel(pcnt_channels[channel_index]);
-        pcnt_channels[channel_index] = NULL;
+    if (*channel) {
+        pcnt_del_channel(*channel);
+        *channel = NULL;
     }
-    if (pcnt_units[channel_index]) {
-        pcnt_del_unit(pcnt_units[channel_index]);
-        pcnt_units[channel_index] = NULL;
+    if (*unit) {
+        pcnt_del_unit(*unit);
+        *unit = NULL;
     }
     return ret;
 }
 
+esp_err_t pulse_counter_init(int channel_index, int pulse_gpio_num) {
+    if (channel_index < 0 || channel_index >= 3) {
+        ESP_LOGE(TAG, "Invalid channel index: %d", channel_index);
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (pcnt_units[channel_index] != NULL) {
+        ESP_LOGW(TAG, "Channel %d already initialized", channel_index);
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    esp_err_t ret = pcnt_unit_setup(channel_index, pulse_gpio_num, -1,
+                                    PCNT_CHANNEL_LEVEL_ACTION_KEEP,
+                                    PCNT_CHANNEL_LEVEL_ACTION_KEEP,
+                                    &pcnt_units[channel_index], &pcnt_channels[channel_index]);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    ESP_LOGI(TAG, "PCNT channel %d initialized on GPIO %d", channel_index, pulse_gpio_num);
+
+#ifdef CONFIG_ENABLE_PCNT_GATE
+    int gate_gpio_num = pcnt_gate_gpios[channel_index];
+    if (gate_gpio_num >= 0) {
+#ifdef CONFIG_PCNT_GATE_ACTION_HOLD
+        // Veto: el contador "gated" se detiene mientras la entrada de gate está en alto
+        pcnt_channel_level_action_t high_action = PCNT_CHANNEL_LEVEL_ACTION_HOLD;
+        pcnt_channel_level_action_t low_action = PCNT_CHANNEL_LEVEL_ACTION_KEEP;
+#else
+        // Inhibit: el contador "gated" solo cuenta mientras la entrada de gate está en alto
+        pcnt_channel_level_action_t high_action = PCNT_CHANNEL_LEVEL_ACTION_KEEP;
+        pcnt_channel_level_action_t low_action = PCNT_CHANNEL_LEVEL_ACTION_HOLD;
+#endif
+        ret = pcnt_unit_setup(channel_index, pulse_gpio_num, gate_gpio_num,
+                              high_action, low_action,
+                              &pcnt_gated_units[channel_index], &pcnt_gated_channels[channel_index]);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to initialize gated PCNT unit for channel %d", channel_index);
+            pulse_counter_deinit(channel_index);
+            return ret;
+        }
+        ESP_LOGI(TAG, "PCNT channel %d gated by GPIO %d", channel_index, gate_gpio_num);
+    }
+#endif
+
+    return ESP_OK;
+}
+
 esp_err_t pulse_counter_deinit(int channel_index) {
     if (channel_index < 0 || channel_index >= 3) {
         return ESP_ERR_INVALID_ARG;
@@ -209,18 +289,28 @@ esp_err_t pulse_counter_deinit(int channel_index) {
         pcnt_units[channel_index] = NULL;
         if (ret == ESP_OK) ret = ret2;
     }
+
+#ifdef CONFIG_ENABLE_PCNT_GATE
+    if (pcnt_gated_channels[channel_index]) {
+        esp_err_t ret2 = pcnt_del_channel(pcnt_gated_channels[channel_index]);
+        pcnt_gated_channels[channel_index] = NULL;
+        if (ret == ESP_OK) ret = ret2;
+    }
+
+    if (pcnt_gated_units[channel_index]) {
+        esp_err_t ret2 = pcnt_del_unit(pcnt_gated_units[channel_index]);
+        pcnt_gated_units[channel_index] = NULL;
+        if (ret == ESP_OK) ret = ret2;
+    }
+#endif
     
     return ret;
 }
 
-int16_t get_and_clear(int channel_index) {
-    if (channel_index < 0 || channel_index >= 3 || pcnt_units[channel_index] == NULL) {
-        ESP_LOGE(TAG, "Invalid channel index or unit not initialized: %d", channel_index);
-        return 0;
-    }
-    
+// Leer y limpiar el contador de una unidad PCNT, saturando a int16_t
+static int16_t unit_get_and_clear(pcnt_unit_handle_t unit, int channel_index) {
     int count = 0;
-    esp_err_t ret = pcnt_unit_get_count(pcnt_units[channel_index], &count);
+    esp_err_t ret = pcnt_unit_get_count(unit, &count);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to get count for channel %d: %s", 
                  channel_index, esp_err_to_name(ret));
@@ -237,7 +327,7 @@ int16_t get_and_clear(int channel_index) {
     }
     
     // Limpiar contador
-    ret = pcnt_unit_clear_count(pcnt_units[channel_index]);
+    ret = pcnt_unit_clear_count(unit);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to clear count for channel %d: %s", 
                  channel_index, esp_err_to_name(ret));
@@ -246,11 +336,86 @@ int16_t get_and_clear(int channel_index) {
     return (int16_t)count;
 }
 
+int16_t get_and_clear(int channel_index) {
+    if (channel_index < 0 || channel_index >= 3 || pcnt_units[channel_index] == NULL) {
+        ESP_LOGE(TAG, "Invalid channel index or unit not initialized: %d", channel_index);
+        return 0;
+    }
+    
+    return unit_get_and_clear(pcnt_units[channel_index], channel_index);
+}
+
+int16_t get_count(int channel_index) {
+    if (channel_index < 0 || channel_index >= 3 || pcnt_units[channel_index] == NULL) {
+        ESP_LOGE(TAG, "Invalid channel index or unit not initialized: %d", channel_index);
+        return 0;
+    }
+
+    int count = 0;
+    if (pcnt_unit_get_count(pcnt_units[channel_index], &count) != ESP_OK) {
+        return 0;
+    }
+    return count > 32767 ? 32767 : (int16_t)count;
+}
+
+#ifdef CONFIG_ENABLE_PCNT_GATE
+bool pulse_counter_has_gate(int channel_index) {
+    return channel_index >= 0 && channel_index < 3 && pcnt_gated_units[channel_index] != NULL;
+}
+
+int16_t get_and_clear_gated(int channel_index) {
+    if (!pulse_counter_has_gate(channel_index)) {
+        ESP_LOGE(TAG, "Invalid channel index or gated unit not initialized: %d", channel_index);
+        return 0;
+    }
+    
+    return unit_get_and_clear(pcnt_gated_units[channel_index], channel_index);
+}
+#endif
+
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+// Esperar hasta el fin de la ventana en pasos de 1 s, alimentando el detector GLE
+// con la cuenta de cada segundo (diferencia con la lectura anterior, sin limpiar
+// el contador). El último segundo de la ventana se entrega tras get_and_clear().
+static void wait_feeding_gle(int64_t wait_ms, int32_t last_peek[3], int64_t *bin_start_us) {
+    while (wait_ms > 0) {
+        int64_t step_ms = wait_ms % 1000 ? wait_ms % 1000 : 1000;
+        vTaskDelay(pdMS_TO_TICKS((TickType_t)step_ms));
+        wait_ms -= step_ms;
+        if (wait_ms <= 0) {
+            break;
+        }
+
+        int64_t bin_end_us = esp_timer_get_time();
+        int32_t bin_count[3];
+        for (int ch = 0; ch < 3; ch++) {
+            int32_t peek = get_count(ch);
+            bin_count[ch] = peek - last_peek[ch];
+            last_peek[ch] = peek;
+        }
+        gle_detector_feed(bin_count, *bin_start_us, bin_end_us);
+        *bin_start_us = bin_end_us;
+    }
+}
+#endif
+
 void task_pcnt(void *parameters) {
     const int32_t count_time_secs = 10;
     int32_t count[3] = { 0 };
-    struct timeval tv_now, tv_start;
+#ifdef CONFIG_ENABLE_PCNT_GATE
+    int32_t gated_count[3] = { 0 };
+#endif
+    struct timeval tv_now;
+    int64_t window_start_us;
     struct telemetry_message message;
+#ifndef CONFIG_ENABLE_RTC_WINDOW_RING
+    uint32_t window_seq = 0;
+#endif
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+    int32_t gle_last_peek[3] = { 0 };
+    int64_t gle_bin_start_us;
+    gle_detector_init();
+#endif
     
     ESP_LOGI(TAG, "Starting on Core %d", xPortGetCoreID());
     
@@ -300,31 +465,100 @@ void task_pcnt(void *parameters) {
     get_and_clear(0);
     get_and_clear(1);
     get_and_clear(2);
+#ifdef CONFIG_ENABLE_PCNT_GATE
+    for (int ch = 0; ch < 3; ch++) {
+        if (pulse_counter_has_gate(ch)) {
+            get_and_clear_gated(ch);
+        }
+    }
+#endif
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+    // Empezar el contraste PCNT/RMT en el mismo instante en que se descarta el primer conteo
+    uint32_t rmt_count[3];
+    rmt_pulse_capture_close_window(esp_timer_get_time());
+    rmt_pulse_capture_collect_window(rmt_count);
+#endif
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+    gle_bin_start_us = esp_timer_get_time();
+#endif
+
+    // Timestamp de inicio del primer intervalo (ahora estamos en un segundo alineado)
+    window_start_us = timebase_now_us();
     
     while (true) {
 
-        // Obtener timestamp de inicio del intervalo (ahora estamos en un segundo alineado)
-        gettimeofday(&tv_start, NULL);
-        message.payload.tm_pcnt.start_timestamp = 
-            (int64_t)tv_start.tv_sec * 1000000LL + (int64_t)tv_start.tv_usec;
+        // El intervalo empieza donde terminó el anterior (los contadores se limpiaron ahí)
+        message.payload.tm_pcnt.start_timestamp = window_start_us;
 
         // Esperar hasta el próximo segundo alineado (10, 20, 30, 40, 50, 0) antes de empezar a contar
         int next_aligned = 0;
         int64_t wait_ms = calculate_wait_time_to_aligned_second(&next_aligned);
         
+        // Al sincronizarse la hora el siguiente segundo alineado puede estar muy cerca:
+        // la ventana se alarga hasta el siguiente en lugar de quedar casi vacía
+        if (wait_ms < (int64_t)count_time_secs * 500LL) {
+            wait_ms += (int64_t)count_time_secs * 1000LL;
+            next_aligned = (next_aligned + count_time_secs) % 60;
+        }
+        
         ESP_LOGI(TAG, "Waiting %lld ms (%.3f s) until next aligned second (%d)", 
                  wait_ms, (double)wait_ms / 1000.0, next_aligned);
         
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+        wait_feeding_gle(wait_ms, gle_last_peek, &gle_bin_start_us);
+#else
         vTaskDelay(pdMS_TO_TICKS((TickType_t)wait_ms));
+#endif
         
-        // Obtener timestamp de fin del intervalo
-        gettimeofday(&tv_now, NULL);
-        message.timestamp = (int64_t)tv_now.tv_sec * 1000000LL + (int64_t)tv_now.tv_usec;
+        // Obtener timestamp de fin del intervalo (esp_timer hasta la sincronización;
+        // mss_sender convierte a hora Unix las ventanas anteriores)
+        message.timestamp = timebase_now_us();
+        window_start_us = message.timestamp;
+        int64_t wall_us = timebase_to_unix_us(message.timestamp);
+        tv_now.tv_sec = (time_t)(wall_us / 1000000LL);
+        tv_now.tv_usec = (suseconds_t)(wall_us % 1000000LL);
+        // Normalmente count_time_secs; distinta en la ventana en que llega la sincronización
+        int32_t window_secs = (int32_t)((timebase_elapsed_us(message.payload.tm_pcnt.start_timestamp,
+                                                             message.timestamp) + 500000LL) / 1000000LL);
         
         // Leer y limpiar contadores
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+        rmt_pulse_capture_close_window(esp_timer_get_time());
+#endif
         count[0] = get_and_clear(0);
         count[1] = get_and_clear(1);
         count[2] = get_and_clear(2);
+#ifdef CONFIG_ENABLE_PCNT_GATE
+        // Canales sin entrada de gate: nunca vetados, la cuenta gated es la cuenta total
+        for (int ch = 0; ch < 3; ch++) {
+            gated_count[ch] = pulse_counter_has_gate(ch) ? get_and_clear_gated(ch) : count[ch];
+        }
+#endif
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+        // Presión media exactamente sobre la misma ventana que las cuentas
+        uint32_t pressure_samples = baro_correction_close_window(&message.payload.tm_pcnt.pressure_hpa);
+        baro_correction_get(&message.payload.tm_pcnt.baro_beta, &message.payload.tm_pcnt.baro_p0_hpa);
+#endif
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+        // Último segundo de la ventana, antes de la espera del contraste RMT
+        {
+            int64_t bin_end_us = esp_timer_get_time();
+            int32_t bin_count[3];
+            for (int ch = 0; ch < 3; ch++) {
+                bin_count[ch] = count[ch] - gle_last_peek[ch];
+                gle_last_peek[ch] = 0;
+            }
+            gle_detector_feed(bin_count, gle_bin_start_us, bin_end_us);
+            gle_bin_start_us = bin_end_us;
+        }
+#endif
+        
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+        // Dar tiempo al RMT para entregar los grupos de pulsos abiertos en el límite
+        // (un grupo se cierra tras el timeout de inactividad o al llenar el buffer)
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_RMT_XCHECK_SETTLE_MS));
+        rmt_pulse_capture_collect_window(rmt_count);
+#endif
         
         // Formatear timestamp en formato ISO 8601
         struct tm timeinfo;
@@ -341,23 +575,91 @@ void task_pcnt(void *parameters) {
         ESP_LOGI(TAG, "  Channel 1:    %d pulses", (int)count[0]);
         ESP_LOGI(TAG, "  Channel 2:    %d pulses", (int)count[1]);
         ESP_LOGI(TAG, "  Channel 3:    %d pulses", (int)count[2]);
-        ESP_LOGI(TAG, "  Interval:     %ld seconds", (long)count_time_secs);
+#ifdef CONFIG_ENABLE_PCNT_GATE
+        ESP_LOGI(TAG, "  Gated:        %d / %d / %d pulses",
+                 (int)gated_count[0], (int)gated_count[1], (int)gated_count[2]);
+#endif
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+        ESP_LOGI(TAG, "  RMT:          %lu / %lu / %lu pulses (lost %ld / %ld / %ld)",
+                 (unsigned long)rmt_count[0], (unsigned long)rmt_count[1], (unsigned long)rmt_count[2],
+                 (long)(count[0] - (int32_t)rmt_count[0]),
+                 (long)(count[1] - (int32_t)rmt_count[1]),
+                 (long)(count[2] - (int32_t)rmt_count[2]));
+#endif
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+        ESP_LOGI(TAG, "  Pressure:     %.2f hPa (%lu samples)",
+                 message.payload.tm_pcnt.pressure_hpa, (unsigned long)pressure_samples);
+#endif
+        ESP_LOGI(TAG, "  Interval:     %ld seconds", (long)window_secs);
         ESP_LOGI(TAG, "  Timestamp:    %s", timestamp_str);
         ESP_LOGI(TAG, "========================================");
         
         // Preparar mensaje de telemetría
-        message.payload.tm_pcnt.integration_time_sec = count_time_secs;
+        message.payload.tm_pcnt.integration_time_sec = window_secs;
         message.payload.tm_pcnt.channel[0] = (uint32_t)count[0];
         message.payload.tm_pcnt.channel[1] = (uint32_t)count[1];
         message.payload.tm_pcnt.channel[2] = (uint32_t)count[2];
+#ifdef CONFIG_ENABLE_PCNT_GATE
+        message.payload.tm_pcnt.gated[0] = (uint32_t)gated_count[0];
+        message.payload.tm_pcnt.gated[1] = (uint32_t)gated_count[1];
+        message.payload.tm_pcnt.gated[2] = (uint32_t)gated_count[2];
+#endif
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+        message.payload.tm_pcnt.rmt[0] = rmt_count[0];
+        message.payload.tm_pcnt.rmt[1] = rmt_count[1];
+        message.payload.tm_pcnt.rmt[2] = rmt_count[2];
+#endif
+
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+        // Guardar la ventana en memoria RTC antes de publicarla: si el sistema se
+        // reinicia antes de que mss_sender la envíe, se republica en el arranque
+        rtc_window_record_t record = {
+            .start_timestamp = message.payload.tm_pcnt.start_timestamp,
+            .end_timestamp = message.timestamp,
+            .channel = {
+                message.payload.tm_pcnt.channel[0],
+                message.payload.tm_pcnt.channel[1],
+                message.payload.tm_pcnt.channel[2],
+            },
+#ifdef CONFIG_ENABLE_PCNT_GATE
+            .gated = {
+                message.payload.tm_pcnt.gated[0],
+                message.payload.tm_pcnt.gated[1],
+                message.payload.tm_pcnt.gated[2],
+            },
+#endif
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+            .rmt = { rmt_count[0], rmt_count[1], rmt_count[2] },
+#endif
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+            .pressure_hpa = message.payload.tm_pcnt.pressure_hpa,
+            .baro_beta = message.payload.tm_pcnt.baro_beta,
+            .baro_p0_hpa = message.payload.tm_pcnt.baro_p0_hpa,
+#endif
+            .integration_time_sec = (uint32_t)window_secs,
+        };
+        message.payload.tm_pcnt.seq = rtc_window_ring_push(&record);
+#else
+        message.payload.tm_pcnt.seq = window_seq++;
+#endif
         
-        // Enviar mensaje a la cola
-        if (xQueueSend(telemetry_queue, &message, pdMS_TO_TICKS(1000)) != pdTRUE) {
-            ESP_LOGE(TAG, "Failed to send message to telemetry queue (queue full or timeout)");
+        // Enviar mensaje al anillo pcnt (no bloquea: si está lleno se cuenta como descarte)
+        if (!telemetry_ring_push(TELEMETRY_STREAM_PCNT, &message)) {
+            ESP_LOGE(TAG, "Failed to send message to pcnt telemetry ring (ring full)");
         } else {
-            ESP_LOGI(TAG, "Pulse count message sent to telemetry queue (ch1=%d, ch2=%d, ch3=%d)", 
+            ESP_LOGI(TAG, "Pulse count message sent to telemetry ring (ch1=%d, ch2=%d, ch3=%d)", 
                      (int)count[0], (int)count[1], (int)count[2]);
         }
+
+#ifdef CONFIG_ENABLE_BARO_FIT
+        // Actualizar la estimación de beta con la ventana y su presión media
+        baro_fit_update(message.payload.tm_pcnt.channel, message.payload.tm_pcnt.pressure_hpa, message.timestamp);
+#endif
+
+#ifdef CONFIG_ENABLE_CHANNEL_HEALTH
+        // Clasificar los canales con la ventana recién cerrada
+        channel_health_window(count, (int)window_secs, message.timestamp);
+#endif
         
         // El bucle volverá al inicio y esperará hasta el siguiente segundo alineado
     }
@@ -4,17 +4,22 @@
 #include "datastructures.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "timebase.h"
 #include "esp_heap_caps.h"
+#include "tm_pool.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "driver/rmt_rx.h"
 #include "driver/gpio.h"
 #include <string.h>
 #include <inttypes.h>
-#include <sys/time.h>
 
 #ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
 
+#ifdef CONFIG_ENABLE_CHANNEL_HEALTH
+#include "channel_health.h"
+#endif
+
 static const char *TAG = "RMT_PULSE_CAPTURE";
 
 // RMT channel handles
@@ -37,7 +42,7 @@ static rmt_symbol_word_t rmt_rx_buffers[3][RMT_RX_BUFFER_SIZE];
 struct rmt_pulse_group {
     uint8_t channel_index;  // Internal channel index (0, 1, 2)
     uint8_t num_pulses;      // Number of pulses in this group
-    int64_t start_timestamp; // Timestamp of first pulse (microseconds Unix)
+    int64_t start_timestamp; // Timestamp of first pulse (esp_timer: microseconds since boot)
     // Flexible array member: size determined by num_pulses
     rmt_pulse_t pulses[];  // Array of pulses (size = num_pulses)
 };
@@ -48,6 +53,45 @@ static QueueHandle_t rmt_group_queue = NULL;
 // Last event timestamp per channel (for separation calculation)
 static int64_t last_event_timestamp[3] = {0, 0, 0};
 
+// Channel quarantine (noisy channel): requested by the health monitor, applied by
+// task_rmt_event_processor, which owns rmt_receive(). A quarantined channel is not
+// re-armed after its current receive completes (parked) until the quarantine is lifted.
+static volatile bool quarantine_requested[3] = {false, false, false};
+static bool channel_parked[3] = {false, false, false};
+
+// PCNT cross-check: pulses seen by the RMT path, binned into the PCNT windows.
+// task_pcnt closes a window at a boot-time boundary; pulses that start before the
+// boundary go to xcheck_current, later ones to xcheck_next (the following window).
+static portMUX_TYPE xcheck_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t xcheck_boundary_us = INT64_MAX;
+static uint32_t xcheck_current[3] = {0, 0, 0};
+static uint32_t xcheck_next[3] = {0, 0, 0};
+
+// Count the pulses of one group against the pending PCNT window boundary
+static void xcheck_count_group(const struct rmt_pulse_group *group)
+{
+    // Boot time (esp_timer), like the boundary set by task_pcnt
+    int64_t pulse_time = group->start_timestamp;
+    uint32_t before = 0;
+    uint32_t after = 0;
+
+    portENTER_CRITICAL(&xcheck_lock);
+    for (uint8_t i = 0; i < group->num_pulses; i++) {
+        // First separation is relative to the previous group, the rest are periods within the group
+        if (i > 0 && group->pulses[i].separation_us > 0) {
+            pulse_time += group->pulses[i].separation_us;
+        }
+        if (pulse_time < xcheck_boundary_us) {
+            before++;
+        } else {
+            after++;
+        }
+    }
+    xcheck_current[group->channel_index] += before;
+    xcheck_next[group->channel_index] += after;
+    portEXIT_CRITICAL(&xcheck_lock);
+}
+
 // RMT receive callback - called from ISR context
 // RMT RX captures symbols: each symbol represents a level change
 // We process symbols to detect complete pulses (rising edge + falling edge)
@@ -61,7 +105,7 @@ static bool IRAM_ATTR rmt_rx_done_callback(rmt_channel_handle_t channel, const r
     
     // RMT resolution: 2MHz = 500ns per tick = 2 ticks per microsecond
     // Lower resolution allows longer symbol duration (max ~32.7ms vs ~819μs at 80MHz)
-    const uint32_t ticks_per_us = 2;
+    const uint32_t ticks_per_us = RMT_PULSE_RESOLUTION_HZ / 1000000;
     
     // Log callback invocation (from ISR, use ESP_EARLY_LOG)
     ESP_EARLY_LOGD(TAG, "RMT callback: channel %d, %u symbols", channel_index, edata->num_symbols);
@@ -85,8 +129,8 @@ static bool IRAM_ATTR rmt_rx_done_callback(rmt_channel_handle_t channel, const r
         }
         
         size_t group_size = sizeof(struct rmt_pulse_group) + (pulse_count * sizeof(rmt_pulse_t));
-        struct rmt_pulse_group *group = (struct rmt_pulse_group*)heap_caps_malloc(
-            group_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        // Preallocated pool: no general heap traffic from the ISR
+        struct rmt_pulse_group *group = (struct rmt_pulse_group*)tm_pool_alloc_from_isr(group_size);
         
         if (group == NULL) {
             ESP_EARLY_LOGW(TAG, "Failed to allocate memory for pulse group: ch=%d, pulses=%d", 
@@ -147,6 +191,7 @@ static bool IRAM_ATTR rmt_rx_done_callback(rmt_channel_handle_t channel, const r
                         group->start_timestamp = pulse_start_time;
                     }
                     group->pulses[group->num_pulses].duration_us = duration_us;
+                    group->pulses[group->num_pulses].duration_ticks = symbol.duration0;
                     group->pulses[group->num_pulses].separation_us = separation_us;
                     group->num_pulses++;
                 }
@@ -168,12 +213,12 @@ static bool IRAM_ATTR rmt_rx_done_callback(rmt_channel_handle_t channel, const r
             BaseType_t queue_result = xQueueSendFromISR(rmt_group_queue, &group, &must_yield);
             if (queue_result != pdTRUE) {
                 ESP_EARLY_LOGW(TAG, "Failed to queue pulse group: ch=%d (queue full)", channel_index);
-                heap_caps_free(group);  // Free if queue is full
+                tm_pool_free(group);  // Free if queue is full
             }
         } else {
             // No pulses or queue not available, free the group
             if (group != NULL) {
-                heap_caps_free(group);
+                tm_pool_free(group);
             }
         }
     }
@@ -231,7 +276,7 @@ esp_err_t rmt_pulse_capture_init(void)
             .clk_src = RMT_CLK_SRC_DEFAULT,  // APB clock (typically 80MHz)
             .gpio_num = gpio_pins[i],
             .mem_block_symbols = 64,  // Memory block size
-            .resolution_hz = 2000000,  // 2MHz = 500ns per tick (allows longer symbols)
+            .resolution_hz = RMT_PULSE_RESOLUTION_HZ,  // 2MHz = 500ns per tick (allows longer symbols)
         };
         
         ret = rmt_new_rx_channel(&rx_channel_cfg, &rmt_channels[i]);
@@ -342,10 +387,13 @@ esp_err_t rmt_pulse_capture_deinit(void)
         rmt_callback_complete_queue = NULL;
     }
     
-    // Clear last event timestamps
+    // Clear last event timestamps and cross-check counters
     for (int i = 0; i < 3; i++) {
         last_event_timestamp[i] = 0;
     }
+    uint32_t discarded[3];
+    rmt_pulse_capture_collect_window(discarded);
+    rmt_pulse_capture_collect_window(discarded);
     
     ESP_LOGI(TAG, "RMT pulse capture deinitialized");
     return ret;
@@ -356,6 +404,25 @@ QueueHandle_t rmt_pulse_capture_get_event_queue(void)
     return rmt_group_queue;
 }
 
+void rmt_pulse_capture_close_window(int64_t boundary_us)
+{
+    portENTER_CRITICAL(&xcheck_lock);
+    xcheck_boundary_us = boundary_us;
+    portEXIT_CRITICAL(&xcheck_lock);
+}
+
+void rmt_pulse_capture_collect_window(uint32_t counts[3])
+{
+    portENTER_CRITICAL(&xcheck_lock);
+    for (int i = 0; i < 3; i++) {
+        counts[i] = xcheck_current[i];
+        xcheck_current[i] = xcheck_next[i];
+        xcheck_next[i] = 0;
+    }
+    xcheck_boundary_us = INT64_MAX;
+    portEXIT_CRITICAL(&xcheck_lock);
+}
+
 // Task to process RMT pulse groups and send to telemetry queue
 // Also restarts RMT receive after each callback
 void task_rmt_event_processor(void *parameters)
@@ -389,16 +456,28 @@ void task_rmt_event_processor(void *parameters)
             }
             
             struct rmt_pulse_group *group = group_ptr;  // Use pointer for clarity
+
+            // Count every captured pulse for the PCNT cross-check before anything can drop it
+            xcheck_count_group(group);
+
+#ifdef CONFIG_ENABLE_CHANNEL_HEALTH
+            channel_health_record_burst(group->channel_index, group->num_pulses);
+#endif
+
+            // Groups still in flight from a quarantined channel are not published
+            if (quarantine_requested[group->channel_index]) {
+                tm_pool_free(group_ptr);
+                continue;
+            }
             
             // Extract pulses array from group and allocate separately
             // This allows us to free the group structure while keeping the pulses array alive
             size_t pulses_size = group->num_pulses * sizeof(rmt_pulse_t);
-            rmt_pulse_t *pulses_array = (rmt_pulse_t*)heap_caps_malloc(
-                pulses_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            rmt_pulse_t *pulses_array = (rmt_pulse_t*)tm_pool_alloc(pulses_size);
             
             if (pulses_array == NULL) {
                 ESP_LOGW(TAG, "Failed to allocate memory for pulses array (%zu bytes)", pulses_size);
-                heap_caps_free(group_ptr);
+                tm_pool_free(group_ptr);
                 continue;
             }
             
@@ -406,14 +485,9 @@ void task_rmt_event_processor(void *parameters)
             memcpy(pulses_array, group->pulses, pulses_size);
             
             // Convert timestamp from boot time to Unix timestamp (with microsecond precision)
-            // group->start_timestamp is in microseconds since boot
-            // We need to convert it to Unix timestamp in microseconds
-            struct timeval tv_now;
-            gettimeofday(&tv_now, NULL);
-            int64_t current_unix_time_us = (int64_t)tv_now.tv_sec * 1000000LL + (int64_t)tv_now.tv_usec;
-            int64_t current_boot_time_us = esp_timer_get_time();
-            // Calculate Unix timestamp: current_unix - (current_boot - event_boot)
-            int64_t unix_timestamp_us = current_unix_time_us - (current_boot_time_us - group->start_timestamp);
+            // group->start_timestamp is in microseconds since boot; before the first SNTP
+            // synchronization it is kept as is and mss_sender converts it later
+            int64_t unix_timestamp_us = timebase_from_boot_us(group->start_timestamp);
             
             // Prepare telemetry message
             message.tm_message_type = TM_RMT_PULSE_EVENT;
@@ -431,13 +505,13 @@ void task_rmt_event_processor(void *parameters)
             int64_t start_ts = group->start_timestamp;
             
             // Now we can free the group structure (pulses are copied to separate memory)
-            heap_caps_free(group_ptr);
+            tm_pool_free(group_ptr);
             
-            // Send to telemetry queue
-            if (xQueueSend(telemetry_queue, &message, pdMS_TO_TICKS(100)) != pdTRUE) {
-                ESP_LOGW(TAG, "Failed to send RMT pulse group to telemetry queue (queue full)");
-                // Free pulses array if queue is full
-                heap_caps_free(pulses_array);
+            // Send to the pburst telemetry ring
+            if (!telemetry_ring_push(TELEMETRY_STREAM_PBURST, &message)) {
+                ESP_LOGW(TAG, "Failed to send RMT pulse group to telemetry ring (ring full)");
+                // Free pulses array if the ring is full
+                tm_pool_free(pulses_array);
             } else {
                 // Rate-limited logging (max 3 messages per second per channel)
                 int64_t current_time = esp_timer_get_time();
@@ -469,6 +543,13 @@ void task_rmt_event_processor(void *parameters)
             // Small delay to ensure channel is back in enable state
             // The callback handler sets channel back to RMT_FSM_ENABLE state
             vTaskDelay(pdMS_TO_TICKS(1));
+
+            // Quarantined channel: leave it idle until the quarantine is lifted
+            if (quarantine_requested[completed_channel]) {
+                channel_parked[completed_channel] = true;
+                ESP_LOGW(TAG, "RMT channel %d parked (quarantine)", completed_channel);
+                continue;
+            }
             
             // Restart receiving on this channel after callback completed
             if (rmt_channels[completed_channel] != NULL) {
@@ -486,7 +567,29 @@ void task_rmt_event_processor(void *parameters)
                 }
             }
         }
+
+        // Re-arm parked channels whose quarantine has been lifted
+        for (uint8_t i = 0; i < 3; i++) {
+            if (channel_parked[i] && !quarantine_requested[i] && rmt_channels[i] != NULL) {
+                esp_err_t ret = rmt_receive(rmt_channels[i], rmt_rx_buffers[i],
+                                            sizeof(rmt_rx_buffers[i]), &receive_cfg);
+                if (ret == ESP_OK) {
+                    channel_parked[i] = false;
+                    ESP_LOGI(TAG, "RMT channel %d re-armed after quarantine", i);
+                } else {
+                    ESP_LOGW(TAG, "Failed to re-arm RMT channel %d: %s", i, esp_err_to_name(ret));
+                }
+            }
+        }
+    }
+}
+
+void rmt_pulse_capture_set_channel_quarantine(int channel_index, bool quarantined)
+{
+    if (channel_index < 0 || channel_index >= 3) {
+        return;
     }
+    quarantine_requested[channel_index] = quarantined;
 }
 
 #endif // CONFIG_ENABLE_RMT_PULSE_DETECTION
@@ -0,0 +1,228 @@
+#include "rtc_window_ring.h"
+
+#ifdef CONFIG_ENABLE_RTC_WINDOW_RING
+
+#include <stddef.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "timebase.h"
+
+static const char *TAG = "RTC_WINDOW_RING";
+
+#define RTC_WINDOW_RING_MAGIC 0x4E4D5752  // "NMWR"
+// Bump whenever rtc_window_ring_t or rtc_window_slot_t changes: a warm reset
+// into another firmware must not parse the previous layout. 1 had no per-slot CRC.
+#define RTC_WINDOW_RING_VERSION 2
+#define RTC_WINDOW_RING_SIZE  CONFIG_RTC_WINDOW_RING_SIZE
+
+// One record with its own CRC, so an update only hashes the slot it touches
+typedef struct {
+    rtc_window_record_t record;
+    uint32_t crc;           // CRC32 of record
+} rtc_window_slot_t;
+
+// Layout stored in RTC slow memory. RTC_NOINIT_ATTR keeps the contents across
+// esp_restart(), panics and watchdog resets; only a power cycle or brown-out
+// clears it, which the magic/CRC checks detect.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;       // RTC_WINDOW_RING_VERSION
+    uint32_t record_size;   // sizeof(rtc_window_record_t), detects layout changes
+    uint32_t next_seq;      // Sequence number for the next pushed window
+    uint32_t head;          // Index where the next record will be written
+    uint32_t count;         // Number of valid records (<= RTC_WINDOW_RING_SIZE)
+    uint32_t crc;           // CRC32 of the header fields above
+    rtc_window_slot_t slots[RTC_WINDOW_RING_SIZE];
+} rtc_window_ring_t;
+
+static RTC_NOINIT_ATTR rtc_window_ring_t s_ring;
+
+// Task (task_pcnt) and mss_sender both touch the ring
+static portMUX_TYPE s_ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// First sequence number of this boot: lower ones come from previous runs
+static uint32_t s_boot_seq;
+
+static uint32_t header_crc(void)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&s_ring, offsetof(rtc_window_ring_t, crc));
+}
+
+static uint32_t slot_crc(const rtc_window_slot_t *slot)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&slot->record, sizeof(slot->record));
+}
+
+static void slot_seal(rtc_window_slot_t *slot)
+{
+    slot->crc = slot_crc(slot);
+}
+
+static void ring_reset(void)
+{
+    memset(&s_ring, 0, sizeof(s_ring));
+    s_ring.magic = RTC_WINDOW_RING_MAGIC;
+    s_ring.version = RTC_WINDOW_RING_VERSION;
+    s_ring.record_size = sizeof(rtc_window_record_t);
+    s_ring.crc = header_crc();
+}
+
+esp_err_t rtc_window_ring_init(void)
+{
+    bool valid = s_ring.magic == RTC_WINDOW_RING_MAGIC &&
+                 s_ring.version == RTC_WINDOW_RING_VERSION &&
+                 s_ring.record_size == sizeof(rtc_window_record_t) &&
+                 s_ring.head < RTC_WINDOW_RING_SIZE &&
+                 s_ring.count <= RTC_WINDOW_RING_SIZE &&
+                 s_ring.crc == header_crc();
+
+    if (!valid) {
+        ESP_LOGW(TAG, "No valid window ring in RTC memory (reset reason %d), starting empty",
+                 (int)esp_reset_reason());
+        ring_reset();
+        s_boot_seq = 0;
+        return ESP_ERR_INVALID_CRC;
+    }
+    s_boot_seq = s_ring.next_seq;
+
+    // A corrupt slot is not replayed; windows closed before the previous run got
+    // the time carry esp_timer stamps of a boot that no longer exists and cannot
+    // be placed in time
+    uint32_t corrupt = 0;
+    uint32_t unplaceable = 0;
+    for (uint32_t i = 0; i < s_ring.count; i++) {
+        rtc_window_slot_t *slot = &s_ring.slots[i];
+        if (slot->crc != slot_crc(slot)) {
+            slot->record.published = 1;
+            slot_seal(slot);
+            corrupt++;
+        } else if (!slot->record.published && (!timebase_is_unix(slot->record.start_timestamp) ||
+                                                !timebase_is_unix(slot->record.end_timestamp))) {
+            slot->record.published = 1;
+            slot_seal(slot);
+            unplaceable++;
+        }
+    }
+    if (corrupt > 0) {
+        ESP_LOGW(TAG, "Discarding %" PRIu32 " corrupt windows", corrupt);
+    }
+    if (unplaceable > 0) {
+        ESP_LOGW(TAG, "Discarding %" PRIu32 " windows without wall-clock time", unplaceable);
+    }
+
+    ESP_LOGI(TAG, "Window ring recovered: %" PRIu32 " records, %" PRIu32 " pending, next seq %" PRIu32,
+             s_ring.count, rtc_window_ring_pending_count(), s_ring.next_seq);
+    return ESP_OK;
+}
+
+uint32_t rtc_window_ring_push(const rtc_window_record_t *record)
+{
+    bool dropped = false;
+    uint32_t dropped_seq = 0;
+
+    portENTER_CRITICAL(&s_ring_lock);
+    uint32_t seq = s_ring.next_seq++;
+    rtc_window_slot_t *slot = &s_ring.slots[s_ring.head];
+    if (s_ring.count == RTC_WINDOW_RING_SIZE && !slot->record.published) {
+        dropped = true;
+        dropped_seq = slot->record.seq;
+    }
+    slot->record = *record;
+    slot->record.seq = seq;
+    slot->record.published = 0;
+    slot_seal(slot);
+    s_ring.head = (s_ring.head + 1) % RTC_WINDOW_RING_SIZE;
+    if (s_ring.count < RTC_WINDOW_RING_SIZE) {
+        s_ring.count++;
+    }
+    s_ring.crc = header_crc();
+    portEXIT_CRITICAL(&s_ring_lock);
+
+    if (dropped) {
+        // Oldest window is overwritten before it could be published
+        ESP_LOGW(TAG, "Ring full, dropping unpublished window seq %" PRIu32, dropped_seq);
+    }
+    return seq;
+}
+
+void rtc_window_ring_mark_published(uint32_t seq)
+{
+    portENTER_CRITICAL(&s_ring_lock);
+    for (uint32_t i = 0; i < s_ring.count; i++) {
+        rtc_window_slot_t *slot = &s_ring.slots[i];
+        if (slot->record.seq == seq) {
+            if (!slot->record.published) {
+                slot->record.published = 1;
+                slot_seal(slot);
+            }
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_ring_lock);
+}
+
+bool rtc_window_ring_get_pending(int64_t after_seq, rtc_window_record_t *record)
+{
+    bool found = false;
+
+    portENTER_CRITICAL(&s_ring_lock);
+    // Walk from the oldest record to the newest so replay keeps window order
+    uint32_t oldest = (s_ring.head + RTC_WINDOW_RING_SIZE - s_ring.count) % RTC_WINDOW_RING_SIZE;
+    for (uint32_t n = 0; n < s_ring.count; n++) {
+        const rtc_window_record_t *slot = &s_ring.slots[(oldest + n) % RTC_WINDOW_RING_SIZE].record;
+        if (!slot->published && (int64_t)slot->seq > after_seq) {
+            *record = *slot;
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_ring_lock);
+
+    return found;
+}
+
+uint32_t rtc_window_ring_boot_seq(void)
+{
+    return s_boot_seq;
+}
+
+uint32_t rtc_window_ring_backfill(void)
+{
+    uint32_t converted = 0;
+
+    portENTER_CRITICAL(&s_ring_lock);
+    for (uint32_t i = 0; i < s_ring.count; i++) {
+        rtc_window_slot_t *slot = &s_ring.slots[i];
+        if (!timebase_is_unix(slot->record.start_timestamp) || !timebase_is_unix(slot->record.end_timestamp)) {
+            slot->record.start_timestamp = timebase_to_unix_us(slot->record.start_timestamp);
+            slot->record.end_timestamp = timebase_to_unix_us(slot->record.end_timestamp);
+            slot_seal(slot);
+            converted++;
+        }
+    }
+    portEXIT_CRITICAL(&s_ring_lock);
+
+    return converted;
+}
+
+uint32_t rtc_window_ring_pending_count(void)
+{
+    uint32_t pending = 0;
+
+    portENTER_CRITICAL(&s_ring_lock);
+    for (uint32_t i = 0; i < s_ring.count; i++) {
+        if (!s_ring.slots[i].record.published) {
+            pending++;
+        }
+    }
+    portEXIT_CRITICAL(&s_ring_lock);
+
+    return pending;
+}
+
+#endif // CONFIG_ENABLE_RTC_WINDOW_RING
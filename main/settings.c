@@ -62,6 +62,14 @@ int nmda_init_handler(void* config_struct, const char* section, const char* name
         pconfig->wifi_password = strdup(value);
     } else if (MATCH("wifi", "wifi_ntp_server")) {
         pconfig->wifi_ntp_server = strdup(value);
+    } else if (MATCH("wifi", "wifi_static_ip")) {
+        pconfig->wifi_static_ip = strdup(value);
+    } else if (MATCH("wifi", "wifi_netmask")) {
+        pconfig->wifi_netmask = strdup(value);
+    } else if (MATCH("wifi", "wifi_gateway")) {
+        pconfig->wifi_gateway = strdup(value);
+    } else if (MATCH("wifi", "wifi_dns")) {
+        pconfig->wifi_dns = strdup(value);
     } else if (MATCH("mqtt", "mqtt_server")) {
         pconfig->mqtt_server = strdup(value);
     } else if (MATCH("mqtt", "mqtt_port")) {
@@ -89,6 +97,16 @@ int nmda_init_handler(void* config_struct, const char* section, const char* name
         pconfig->mqtt_experiment = strdup(value);
     } else if (MATCH("mqtt", "mqtt_station")) {
         pconfig->mqtt_station = strdup(value);
+    } else if (MATCH("mqtt", "pburst_format")) {
+        pconfig->pburst_format = strdup(value);
+    } else if (MATCH("mqtt", "batch_compression")) {
+        pconfig->batch_compression = strdup(value);
+    } else if (MATCH("mqtt", "telemetry_format")) {
+        pconfig->telemetry_format = strdup(value);
+    } else if (MATCH("baro", "baro_beta")) {
+        pconfig->baro_beta = strdup(value);
+    } else if (MATCH("baro", "baro_p0")) {
+        pconfig->baro_p0 = strdup(value);
     } else {
         return -1;  /* unknown section/name, error */
     }
@@ -100,6 +118,10 @@ void print_nmda_init_config(nmda_init_config_t* config_struct) {
     ESP_LOGI(TAG, "wifi_essid: %s\n", config_struct->wifi_essid ? config_struct->wifi_essid : "(null)");
     ESP_LOGI(TAG, "wifi_password: %s\n", config_struct->wifi_password ? config_struct->wifi_password : "(null)");
     ESP_LOGI(TAG, "wifi_ntp_server: %s\n", config_struct->wifi_ntp_server ? config_struct->wifi_ntp_server : "(null)");
+    ESP_LOGI(TAG, "wifi_static_ip: %s\n", config_struct->wifi_static_ip ? config_struct->wifi_static_ip : "(null)");
+    ESP_LOGI(TAG, "wifi_netmask: %s\n", config_struct->wifi_netmask ? config_struct->wifi_netmask : "(null)");
+    ESP_LOGI(TAG, "wifi_gateway: %s\n", config_struct->wifi_gateway ? config_struct->wifi_gateway : "(null)");
+    ESP_LOGI(TAG, "wifi_dns: %s\n", config_struct->wifi_dns ? config_struct->wifi_dns : "(null)");
     ESP_LOGI(TAG, "mqtt_server: %s\n", config_struct->mqtt_server ? config_struct->mqtt_server : "(null)");
     ESP_LOGI(TAG, "mqtt_transport: %s\n", config_struct->mqtt_transport ? config_struct->mqtt_transport : "(null)");
     ESP_LOGI(TAG, "mqtt_port: %s\n", config_struct->mqtt_port ? config_struct->mqtt_port : "(null)");
@@ -109,6 +131,11 @@ void print_nmda_init_config(nmda_init_config_t* config_struct) {
     ESP_LOGI(TAG, "mqtt_station: %s\n", config_struct->mqtt_station ? config_struct->mqtt_station : "(null)");
     ESP_LOGI(TAG, "mqtt_experiment: %s\n", config_struct->mqtt_experiment ? config_struct->mqtt_experiment : "(null)");
     ESP_LOGI(TAG, "mqtt_device_id: %s\n", config_struct->mqtt_device_id ? config_struct->mqtt_device_id : "(null)");
+    ESP_LOGI(TAG, "pburst_format: %s\n", config_struct->pburst_format ? config_struct->pburst_format : "(null)");
+    ESP_LOGI(TAG, "batch_compression: %s\n", config_struct->batch_compression ? config_struct->batch_compression : "(null)");
+    ESP_LOGI(TAG, "telemetry_format: %s\n", config_struct->telemetry_format ? config_struct->telemetry_format : "(null)");
+    ESP_LOGI(TAG, "baro_beta: %s\n", config_struct->baro_beta ? config_struct->baro_beta : "(null)");
+    ESP_LOGI(TAG, "baro_p0: %s\n", config_struct->baro_p0 ? config_struct->baro_p0 : "(null)");
 }
 
 int init_nvs() {
@@ -203,6 +230,10 @@ esp_err_t load_settings_from_nvs(nmda_init_config_t* nmda_config) {
     LOAD_AND_SET("wifi_ssid", wifi_essid);
     LOAD_AND_SET("wifi_password", wifi_password);
     LOAD_AND_SET("wifi_ntp_server", wifi_ntp_server);
+    LOAD_AND_SET("wifi_static_ip", wifi_static_ip);
+    LOAD_AND_SET("wifi_netmask", wifi_netmask);
+    LOAD_AND_SET("wifi_gateway", wifi_gateway);
+    LOAD_AND_SET("wifi_dns", wifi_dns);
 
     // Load MQTT settings
     LOAD_AND_SET("mqtt_host", mqtt_server);
@@ -213,6 +244,13 @@ esp_err_t load_settings_from_nvs(nmda_init_config_t* nmda_config) {
     LOAD_AND_SET("mqtt_station", mqtt_station);
     LOAD_AND_SET("mqtt_experiment", mqtt_experiment);
     LOAD_AND_SET("mqtt_device_id", mqtt_device_id);
+    LOAD_AND_SET("pburst_format", pburst_format);
+    LOAD_AND_SET("batch_compression", batch_compression);
+    LOAD_AND_SET("telemetry_format", telemetry_format);
+
+    // Load barometric correction settings (optional)
+    LOAD_AND_SET("baro_beta", baro_beta);
+    LOAD_AND_SET("baro_p0", baro_p0);
     
     #undef LOAD_AND_SET
     
@@ -1,4 +1,6 @@
 #include "sntp.h"
+#include "boot_timing.h"
+#include "timebase.h"
 
 void print_time(const time_t time, const char *message) {
   struct tm *timeinfo = localtime(&time);
@@ -15,6 +17,8 @@ void on_got_time(struct timeval *tv) {
     printf("------------------------------\n");
     printf("secs %lld\n", tv->tv_sec);
     print_time(tv->tv_sec, "time at callback");
+    boot_timing_mark(BOOT_PHASE_SNTP);
+    timebase_on_sync();
     xSemaphoreGive(sntp_semaphore);
     ESP_LOGI("SNTP", "sntp_semaphore unlocked");
     printf("------------------------------\n");
@@ -6,7 +6,11 @@
 #include "datastructures.h"
 #include "esp32-libs.h"
 #include "sdkconfig.h"
-#include <sys/time.h>
+#include "timebase.h"
+
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+#include "baro_correction.h"
+#endif
 
 /**
  * @brief Calculate QNH (pressure reduced to sea level) using AEMET formula
@@ -35,7 +39,6 @@ void spl06_monitor_task(void *parameters)
 
     float pressure_pa = 0.0f;
     float temperature_celsius = 0.0f;
-    struct timeval tv_now;
     
     // Get station altitude from configuration
     int station_altitude_m = CONFIG_SPL06_STATION_ALTITUDE_M;
@@ -44,15 +47,37 @@ void spl06_monitor_task(void *parameters)
     int publish_period_sec = CONFIG_SPL06_PUBLISH_PERIOD_SEC;
 
     TickType_t last_wake_time = xTaskGetTickCount();
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+    // Sample faster than the publish period so that every PCNT window gets its
+    // own pressure average; meteo is still published every publish_period_sec
+    const TickType_t period_ms = pdMS_TO_TICKS(CONFIG_BARO_SAMPLE_PERIOD_MS);
+    int samples_per_publish = (publish_period_sec * 1000) / CONFIG_BARO_SAMPLE_PERIOD_MS;
+    if (samples_per_publish < 1) {
+        samples_per_publish = 1;
+    }
+#else
     const TickType_t period_ms = (TickType_t)(publish_period_sec * 1000);
+    const int samples_per_publish = 1;
+#endif
+    int sample_index = 0;
 
     while (true) {
         esp_err_t ret = spl06_read_both(&pressure_pa, &temperature_celsius);
+
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+        if (ret == ESP_OK) {
+            baro_correction_add_sample(pressure_pa / 100.0f);
+        }
+#endif
+        if (ret == ESP_OK && ++sample_index < samples_per_publish) {
+            vTaskDelayUntil(&last_wake_time, period_ms);
+            continue;
+        }
+        sample_index = 0;
         
         if (ret == ESP_OK) {
             // Get timestamp
-            gettimeofday(&tv_now, NULL);
-            int64_t time_us = (int64_t)tv_now.tv_sec * 1000000L + (int64_t)tv_now.tv_usec;
+            int64_t time_us = timebase_now_us();
             message.timestamp = time_us;
 
             // Fill message payload
@@ -77,13 +102,11 @@ void spl06_monitor_task(void *parameters)
             ESP_LOGI("SPL06_MONITOR", "  Timestamp:    %lld us", time_us);
             ESP_LOGI("SPL06_MONITOR", "========================================");
 
-            // Send to telemetry queue
-            if (telemetry_queue == NULL) {
-                ESP_LOGE("SPL06_MONITOR", "Telemetry queue is NULL!");
-            } else if (xQueueSend(telemetry_queue, &message, 0) != pdTRUE) {
-                ESP_LOGW("SPL06_MONITOR", "Failed to send message to telemetry queue");
+            // Send to the meteo telemetry ring
+            if (!telemetry_ring_push(TELEMETRY_STREAM_METEO, &message)) {
+                ESP_LOGW("SPL06_MONITOR", "Failed to send message to meteo telemetry ring");
             } else {
-                ESP_LOGI("SPL06_MONITOR", "Message sent to telemetry queue");
+                ESP_LOGI("SPL06_MONITOR", "Message sent to meteo telemetry ring");
             }
         } else {
             ESP_LOGE("SPL06_MONITOR", "Failed to read SPL06: %s", esp_err_to_name(ret));
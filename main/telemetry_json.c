@@ -0,0 +1,153 @@
+#include "telemetry_json.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+#include "gle_detector.h"
+#endif
+
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+#include "baro_correction.h"
+#endif
+
+// Only present on messages stamped with the provisional RTC time
+static void write_time_flags(json_writer_t *w, const struct telemetry_message *message)
+{
+    if (message->time_flags & TM_TIME_PROVISIONAL) {
+        json_writer_string(w, "time_provisional", "1");
+    }
+}
+
+// "ch" followed by the channel number, as published in the channel fields
+static const char *channel_name(char *dst, unsigned channel)
+{
+    dst[0] = 'c';
+    dst[1] = 'h';
+    json_format_uint(dst + 2, channel);
+    return dst;
+}
+
+const char *telemetry_json_pulse_count(json_writer_t *w, const struct telemetry_message *message)
+{
+    json_writer_begin_object(w, NULL);
+    json_writer_string_int(w, "start_datetime", message->payload.tm_pcnt.start_timestamp);
+    json_writer_string_int(w, "datetime", message->timestamp);
+    write_time_flags(w, message);
+    json_writer_string_uint(w, "ch01", message->payload.tm_pcnt.channel[0]);
+    json_writer_string_uint(w, "ch02", message->payload.tm_pcnt.channel[1]);
+    json_writer_string_uint(w, "ch03", message->payload.tm_pcnt.channel[2]);
+    json_writer_string_uint(w, "Interval_s", message->payload.tm_pcnt.integration_time_sec);
+    json_writer_string_uint(w, "seq", message->payload.tm_pcnt.seq);
+#ifdef CONFIG_ENABLE_PCNT_GATE
+    json_writer_string_uint(w, "gated_ch01", message->payload.tm_pcnt.gated[0]);
+    json_writer_string_uint(w, "gated_ch02", message->payload.tm_pcnt.gated[1]);
+    json_writer_string_uint(w, "gated_ch03", message->payload.tm_pcnt.gated[2]);
+#endif
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+    // Contraste PCNT/RMT: pulsos vistos por RMT y diferencia con PCNT (pulsos perdidos por RMT)
+    json_writer_string_uint(w, "rmt_ch01", message->payload.tm_pcnt.rmt[0]);
+    json_writer_string_uint(w, "rmt_ch02", message->payload.tm_pcnt.rmt[1]);
+    json_writer_string_uint(w, "rmt_ch03", message->payload.tm_pcnt.rmt[2]);
+    json_writer_string_int(w, "lost_ch01",
+                           (int64_t)message->payload.tm_pcnt.channel[0] - (int64_t)message->payload.tm_pcnt.rmt[0]);
+    json_writer_string_int(w, "lost_ch02",
+                           (int64_t)message->payload.tm_pcnt.channel[1] - (int64_t)message->payload.tm_pcnt.rmt[1]);
+    json_writer_string_int(w, "lost_ch03",
+                           (int64_t)message->payload.tm_pcnt.channel[2] - (int64_t)message->payload.tm_pcnt.rmt[2]);
+#endif
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+    // Corrección barométrica con la presión media de la misma ventana
+    if (!isnan(message->payload.tm_pcnt.pressure_hpa)) {
+        static const char *corr_keys[3] = {"corr_ch01", "corr_ch02", "corr_ch03"};
+        json_writer_string_float(w, "pressure_hpa", message->payload.tm_pcnt.pressure_hpa, 2);
+        json_writer_string_float(w, "baro_beta", message->payload.tm_pcnt.baro_beta, 6);
+        json_writer_string_float(w, "baro_p0_hpa", message->payload.tm_pcnt.baro_p0_hpa, 2);
+        for (int i = 0; i < 3; i++) {
+            json_writer_string_float(w, corr_keys[i],
+                                     baro_correction_apply(message->payload.tm_pcnt.channel[i],
+                                                           message->payload.tm_pcnt.pressure_hpa,
+                                                           message->payload.tm_pcnt.baro_beta,
+                                                           message->payload.tm_pcnt.baro_p0_hpa), 2);
+        }
+    }
+#endif
+    json_writer_end_object(w);
+    return json_writer_finish(w);
+}
+
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+const char *telemetry_json_pburst(json_writer_t *w, const struct telemetry_message *message)
+{
+    char channel_str[8];
+
+    json_writer_begin_object(w, NULL);
+    json_writer_string_int(w, "start_datetime", message->payload.tm_rmt_pulse_event.start_timestamp);
+    write_time_flags(w, message);
+    json_writer_string(w, "channel", channel_name(channel_str, message->payload.tm_rmt_pulse_event.channel));
+    json_writer_int(w, "symbols", message->payload.tm_rmt_pulse_event.symbols);
+
+    // One object per pulse, numbers (not strings) as in the original pburst format
+    json_writer_begin_array(w, "pulses");
+    for (uint8_t i = 0; i < message->payload.tm_rmt_pulse_event.symbols; i++) {
+        json_writer_begin_object(w, NULL);
+        json_writer_int(w, "duration_us", message->payload.tm_rmt_pulse_event.pulses[i].duration_us);
+        json_writer_int(w, "separation_us", message->payload.tm_rmt_pulse_event.pulses[i].separation_us);
+        json_writer_end_object(w);
+    }
+    json_writer_end_array(w);
+
+    json_writer_end_object(w);
+    return json_writer_finish(w);
+}
+#endif
+
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+const char *telemetry_json_gle_alert(json_writer_t *w, const struct telemetry_message *message, int64_t publish_us)
+{
+    char stream_str[8];
+
+    json_writer_begin_object(w, NULL);
+    json_writer_string_int(w, "datetime", message->timestamp);
+    write_time_flags(w, message);
+    json_writer_string(w, "stream", message->payload.tm_alert.stream == GLE_STREAM_SUM ?
+                       "sum" : channel_name(stream_str, message->payload.tm_alert.stream));
+    json_writer_string(w, "event", message->payload.tm_alert.event == GLE_EVENT_ONSET ? "onset" : "end");
+    json_writer_string_uint(w, "counts", message->payload.tm_alert.counts);
+    json_writer_string_float(w, "expected", message->payload.tm_alert.expected, 2);
+    json_writer_string_float(w, "sigma", message->payload.tm_alert.sigma, 2);
+    json_writer_string_uint(w, "Interval_s", message->payload.tm_alert.integration_time_sec);
+    json_writer_string_int(w, "detect_us",
+                           message->payload.tm_alert.detect_us - message->payload.tm_alert.bin_end_us);
+    // Latencia hasta la publicación: desde el fin del bin de 1 s que disparó la
+    // alerta (último flanco posible) y desde su inicio (primer flanco posible)
+    json_writer_string_int(w, "latency_us", publish_us - message->payload.tm_alert.bin_end_us);
+    json_writer_string_int(w, "max_latency_us", publish_us - message->payload.tm_alert.bin_start_us);
+    json_writer_end_object(w);
+    return json_writer_finish(w);
+}
+#endif
+
+#ifdef CONFIG_ENABLE_BARO_FIT
+const char *telemetry_json_baro_fit(json_writer_t *w, const struct telemetry_message *message)
+{
+    static const char *beta_keys[BARO_FIT_STREAMS] = {"beta_sum", "beta_ch01", "beta_ch02", "beta_ch03"};
+    static const char *sigma_keys[BARO_FIT_STREAMS] = {"sigma_sum", "sigma_ch01", "sigma_ch02", "sigma_ch03"};
+
+    json_writer_begin_object(w, NULL);
+    json_writer_string_int(w, "datetime", message->timestamp);
+    write_time_flags(w, message);
+    for (int i = 0; i < BARO_FIT_STREAMS; i++) {
+        if (isnan(message->payload.tm_baro_fit.beta[i])) {
+            continue;  // Not enough windows with counts on this stream
+        }
+        json_writer_string_float(w, beta_keys[i], message->payload.tm_baro_fit.beta[i], 6);
+        json_writer_string_float(w, sigma_keys[i], message->payload.tm_baro_fit.sigma[i], 6);
+    }
+    json_writer_string_float(w, "n_eff", message->payload.tm_baro_fit.n_eff, 1);
+    json_writer_string_float(w, "pressure_sd_hpa", message->payload.tm_baro_fit.pressure_sd_hpa, 2);
+    json_writer_string_float(w, "beta_applied", message->payload.tm_baro_fit.beta_applied, 6);
+    json_writer_end_object(w);
+    return json_writer_finish(w);
+}
+#endif
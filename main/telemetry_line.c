@@ -0,0 +1,58 @@
+#include "telemetry_line.h"
+
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+
+#include <math.h>
+
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+#include "baro_correction.h"
+#endif
+
+size_t telemetry_line_pulse_count(line_writer_t *w, const struct telemetry_message *message)
+{
+    static const char *ch_keys[3] = {"ch01", "ch02", "ch03"};
+
+    line_writer_begin(w, "pcnt");
+    for (int i = 0; i < 3; i++) {
+        line_writer_int(w, ch_keys[i], message->payload.tm_pcnt.channel[i]);
+    }
+    line_writer_int(w, "start_datetime", message->payload.tm_pcnt.start_timestamp);
+    line_writer_int(w, "Interval_s", message->payload.tm_pcnt.integration_time_sec);
+    line_writer_int(w, "seq", message->payload.tm_pcnt.seq);
+    if (message->time_flags & TM_TIME_PROVISIONAL) {
+        line_writer_int(w, "time_provisional", 1);
+    }
+#ifdef CONFIG_ENABLE_PCNT_GATE
+    static const char *gated_keys[3] = {"gated_ch01", "gated_ch02", "gated_ch03"};
+    for (int i = 0; i < 3; i++) {
+        line_writer_int(w, gated_keys[i], message->payload.tm_pcnt.gated[i]);
+    }
+#endif
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+    static const char *rmt_keys[3] = {"rmt_ch01", "rmt_ch02", "rmt_ch03"};
+    static const char *lost_keys[3] = {"lost_ch01", "lost_ch02", "lost_ch03"};
+    for (int i = 0; i < 3; i++) {
+        line_writer_int(w, rmt_keys[i], message->payload.tm_pcnt.rmt[i]);
+        line_writer_int(w, lost_keys[i],
+                        (int64_t)message->payload.tm_pcnt.channel[i] - (int64_t)message->payload.tm_pcnt.rmt[i]);
+    }
+#endif
+#ifdef CONFIG_ENABLE_BARO_CORRECTION
+    if (!isnan(message->payload.tm_pcnt.pressure_hpa)) {
+        static const char *corr_keys[3] = {"corr_ch01", "corr_ch02", "corr_ch03"};
+        line_writer_float(w, "pressure_hpa", message->payload.tm_pcnt.pressure_hpa, 2);
+        line_writer_float(w, "baro_beta", message->payload.tm_pcnt.baro_beta, 6);
+        line_writer_float(w, "baro_p0_hpa", message->payload.tm_pcnt.baro_p0_hpa, 2);
+        for (int i = 0; i < 3; i++) {
+            line_writer_float(w, corr_keys[i],
+                              baro_correction_apply(message->payload.tm_pcnt.channel[i],
+                                                    message->payload.tm_pcnt.pressure_hpa,
+                                                    message->payload.tm_pcnt.baro_beta,
+                                                    message->payload.tm_pcnt.baro_p0_hpa), 2);
+        }
+    }
+#endif
+    return line_writer_end(w, message->timestamp);
+}
+
+#endif // CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
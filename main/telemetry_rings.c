@@ -0,0 +1,223 @@
+#include "telemetry_rings.h"
+
+#include <stdatomic.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "TELEMETRY_RINGS";
+
+// Streams whose producer is compiled out keep a single slot
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+#define RING_ALERT_SIZE CONFIG_TELEMETRY_RING_ALERT_SIZE
+#else
+#define RING_ALERT_SIZE 1
+#endif
+#if defined(CONFIG_ENABLE_CHANNEL_HEALTH) || defined(CONFIG_ENABLE_BARO_FIT)
+#define RING_HEALTH_SIZE CONFIG_TELEMETRY_RING_HEALTH_SIZE
+#else
+#define RING_HEALTH_SIZE 1
+#endif
+#ifdef CONFIG_ENABLE_SPL06
+#define RING_METEO_SIZE CONFIG_TELEMETRY_RING_METEO_SIZE
+#else
+#define RING_METEO_SIZE 1
+#endif
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+#define RING_PBURST_SIZE CONFIG_TELEMETRY_RING_PBURST_SIZE
+#else
+#define RING_PBURST_SIZE 1
+#endif
+#ifdef CONFIG_ENABLE_GPIO_PULSE_DETECTION
+#define RING_DETECT_SIZE CONFIG_TELEMETRY_RING_DETECT_SIZE
+#else
+#define RING_DETECT_SIZE 1
+#endif
+
+static struct telemetry_message s_slots_alert[RING_ALERT_SIZE];
+static struct telemetry_message s_slots_pcnt[CONFIG_TELEMETRY_RING_PCNT_SIZE];
+static struct telemetry_message s_slots_health[RING_HEALTH_SIZE];
+static struct telemetry_message s_slots_meteo[RING_METEO_SIZE];
+static struct telemetry_message s_slots_pburst[RING_PBURST_SIZE];
+static struct telemetry_message s_slots_detect[RING_DETECT_SIZE];
+
+typedef struct {
+    const char *name;
+    struct telemetry_message *slots;
+    uint32_t capacity;
+    uint8_t weight;           // Messages per round robin turn (0 = strict priority)
+    // head and tail are free-running counters: occupancy = tail - head
+    atomic_uint head;         // Written by the consumer only
+    atomic_uint tail;         // Written by the producer only
+    atomic_uint dropped;
+    atomic_uint high_water;
+} telemetry_ring_t;
+
+// Ordered by priority. Weights give pcnt most of the bandwidth when pburst is
+// flooding, while every stream still gets a turn in each round.
+static telemetry_ring_t s_rings[TELEMETRY_STREAM_COUNT] = {
+    [TELEMETRY_STREAM_ALERT]  = { "alert",  s_slots_alert,  RING_ALERT_SIZE,                 0 },
+    [TELEMETRY_STREAM_PCNT]   = { "pcnt",   s_slots_pcnt,   CONFIG_TELEMETRY_RING_PCNT_SIZE, 8 },
+    [TELEMETRY_STREAM_HEALTH] = { "health", s_slots_health, RING_HEALTH_SIZE,                4 },
+    [TELEMETRY_STREAM_METEO]  = { "meteo",  s_slots_meteo,  RING_METEO_SIZE,                 4 },
+    [TELEMETRY_STREAM_PBURST] = { "pburst", s_slots_pburst, RING_PBURST_SIZE,                2 },
+    [TELEMETRY_STREAM_DETECT] = { "detect", s_slots_detect, RING_DETECT_SIZE,                1 },
+};
+
+static TaskHandle_t s_consumer = NULL;
+
+// Weighted round robin state (consumer only)
+static int s_rr_stream = TELEMETRY_STREAM_PCNT;
+static uint32_t s_rr_credit = 0;
+
+void telemetry_rings_init(void)
+{
+    size_t total = 0;
+    for (int i = 0; i < TELEMETRY_STREAM_COUNT; i++) {
+        atomic_store(&s_rings[i].head, 0);
+        atomic_store(&s_rings[i].tail, 0);
+        atomic_store(&s_rings[i].dropped, 0);
+        atomic_store(&s_rings[i].high_water, 0);
+        total += s_rings[i].capacity;
+    }
+    s_rr_stream = TELEMETRY_STREAM_PCNT;
+    s_rr_credit = s_rings[TELEMETRY_STREAM_PCNT].weight;
+
+    ESP_LOGI(TAG, "Telemetry rings: %zu slots, %zu bytes per message, %zu bytes total",
+             total, sizeof(struct telemetry_message), total * sizeof(struct telemetry_message));
+}
+
+void telemetry_rings_set_consumer(TaskHandle_t consumer)
+{
+    s_consumer = consumer;
+}
+
+// Producer side, shared by task and ISR pushes
+static inline bool IRAM_ATTR ring_push(telemetry_ring_t *ring, const struct telemetry_message *message)
+{
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    unsigned used = tail - head;
+
+    if (used >= ring->capacity) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    memcpy(&ring->slots[tail % ring->capacity], message, sizeof(*message));
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+    if (used + 1 > atomic_load_explicit(&ring->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->high_water, used + 1, memory_order_relaxed);
+    }
+    return true;
+}
+
+bool telemetry_ring_push(telemetry_stream_t stream, const struct telemetry_message *message)
+{
+    if (stream < 0 || stream >= TELEMETRY_STREAM_COUNT) {
+        return false;
+    }
+    if (!ring_push(&s_rings[stream], message)) {
+        return false;
+    }
+    if (s_consumer != NULL) {
+        xTaskNotifyGive(s_consumer);
+    }
+    return true;
+}
+
+bool IRAM_ATTR telemetry_ring_push_from_isr(telemetry_stream_t stream, const struct telemetry_message *message,
+                                            BaseType_t *higher_priority_task_woken)
+{
+    if (stream < 0 || stream >= TELEMETRY_STREAM_COUNT) {
+        return false;
+    }
+    if (!ring_push(&s_rings[stream], message)) {
+        return false;
+    }
+    if (s_consumer != NULL) {
+        vTaskNotifyGiveFromISR(s_consumer, higher_priority_task_woken);
+    }
+    return true;
+}
+
+// Consumer side
+static bool ring_pop(telemetry_ring_t *ring, struct telemetry_message *message)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head == tail) {
+        return false;
+    }
+
+    memcpy(message, &ring->slots[head % ring->capacity], sizeof(*message));
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+static bool rings_pop_next(struct telemetry_message *message)
+{
+    // Strict-priority streams first
+    for (int i = 0; i < TELEMETRY_STREAM_COUNT; i++) {
+        if (s_rings[i].weight == 0 && ring_pop(&s_rings[i], message)) {
+            return true;
+        }
+    }
+
+    // Weighted round robin over the others: a stream keeps the turn until it has
+    // used its credit or runs empty, then the next one gets a fresh credit
+    for (int visited = 0; visited <= TELEMETRY_STREAM_COUNT; visited++) {
+        telemetry_ring_t *ring = &s_rings[s_rr_stream];
+        if (s_rr_credit > 0 && ring_pop(ring, message)) {
+            s_rr_credit--;
+            return true;
+        }
+        do {
+            s_rr_stream = (s_rr_stream + 1) % TELEMETRY_STREAM_COUNT;
+        } while (s_rings[s_rr_stream].weight == 0);
+        s_rr_credit = s_rings[s_rr_stream].weight;
+    }
+    return false;
+}
+
+bool telemetry_rings_receive(struct telemetry_message *message, TickType_t timeout)
+{
+    TimeOut_t time_out;
+    vTaskSetTimeOutState(&time_out);
+
+    while (true) {
+        if (rings_pop_next(message)) {
+            return true;
+        }
+        // Each push gives one notification; taking them all and re-scanning the
+        // rings means no message can be missed between the scan and the wait
+        if (xTaskCheckForTimeOut(&time_out, &timeout) == pdTRUE) {
+            return false;
+        }
+        ulTaskNotifyTake(pdTRUE, timeout);
+    }
+}
+
+void telemetry_ring_get_stats(telemetry_stream_t stream, telemetry_ring_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (stream < 0 || stream >= TELEMETRY_STREAM_COUNT) {
+        return;
+    }
+    telemetry_ring_t *ring = &s_rings[stream];
+    stats->pushed = atomic_load(&ring->tail);
+    stats->dropped = atomic_load(&ring->dropped);
+    stats->high_water = atomic_load(&ring->high_water);
+    stats->capacity = ring->capacity;
+}
+
+const char *telemetry_stream_name(telemetry_stream_t stream)
+{
+    if (stream < 0 || stream >= TELEMETRY_STREAM_COUNT) {
+        return "unknown";
+    }
+    return s_rings[stream].name;
+}
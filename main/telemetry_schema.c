@@ -0,0 +1,320 @@
+#include "telemetry_schema.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "telemetry_json.h"
+#include "telemetry_line.h"
+
+#ifdef CONFIG_ENABLE_CHANNEL_HEALTH
+#include "channel_health.h"
+#endif
+
+static const char *TAG = "TM_SCHEMA";
+
+// Storage type of each C type allowed in a TM_SCHEMA_* line
+#define TM_FIELD_TYPE_uint8_t  TM_FIELD_U8
+#define TM_FIELD_TYPE_uint32_t TM_FIELD_U32
+#define TM_FIELD_TYPE_int64_t  TM_FIELD_I64
+#define TM_FIELD_TYPE_float    TM_FIELD_F32
+
+#define TM_FIELD(group, ctype, member, key, style, decimals) \
+    { key, offsetof(struct telemetry_message, payload.group.member), TM_FIELD_TYPE_##ctype, \
+      sizeof(((struct telemetry_message *)0)->payload.group.member) / sizeof(ctype), style, decimals },
+
+#define DETECT_FIELD(ctype, member, dims, key, style, decimals) TM_FIELD(tm_detect, ctype, member, key, style, decimals)
+#define SYNC_FIELD(ctype, member, dims, key, style, decimals)   TM_FIELD(tm_sync, ctype, member, key, style, decimals)
+#define SPL06_FIELD(ctype, member, dims, key, style, decimals)  TM_FIELD(tm_spl06, ctype, member, key, style, decimals)
+#define HEALTH_FIELD(ctype, member, dims, key, style, decimals) TM_FIELD(tm_health, ctype, member, key, style, decimals)
+
+static const tm_field_t s_sync_fields[] = { TM_SCHEMA_SYNC(SYNC_FIELD) };
+#ifdef CONFIG_ENABLE_GPIO_PULSE_DETECTION
+static const tm_field_t s_detect_fields[] = { TM_SCHEMA_DETECT(DETECT_FIELD) };
+#endif
+#ifdef CONFIG_ENABLE_SPL06
+static const tm_field_t s_spl06_fields[] = { TM_SCHEMA_SPL06(SPL06_FIELD) };
+#endif
+#ifdef CONFIG_ENABLE_CHANNEL_HEALTH
+static const tm_field_t s_health_fields[] = { TM_SCHEMA_HEALTH(HEALTH_FIELD) };
+#endif
+
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+// The latency fields are measured at serialization time
+static const char *gle_alert_json(json_writer_t *w, const struct telemetry_message *message)
+{
+    return telemetry_json_gle_alert(w, message, esp_timer_get_time());
+}
+#endif
+
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+#define LINE(fn) , fn
+#else
+#define LINE(fn)
+#endif
+
+#define SCHEMA(type, service, fields) \
+    { type, service, fields, sizeof(fields) / sizeof(fields[0]), telemetry_schema_json LINE(telemetry_schema_line) }
+
+const telemetry_schema_t telemetry_schemas[] = {
+    { TM_PULSE_COUNT, "pcnt", NULL, 0, telemetry_json_pulse_count LINE(telemetry_line_pulse_count) },
+#ifdef CONFIG_ENABLE_GPIO_PULSE_DETECTION
+    SCHEMA(TM_PULSE_DETECTION, "detect", s_detect_fields),
+#endif
+#ifdef CONFIG_ENABLE_RMT_PULSE_DETECTION
+    { TM_RMT_PULSE_EVENT, "pburst", NULL, 0, telemetry_json_pburst LINE(NULL) },
+#endif
+    SCHEMA(TM_TIME_SYNCHRONIZER, "timesync", s_sync_fields),
+#ifdef CONFIG_ENABLE_SPL06
+    SCHEMA(TM_SPL06, "meteo", s_spl06_fields),
+#endif
+#ifdef CONFIG_ENABLE_CHANNEL_HEALTH
+    SCHEMA(TM_CHANNEL_HEALTH, "health", s_health_fields),
+#endif
+#ifdef CONFIG_ENABLE_GLE_DETECTOR
+    { TM_GLE_ALERT, "alert", NULL, 0, gle_alert_json LINE(NULL) },
+#endif
+#ifdef CONFIG_ENABLE_BARO_FIT
+    { TM_BARO_FIT, "baro", NULL, 0, telemetry_json_baro_fit LINE(NULL) },
+#endif
+};
+
+const size_t telemetry_schema_count = sizeof(telemetry_schemas) / sizeof(telemetry_schemas[0]);
+
+_Static_assert(sizeof(telemetry_schemas) / sizeof(telemetry_schemas[0]) <= TELEMETRY_SCHEMA_MAX,
+               "TELEMETRY_SCHEMA_MAX is too small");
+
+const telemetry_schema_t *telemetry_schema_find(uint8_t type)
+{
+    for (size_t i = 0; i < telemetry_schema_count; i++) {
+        if (telemetry_schemas[i].type == type) {
+            return &telemetry_schemas[i];
+        }
+    }
+    return NULL;
+}
+
+// Element i of a field, widened
+static uint64_t field_uint(const struct telemetry_message *message, const tm_field_t *f, unsigned i)
+{
+    const uint8_t *p = (const uint8_t *)message + f->offset;
+    switch (f->type) {
+    case TM_FIELD_U8:
+        return p[i];
+    case TM_FIELD_U32:
+        return ((const uint32_t *)p)[i];
+    default:
+        return (uint64_t)((const int64_t *)p)[i];
+    }
+}
+
+static float field_float(const struct telemetry_message *message, const tm_field_t *f, unsigned i)
+{
+    return ((const float *)((const uint8_t *)message + f->offset))[i];
+}
+
+// "ch" followed by the channel number, as published in the channel fields
+static const char *channel_name(char *dst, unsigned channel)
+{
+    dst[0] = 'c';
+    dst[1] = 'h';
+    json_format_uint(dst + 2, channel);
+    return dst;
+}
+
+static void write_field(json_writer_t *w, const struct telemetry_message *message, const tm_field_t *f,
+                        const char *key, unsigned i)
+{
+    char value_str[8];
+
+    switch (f->style) {
+    case TM_JSON_FLOAT:
+        json_writer_string_float(w, key, field_float(message, f, i), f->decimals);
+        break;
+    case TM_JSON_CHANNEL:
+        json_writer_string(w, key, channel_name(value_str, (unsigned)field_uint(message, f, i)));
+        break;
+    case TM_JSON_FLAG:
+        json_writer_string(w, key, field_uint(message, f, i) ? "1" : "0");
+        break;
+#ifdef CONFIG_ENABLE_CHANNEL_HEALTH
+    case TM_JSON_HEALTH_STATE:
+        json_writer_string(w, key, channel_health_state_name((channel_health_state_t)field_uint(message, f, i)));
+        break;
+#endif
+    default:
+        if (f->type == TM_FIELD_I64) {
+            json_writer_string_int(w, key, (int64_t)field_uint(message, f, i));
+        } else {
+            json_writer_string_uint(w, key, field_uint(message, f, i));
+        }
+        break;
+    }
+}
+
+// Key of element i of an array field: the table key followed by "ch01", "ch02"...
+static const char *array_key(char *key, size_t size, const char *prefix_key, unsigned i)
+{
+    size_t prefix = strlen(prefix_key);
+    if (prefix > size - 5) {
+        prefix = size - 5;
+    }
+    memcpy(key, prefix_key, prefix);
+    key[prefix] = 'c';
+    key[prefix + 1] = 'h';
+    key[prefix + 2] = (char)('0' + (i + 1) / 10);
+    key[prefix + 3] = (char)('0' + (i + 1) % 10);
+    key[prefix + 4] = '\0';
+    return key;
+}
+
+const char *telemetry_schema_json(json_writer_t *w, const struct telemetry_message *message)
+{
+    const telemetry_schema_t *schema = telemetry_schema_find(message->tm_message_type);
+    if (schema == NULL || schema->fields == NULL) {
+        return NULL;
+    }
+
+    json_writer_begin_object(w, NULL);
+    json_writer_string_int(w, "datetime", message->timestamp);
+    if (message->time_flags & TM_TIME_PROVISIONAL) {
+        json_writer_string(w, "time_provisional", "1");
+    }
+    for (uint8_t n = 0; n < schema->field_count; n++) {
+        const tm_field_t *f = &schema->fields[n];
+        if (f->count == 1) {
+            write_field(w, message, f, f->key, 0);
+            continue;
+        }
+        // One member per array element
+        for (unsigned i = 0; i < f->count; i++) {
+            char key[32];
+            write_field(w, message, f, array_key(key, sizeof(key), f->key, i), i);
+        }
+    }
+    json_writer_end_object(w);
+    return json_writer_finish(w);
+}
+
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+static void line_field(line_writer_t *w, const struct telemetry_message *message, const tm_field_t *f,
+                       const char *key, unsigned i)
+{
+    switch (f->style) {
+    case TM_JSON_FLOAT:
+        line_writer_float(w, key, field_float(message, f, i), f->decimals);
+        break;
+#ifdef CONFIG_ENABLE_CHANNEL_HEALTH
+    case TM_JSON_HEALTH_STATE:
+        line_writer_string(w, key, channel_health_state_name((channel_health_state_t)field_uint(message, f, i)));
+        break;
+#endif
+    default:
+        // Integers and flags; all widened values fit an int64 field
+        line_writer_int(w, key, (int64_t)field_uint(message, f, i));
+        break;
+    }
+}
+
+size_t telemetry_schema_line(line_writer_t *w, const struct telemetry_message *message)
+{
+    const telemetry_schema_t *schema = telemetry_schema_find(message->tm_message_type);
+    char value_str[8];
+    char key[32];
+
+    if (schema == NULL || schema->fields == NULL) {
+        return 0;
+    }
+
+    line_writer_begin(w, schema->service);
+    // Tags go before the first field
+    for (uint8_t n = 0; n < schema->field_count; n++) {
+        const tm_field_t *f = &schema->fields[n];
+        if (f->style == TM_JSON_CHANNEL && f->count == 1) {
+            line_writer_tag(w, f->key, channel_name(value_str, (unsigned)field_uint(message, f, 0)));
+        }
+    }
+    for (uint8_t n = 0; n < schema->field_count; n++) {
+        const tm_field_t *f = &schema->fields[n];
+        if (f->style == TM_JSON_CHANNEL && f->count == 1) {
+            continue;
+        }
+        for (unsigned i = 0; i < f->count; i++) {
+            line_field(w, message, f, f->count == 1 ? f->key : array_key(key, sizeof(key), f->key, i), i);
+        }
+    }
+    if (message->time_flags & TM_TIME_PROVISIONAL) {
+        line_writer_int(w, "time_provisional", 1);
+    }
+    return line_writer_end(w, message->timestamp);
+}
+#endif
+
+// Fill every field of a flat message with a value derived from seed
+static void fill_message(struct telemetry_message *message, const telemetry_schema_t *schema, uint32_t seed)
+{
+    memset(message, 0, sizeof(*message));
+    message->tm_message_type = schema->type;
+    message->timestamp = 1718000000000000LL + seed;
+    for (uint8_t n = 0; n < schema->field_count; n++) {
+        const tm_field_t *f = &schema->fields[n];
+        uint8_t *p = (uint8_t *)message + f->offset;
+        for (unsigned i = 0; i < f->count; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            switch (f->type) {
+            case TM_FIELD_U8:
+                p[i] = (uint8_t)(seed >> 24);
+                break;
+            case TM_FIELD_U32:
+                ((uint32_t *)p)[i] = seed;
+                break;
+            case TM_FIELD_I64:
+                ((int64_t *)p)[i] = -(int64_t)seed * 4096;
+                break;
+            default:
+                ((float *)p)[i] = (float)(seed >> 8) / 1000.0f;
+                break;
+            }
+        }
+    }
+}
+
+esp_err_t telemetry_schema_self_test(void)
+{
+    static struct telemetry_message message;
+    static char json_buf[512];
+    bool ok = true;
+
+    for (size_t s = 0; s < telemetry_schema_count; s++) {
+        const telemetry_schema_t *schema = &telemetry_schemas[s];
+        if (schema->fields == NULL) {
+            continue;
+        }
+        for (uint32_t seed = 1; seed <= 4; seed++) {
+            fill_message(&message, schema, seed);
+
+            json_writer_t w;
+            json_writer_init(&w, json_buf, sizeof(json_buf));
+            if (schema->json(&w, &message) == NULL) {
+                ESP_LOGE(TAG, "%s: JSON encoding failed", schema->service);
+                ok = false;
+                break;
+            }
+#ifdef CONFIG_ENABLE_INFLUX_LINE_PROTOCOL
+            line_writer_t lw;
+            line_writer_init(&lw, json_buf, sizeof(json_buf), ",device=test");
+            if (schema->line != NULL && schema->line(&lw, &message) == 0) {
+                ESP_LOGE(TAG, "%s: line protocol encoding failed", schema->service);
+                ok = false;
+                break;
+            }
+#endif
+        }
+    }
+
+    if (ok) {
+        ESP_LOGI(TAG, "Telemetry schema self-test passed (%u types)", (unsigned)telemetry_schema_count);
+        return ESP_OK;
+    }
+    return ESP_FAIL;
+}
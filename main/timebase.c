@@ -0,0 +1,225 @@
+#include "timebase.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#ifdef CONFIG_ENABLE_RTC_WALL_CLOCK
+#include "esp_attr.h"
+#include "esp_rom_crc.h"
+#include "esp_rtc_time.h"
+#include "esp_system.h"
+
+#define RTC_CLOCK_MAGIC 0x4E4D434B  // "NMCK"
+#define RTC_CLOCK_MAX_CONFIDENCE 1000
+
+// Last SNTP-disciplined time, kept in RTC memory. The RTC timer keeps counting
+// across software resets, panics and watchdog resets, so Unix time after such a
+// reset is esp_rtc_get_time_us() + offset_us, within the RTC drift since sync_rtc_us.
+typedef struct {
+    uint32_t magic;
+    uint32_t confidence;    // Consecutive syncs at which the RTC clock was within its error bound
+    int64_t offset_us;      // Unix time minus RTC time at the last sync
+    uint64_t sync_rtc_us;   // RTC time of the last sync
+    uint32_t crc;           // CRC32 of the fields above
+} rtc_clock_t;
+
+static RTC_NOINIT_ATTR rtc_clock_t s_rtc_clock;
+#endif
+
+static const char *TAG = "TIMEBASE";
+
+// Unix time minus esp_timer time: at the first synchronization (s_offset_us) and
+// as restored from the RTC clock (s_provisional_offset_us). Written before
+// s_state changes; readers load s_state first.
+static int64_t s_offset_us;
+static int64_t s_provisional_offset_us;
+static _Atomic int s_state = TIMEBASE_NONE;
+static timebase_stats_t s_stats;
+
+static int64_t unix_now_us(void)
+{
+    struct timeval tv_now;
+    gettimeofday(&tv_now, NULL);
+    return (int64_t)tv_now.tv_sec * 1000000LL + (int64_t)tv_now.tv_usec;
+}
+
+#ifdef CONFIG_ENABLE_RTC_WALL_CLOCK
+static uint32_t rtc_clock_crc(void)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&s_rtc_clock, offsetof(rtc_clock_t, crc));
+}
+
+static bool rtc_clock_valid(void)
+{
+    return s_rtc_clock.magic == RTC_CLOCK_MAGIC && s_rtc_clock.crc == rtc_clock_crc();
+}
+
+// Worst-case RTC error after elapsed_us without synchronization
+static uint32_t rtc_clock_error_us(uint64_t elapsed_us)
+{
+    return (uint32_t)(elapsed_us / 1000000ULL * CONFIG_TIMEBASE_RTC_DRIFT_PPM) + 1000;
+}
+
+// Compare the RTC prediction with the new SNTP time, then re-anchor
+static void rtc_clock_discipline(int64_t unix_us)
+{
+    uint64_t rtc_us = esp_rtc_get_time_us();
+    uint32_t confidence = 0;
+
+    if (rtc_clock_valid() && rtc_us >= s_rtc_clock.sync_rtc_us) {
+        int64_t error_us = unix_us - ((int64_t)rtc_us + s_rtc_clock.offset_us);
+        uint32_t bound_us = rtc_clock_error_us(rtc_us - s_rtc_clock.sync_rtc_us);
+        if (error_us <= (int64_t)bound_us && error_us >= -(int64_t)bound_us) {
+            confidence = s_rtc_clock.confidence < RTC_CLOCK_MAX_CONFIDENCE ? s_rtc_clock.confidence + 1
+                                                                           : RTC_CLOCK_MAX_CONFIDENCE;
+        } else {
+            ESP_LOGW(TAG, "RTC clock off by %lld ms (bound %lu ms)", (long long)(error_us / 1000),
+                     (unsigned long)(bound_us / 1000));
+        }
+    }
+    s_rtc_clock.magic = RTC_CLOCK_MAGIC;
+    s_rtc_clock.confidence = confidence;
+    s_rtc_clock.offset_us = unix_us - (int64_t)rtc_us;
+    s_rtc_clock.sync_rtc_us = rtc_us;
+    s_rtc_clock.crc = rtc_clock_crc();
+    s_stats.confidence = confidence;
+}
+#endif
+
+void timebase_init(void)
+{
+#ifdef CONFIG_ENABLE_RTC_WALL_CLOCK
+    esp_reset_reason_t reason = esp_reset_reason();
+    uint64_t rtc_us = esp_rtc_get_time_us();
+
+    // Power-on and brown-out restart the RTC timer: nothing to carry over
+    if (reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT || !rtc_clock_valid() ||
+        rtc_us < s_rtc_clock.sync_rtc_us) {
+        ESP_LOGI(TAG, "No RTC wall clock to restore (reset reason %d)", (int)reason);
+        s_rtc_clock.magic = 0;
+        return;
+    }
+
+    uint32_t error_us = rtc_clock_error_us(rtc_us - s_rtc_clock.sync_rtc_us);
+    s_stats.confidence = s_rtc_clock.confidence;
+    if (error_us > (uint32_t)CONFIG_TIMEBASE_PROVISIONAL_MAX_ERROR_MS * 1000U) {
+        ESP_LOGW(TAG, "RTC wall clock too old (error up to %lu ms), waiting for SNTP",
+                 (unsigned long)(error_us / 1000));
+        return;
+    }
+
+    int64_t unix_us = (int64_t)rtc_us + s_rtc_clock.offset_us;
+    s_provisional_offset_us = unix_us - esp_timer_get_time();
+    s_stats.provisional_error_ms = error_us / 1000;
+    atomic_store(&s_state, TIMEBASE_PROVISIONAL);
+
+    // Logs and TLS certificate checks also see the restored time
+    struct timeval tv = {
+        .tv_sec = (time_t)(unix_us / 1000000LL),
+        .tv_usec = (suseconds_t)(unix_us % 1000000LL),
+    };
+    settimeofday(&tv, NULL);
+    ESP_LOGI(TAG, "Provisional time from RTC: %lld s, error up to %lu ms, confidence %lu",
+             (long long)tv.tv_sec, (unsigned long)(error_us / 1000), (unsigned long)s_rtc_clock.confidence);
+#endif
+}
+
+void timebase_on_sync(void)
+{
+    int64_t unix_us = unix_now_us();
+    int64_t boot_us = esp_timer_get_time();
+
+#ifdef CONFIG_ENABLE_RTC_WALL_CLOCK
+    rtc_clock_discipline(unix_us);
+#endif
+    int state = atomic_load(&s_state);
+    if (state == TIMEBASE_SYNCED) {
+        return;
+    }
+    s_offset_us = unix_us - boot_us;
+    if (state == TIMEBASE_PROVISIONAL) {
+        // What the provisional time was wrong by; early messages still held are
+        // converted with the new offset
+        s_stats.correction_ms = (int32_t)((s_offset_us - s_provisional_offset_us) / 1000);
+        ESP_LOGI(TAG, "Provisional time corrected by %ld ms", (long)s_stats.correction_ms);
+    }
+    atomic_store(&s_state, TIMEBASE_SYNCED);
+    ESP_LOGI(TAG, "Time synchronized %lld ms after boot, early timestamps will be backfilled",
+             (long long)(boot_us / 1000));
+}
+
+timebase_state_t timebase_state(void)
+{
+    return (timebase_state_t)atomic_load(&s_state);
+}
+
+bool timebase_is_synced(void)
+{
+    return atomic_load(&s_state) == TIMEBASE_SYNCED;
+}
+
+int64_t timebase_now_us(void)
+{
+    return atomic_load(&s_state) == TIMEBASE_SYNCED ? unix_now_us() : esp_timer_get_time();
+}
+
+int64_t timebase_wall_now_us(void)
+{
+    switch (atomic_load(&s_state)) {
+    case TIMEBASE_SYNCED:
+        return unix_now_us();
+    case TIMEBASE_PROVISIONAL:
+        return esp_timer_get_time() + s_provisional_offset_us;
+    default:
+        return esp_timer_get_time();
+    }
+}
+
+int64_t timebase_from_boot_us(int64_t boot_us)
+{
+    if (atomic_load(&s_state) != TIMEBASE_SYNCED) {
+        return boot_us;
+    }
+    // Against the current wall clock, so SNTP corrections after the first sync apply
+    return unix_now_us() - (esp_timer_get_time() - boot_us);
+}
+
+// Offset for the current state, 0 while the time is unknown
+static int64_t current_offset_us(void)
+{
+    switch (atomic_load(&s_state)) {
+    case TIMEBASE_SYNCED:
+        return s_offset_us;
+    case TIMEBASE_PROVISIONAL:
+        return s_provisional_offset_us;
+    default:
+        return 0;
+    }
+}
+
+int64_t timebase_to_unix_us(int64_t timestamp_us)
+{
+    return timebase_is_unix(timestamp_us) ? timestamp_us : timestamp_us + current_offset_us();
+}
+
+int64_t timebase_elapsed_us(int64_t a_us, int64_t b_us)
+{
+    // One load: both ends are converted with the same offset
+    int64_t offset_us = current_offset_us();
+    if (!timebase_is_unix(a_us)) {
+        a_us += offset_us;
+    }
+    if (!timebase_is_unix(b_us)) {
+        b_us += offset_us;
+    }
+    return b_us - a_us;
+}
+
+void timebase_get_stats(timebase_stats_t *stats)
+{
+    *stats = s_stats;
+    stats->state = timebase_state();
+}
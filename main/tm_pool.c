@@ -0,0 +1,171 @@
+#include "tm_pool.h"
+
+#include <stdbool.h>
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+// Class 0: cJSON nodes and short strings, small RMT groups
+// Class 1: JSON documents of the low-rate topics, medium RMT groups
+// Class 2: one full RMT group (16-byte header + 64 pulses of 16 bytes)
+// Class 3: pburst JSON documents
+#define TM_POOL_CLASS0_SIZE 64
+#define TM_POOL_CLASS1_SIZE 256
+#define TM_POOL_CLASS2_SIZE 1040
+#define TM_POOL_CLASS3_SIZE 4096
+
+static uint8_t s_arena0[CONFIG_TM_POOL_CLASS0_BLOCKS][TM_POOL_CLASS0_SIZE] __attribute__((aligned(8)));
+static uint8_t s_arena1[CONFIG_TM_POOL_CLASS1_BLOCKS][TM_POOL_CLASS1_SIZE] __attribute__((aligned(8)));
+static uint8_t s_arena2[CONFIG_TM_POOL_CLASS2_BLOCKS][TM_POOL_CLASS2_SIZE] __attribute__((aligned(8)));
+static uint8_t s_arena3[CONFIG_TM_POOL_CLASS3_BLOCKS][TM_POOL_CLASS3_SIZE] __attribute__((aligned(8)));
+
+// A free block stores the pointer to the next free block in its first bytes
+typedef struct free_block {
+    struct free_block *next;
+} free_block_t;
+
+typedef struct {
+    uint8_t *arena;
+    uint8_t *arena_end;
+    free_block_t *free_list;  // NULL until first use (lazy carve, no init call needed)
+    uint32_t carved;          // Blocks taken from the arena so far
+    tm_pool_class_stats_t stats;
+} tm_pool_class_t;
+
+static tm_pool_class_t s_classes[TM_POOL_CLASSES] = {
+    { &s_arena0[0][0], &s_arena0[0][0] + sizeof(s_arena0), NULL, 0,
+      { TM_POOL_CLASS0_SIZE, CONFIG_TM_POOL_CLASS0_BLOCKS } },
+    { &s_arena1[0][0], &s_arena1[0][0] + sizeof(s_arena1), NULL, 0,
+      { TM_POOL_CLASS1_SIZE, CONFIG_TM_POOL_CLASS1_BLOCKS } },
+    { &s_arena2[0][0], &s_arena2[0][0] + sizeof(s_arena2), NULL, 0,
+      { TM_POOL_CLASS2_SIZE, CONFIG_TM_POOL_CLASS2_BLOCKS } },
+    { &s_arena3[0][0], &s_arena3[0][0] + sizeof(s_arena3), NULL, 0,
+      { TM_POOL_CLASS3_SIZE, CONFIG_TM_POOL_CLASS3_BLOCKS } },
+};
+
+static tm_pool_stats_t s_stats = { 0 };
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Take a block from one class; caller holds s_lock
+static inline void * IRAM_ATTR class_take(tm_pool_class_t *c)
+{
+    free_block_t *block = c->free_list;
+    if (block != NULL) {
+        c->free_list = block->next;
+    } else if (c->carved < c->stats.blocks) {
+        // Never-used block: carve it from the arena instead of building the list at boot
+        block = (free_block_t *)(c->arena + (size_t)c->carved * c->stats.block_size);
+        c->carved++;
+    } else {
+        c->stats.exhausted++;
+        return NULL;
+    }
+
+    c->stats.in_use++;
+    c->stats.allocs++;
+    if (c->stats.in_use > c->stats.high_water) {
+        c->stats.high_water = c->stats.in_use;
+    }
+    return block;
+}
+
+// Smallest class that fits, and only that one: a burst of small requests must
+// not drain the large blocks the pburst documents need
+static void * IRAM_ATTR pool_take(size_t size)
+{
+    void *ptr = NULL;
+
+    portENTER_CRITICAL_SAFE(&s_lock);
+    for (int i = 0; i < TM_POOL_CLASSES; i++) {
+        if (size <= s_classes[i].stats.block_size) {
+            ptr = class_take(&s_classes[i]);
+            break;
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&s_lock);
+
+    return ptr;
+}
+
+void *tm_pool_alloc(size_t size)
+{
+    if (size == 0) {
+        return NULL;
+    }
+
+    void *ptr = pool_take(size);
+    if (ptr != NULL) {
+        return ptr;
+    }
+
+    ptr = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+
+    portENTER_CRITICAL(&s_lock);
+    if (ptr != NULL) {
+        s_stats.heap_fallback++;
+    } else {
+        s_stats.failed++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    return ptr;
+}
+
+void * IRAM_ATTR tm_pool_alloc_from_isr(size_t size)
+{
+    if (size == 0) {
+        return NULL;
+    }
+
+    void *ptr = pool_take(size);
+    if (ptr == NULL) {
+        portENTER_CRITICAL_SAFE(&s_lock);
+        s_stats.failed++;
+        portEXIT_CRITICAL_SAFE(&s_lock);
+    }
+    return ptr;
+}
+
+void IRAM_ATTR tm_pool_free(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    uint8_t *p = (uint8_t *)ptr;
+    for (int i = 0; i < TM_POOL_CLASSES; i++) {
+        tm_pool_class_t *c = &s_classes[i];
+        if (p >= c->arena && p < c->arena_end) {
+            free_block_t *block = (free_block_t *)ptr;
+            portENTER_CRITICAL_SAFE(&s_lock);
+            block->next = c->free_list;
+            c->free_list = block;
+            c->stats.in_use--;
+            portEXIT_CRITICAL_SAFE(&s_lock);
+            return;
+        }
+    }
+
+    // Heap fallback block (task context only)
+    heap_caps_free(ptr);
+}
+
+void tm_pool_get_class_stats(int class_index, tm_pool_class_stats_t *stats)
+{
+    if (class_index < 0 || class_index >= TM_POOL_CLASSES) {
+        *stats = (tm_pool_class_stats_t){ 0 };
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_classes[class_index].stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void tm_pool_get_stats(tm_pool_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
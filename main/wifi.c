@@ -1,7 +1,184 @@
 #include "wifi.h"
 #include "settings.h"
+#include "boot_timing.h"
+#include "esp_timer.h"
+#include "esp_mac.h"
+
+#ifdef CONFIG_ENABLE_WIFI_FAST_CONNECT
+#include <stddef.h>
+#include "esp_attr.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+
+#define WIFI_AP_CACHE_MAGIC 0x4E4D4150  // "NMAP"
+#define WIFI_AP_CACHE_NAMESPACE "wifi_cache"
+#define WIFI_AP_CACHE_KEY "ap"
+
+// Last access point that gave us an IP. The RTC copy survives warm resets;
+// the NVS copy (default "nvs" partition) covers power cycles.
+typedef struct {
+	uint32_t magic;
+	uint32_t ssid_crc;      // The cache is only used for the configured SSID
+	uint8_t bssid[6];
+	uint8_t channel;
+	uint8_t reserved;
+	uint32_t crc;           // CRC32 of the fields above
+} wifi_ap_cache_t;
+
+static RTC_NOINIT_ATTR wifi_ap_cache_t s_rtc_ap_cache;
+static wifi_ap_cache_t s_ap_cache;
+static bool s_fast_attempt = false;     // First association aimed at the cached AP
+static bool s_ap_hint = false;          // s_wifi_config still pinned to the cached BSSID and channel
+#endif
+
+static wifi_config_t s_wifi_config;
+static wifi_fast_connect_t s_fast_connect = WIFI_FAST_CONNECT_NONE;
+static bool s_static_ip = false;
+
+// Link state, written by the event loop task and the reconnect timer
+static volatile bool s_connected = false;
+static esp_timer_handle_t s_reconnect_timer = NULL;
+static uint32_t s_attempt = 0;          // Failed attempts since the link was lost
+static int64_t s_offline_since_us = 0;  // 0 while connected
+static wifi_link_stats_t s_stats;
+
+#ifdef CONFIG_ENABLE_WIFI_FAST_CONNECT
+static uint32_t ap_cache_crc(const wifi_ap_cache_t* cache) {
+	return esp_rom_crc32_le(0, (const uint8_t*)cache, offsetof(wifi_ap_cache_t, crc));
+}
+
+static bool ap_cache_valid(const wifi_ap_cache_t* cache, uint32_t ssid_crc) {
+	return cache->magic == WIFI_AP_CACHE_MAGIC && cache->crc == ap_cache_crc(cache) &&
+		cache->ssid_crc == ssid_crc && cache->channel >= 1 && cache->channel <= 14;
+}
+
+// RTC first (no flash access), then NVS
+static bool ap_cache_load(uint32_t ssid_crc) {
+	if (ap_cache_valid(&s_rtc_ap_cache, ssid_crc)) {
+		s_ap_cache = s_rtc_ap_cache;
+		return true;
+	}
+	nvs_handle_t handle;
+	if (nvs_open(WIFI_AP_CACHE_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+		return false;
+	}
+	size_t size = sizeof(s_ap_cache);
+	esp_err_t err = nvs_get_blob(handle, WIFI_AP_CACHE_KEY, &s_ap_cache, &size);
+	nvs_close(handle);
+	if (err != ESP_OK || size != sizeof(s_ap_cache) || !ap_cache_valid(&s_ap_cache, ssid_crc)) {
+		memset(&s_ap_cache, 0, sizeof(s_ap_cache));
+		return false;
+	}
+	s_rtc_ap_cache = s_ap_cache;
+	return true;
+}
+
+// Called on every association; flash is only written when the AP changed
+static void ap_cache_store(const uint8_t bssid[6], uint8_t channel) {
+	uint32_t ssid_crc = esp_rom_crc32_le(0, s_wifi_config.sta.ssid, strlen((const char*)s_wifi_config.sta.ssid));
+	if (ap_cache_valid(&s_ap_cache, ssid_crc) && s_ap_cache.channel == channel &&
+		memcmp(s_ap_cache.bssid, bssid, 6) == 0) {
+		return;
+	}
+	memset(&s_ap_cache, 0, sizeof(s_ap_cache));
+	s_ap_cache.magic = WIFI_AP_CACHE_MAGIC;
+	s_ap_cache.ssid_crc = ssid_crc;
+	memcpy(s_ap_cache.bssid, bssid, 6);
+	s_ap_cache.channel = channel;
+	s_ap_cache.crc = ap_cache_crc(&s_ap_cache);
+	s_rtc_ap_cache = s_ap_cache;
+
+	nvs_handle_t handle;
+	esp_err_t err = nvs_open(WIFI_AP_CACHE_NAMESPACE, NVS_READWRITE, &handle);
+	if (err == ESP_OK) {
+		err = nvs_set_blob(handle, WIFI_AP_CACHE_KEY, &s_ap_cache, sizeof(s_ap_cache));
+		if (err == ESP_OK) {
+			err = nvs_commit(handle);
+		}
+		nvs_close(handle);
+	}
+	if (err != ESP_OK) {
+		ESP_LOGW("WIFI", "failed to store the AP cache: %s", esp_err_to_name(err));
+	} else {
+		ESP_LOGI("WIFI", "AP cache updated: " MACSTR " channel %d", MAC2STR(bssid), channel);
+	}
+}
+
+// Back to a full scan for the SSID: the cached BSSID and channel only serve the
+// first association of a boot
+static void clear_ap_hint(void) {
+	s_ap_hint = false;
+	s_wifi_config.sta.bssid_set = false;
+	memset(s_wifi_config.sta.bssid, 0, sizeof(s_wifi_config.sta.bssid));
+	s_wifi_config.sta.channel = 0;
+	s_wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+	esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config);
+}
+
+// The cached AP did not answer: forget the hint and scan every channel
+static void fast_connect_fallback(void) {
+	s_fast_attempt = false;
+	s_fast_connect = WIFI_FAST_CONNECT_MISS;
+	clear_ap_hint();
+	ESP_LOGW("WIFI", "cached AP not reachable, falling back to a full scan");
+	esp_wifi_connect();
+}
+#endif
+
+static void reconnect_callback(void* arg) {
+	ESP_LOGI("WIFI", "reconnect attempt %lu", (unsigned long)s_attempt);
+	s_stats.attempts++;
+	esp_err_t err = esp_wifi_connect();
+	if (err != ESP_OK) {
+		ESP_LOGW("WIFI", "esp_wifi_connect failed: %s", esp_err_to_name(err));
+	}
+}
+
+// Exponential backoff: min, 2*min, 4*min... up to max. Acquisition keeps running
+// meanwhile; only the event loop task is involved, and it is never blocked.
+static void schedule_reconnect(void) {
+	uint64_t delay_ms = (uint64_t)CONFIG_WIFI_RECONNECT_MIN_MS << (s_attempt < 16 ? s_attempt : 16);
+	if (delay_ms > CONFIG_WIFI_RECONNECT_MAX_MS) {
+		delay_ms = CONFIG_WIFI_RECONNECT_MAX_MS;
+	}
+	s_attempt++;
+	ESP_LOGI("WIFI", "reconnecting in %llu ms", (unsigned long long)delay_ms);
+	esp_timer_stop(s_reconnect_timer);
+	if (esp_timer_start_once(s_reconnect_timer, delay_ms * 1000ULL) != ESP_OK) {
+		reconnect_callback(NULL);
+	}
+}
 
 static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
+	if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+		ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
+		ESP_LOGI("WIFI", "IP(" IPSTR ")", IP2STR(&event->ip_info.ip));
+		if (s_offline_since_us != 0) {
+			uint32_t offline_ms = (uint32_t)((esp_timer_get_time() - s_offline_since_us) / 1000);
+			s_stats.reconnects++;
+			s_stats.offline_last_ms = offline_ms;
+			s_stats.offline_total_ms += offline_ms;
+			if (offline_ms > s_stats.offline_max_ms) {
+				s_stats.offline_max_ms = offline_ms;
+			}
+			ESP_LOGI("WIFI", "reconnected after %lu ms and %lu attempts", (unsigned long)offline_ms,
+			         (unsigned long)s_attempt);
+			s_offline_since_us = 0;
+		}
+		s_attempt = 0;
+		s_connected = true;
+#ifdef CONFIG_ENABLE_WIFI_FAST_CONNECT
+		if (s_fast_attempt) {
+			s_fast_attempt = false;
+			s_fast_connect = WIFI_FAST_CONNECT_HIT;
+		}
+#endif
+		boot_timing_mark(BOOT_PHASE_IP);
+		xSemaphoreGive(wifi_semaphore);
+		ESP_LOGI("WIFI", "wifi_semaphore unlocked");
+		return;
+	}
+
 	switch (event_id) {
 		case WIFI_EVENT_STA_START: {
 			ESP_LOGI("WIFI","start");
@@ -9,22 +186,43 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t e
 			break;
 		}
 		case WIFI_EVENT_STA_CONNECTED: {
-			ESP_LOGI("WIFI","connected");
+			wifi_event_sta_connected_t* event = (wifi_event_sta_connected_t*) event_data;
+			ESP_LOGI("WIFI","connected to " MACSTR " channel %d", MAC2STR(event->bssid), event->channel);
+			boot_timing_mark(BOOT_PHASE_WIFI_ASSOC);
+#ifdef CONFIG_ENABLE_WIFI_FAST_CONNECT
+			ap_cache_store(event->bssid, event->channel);
+#endif
 			break;
 		}
 		case WIFI_EVENT_STA_DISCONNECTED: {
-			ESP_LOGI("WIFI","disconnected trying to reconect in %d seconds", time_to_reconect);
 			wifi_event_sta_disconnected_t* event = (wifi_event_sta_disconnected_t*) event_data;
-			ESP_LOGI("WIFI","disconnected reason: %d", event->reason);
-			vTaskDelay(time_to_reconect * 5000 / portTICK_PERIOD_MS);
-            esp_restart();
-			break;
-		}
-		case IP_EVENT_STA_GOT_IP: {
-			ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-			ESP_LOGI("WIFI", "IP(" IPSTR ")", IP2STR(&event->ip_info.ip));
-			xSemaphoreGive(wifi_semaphore);
-			ESP_LOGI("WIFI", "wifi_semaphore unlocked");
+			ESP_LOGW("WIFI","disconnected reason: %d", event->reason);
+			s_stats.last_reason = event->reason;
+			if (s_connected) {
+				s_connected = false;
+				s_stats.disconnects++;
+			}
+			if (s_offline_since_us == 0) {
+				s_offline_since_us = esp_timer_get_time();
+			}
+#ifdef CONFIG_ENABLE_WIFI_FAST_CONNECT
+			if (s_fast_attempt) {
+				fast_connect_fallback();
+				break;
+			}
+			// The AP may have moved to another channel, or roaming to another BSSID may be needed
+			if (s_ap_hint) {
+				clear_ap_hint();
+			}
+#endif
+#if CONFIG_WIFI_RESTART_AFTER_OFFLINE_MIN > 0
+			// Last resort for a stuck driver: acquisition state is lost, so only after a long outage
+			if (esp_timer_get_time() - s_offline_since_us >= (int64_t)CONFIG_WIFI_RESTART_AFTER_OFFLINE_MIN * 60000000LL) {
+				ESP_LOGE("WIFI", "offline for %d minutes, restarting", CONFIG_WIFI_RESTART_AFTER_OFFLINE_MIN);
+				esp_restart();
+			}
+#endif
+			schedule_reconnect();
 			break;
 		}
 		default: {
@@ -34,13 +232,87 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t e
 	}
 }
 
+const char* wifi_fast_connect_name(wifi_fast_connect_t result) {
+	switch (result) {
+		case WIFI_FAST_CONNECT_HIT: return "hit";
+		case WIFI_FAST_CONNECT_MISS: return "miss";
+		default: return "none";
+	}
+}
+
+wifi_fast_connect_t wifi_get_fast_connect(void) {
+	return s_fast_connect;
+}
+
+bool wifi_static_ip_enabled(void) {
+	return s_static_ip;
+}
+
+static bool setting_set(const char* value) {
+	return value != NULL && value[0] != '\0' && strcmp(value, "default") != 0;
+}
+
+// Static address: skips DHCP entirely. The netmask defaults to /24 and the DNS
+// server to the gateway. Any invalid field keeps DHCP.
+static void apply_static_ip(esp_netif_t* netif, nmda_init_config_t* nmda_config) {
+	esp_netif_ip_info_t ip_info;
+	esp_netif_dns_info_t dns_info;
+	memset(&ip_info, 0, sizeof(ip_info));
+	memset(&dns_info, 0, sizeof(dns_info));
+
+	if (!setting_set(nmda_config->wifi_static_ip)) {
+		return;
+	}
+	if (esp_netif_str_to_ip4(nmda_config->wifi_static_ip, &ip_info.ip) != ESP_OK ||
+		esp_netif_str_to_ip4(setting_set(nmda_config->wifi_netmask) ? nmda_config->wifi_netmask : "255.255.255.0",
+		                     &ip_info.netmask) != ESP_OK ||
+		!setting_set(nmda_config->wifi_gateway) ||
+		esp_netif_str_to_ip4(nmda_config->wifi_gateway, &ip_info.gw) != ESP_OK) {
+		ESP_LOGE("WIFI", "invalid static IP settings (wifi_static_ip/wifi_netmask/wifi_gateway), using DHCP");
+		return;
+	}
+	if (esp_netif_str_to_ip4(setting_set(nmda_config->wifi_dns) ? nmda_config->wifi_dns : nmda_config->wifi_gateway,
+	                         &dns_info.ip.u_addr.ip4) != ESP_OK) {
+		ESP_LOGW("WIFI", "invalid wifi_dns, using the gateway");
+		dns_info.ip.u_addr.ip4 = ip_info.gw;
+	}
+	dns_info.ip.type = ESP_IPADDR_TYPE_V4;
+
+	esp_err_t err = esp_netif_dhcpc_stop(netif);
+	if (err != ESP_OK && err != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED) {
+		ESP_LOGE("WIFI", "esp_netif_dhcpc_stop failed: %s, using DHCP", esp_err_to_name(err));
+		return;
+	}
+	err = esp_netif_set_ip_info(netif, &ip_info);
+	if (err != ESP_OK) {
+		ESP_LOGE("WIFI", "esp_netif_set_ip_info failed: %s, using DHCP", esp_err_to_name(err));
+		esp_netif_dhcpc_start(netif);
+		return;
+	}
+	esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns_info);
+	s_static_ip = true;
+	ESP_LOGI("WIFI", "static IP " IPSTR " gw " IPSTR, IP2STR(&ip_info.ip), IP2STR(&ip_info.gw));
+}
+
+bool wifi_is_connected(void) {
+	return s_connected;
+}
+
+void wifi_get_link_stats(wifi_link_stats_t* stats) {
+	*stats = s_stats;
+	stats->connected = s_connected;
+	stats->offline_now_ms = (s_offline_since_us != 0) ?
+		(uint32_t)((esp_timer_get_time() - s_offline_since_us) / 1000) : 0;
+}
+
 void wifi_setup(nmda_init_config_t* nmda_config) {
 
 	ESP_LOGI("WIFI", "wifi_setup: starting");
 
 	ESP_ERROR_CHECK(esp_netif_init());
 	ESP_ERROR_CHECK(esp_event_loop_create_default());
-	esp_netif_create_default_wifi_sta();
+	esp_netif_t* sta_netif = esp_netif_create_default_wifi_sta();
+	apply_static_ip(sta_netif, nmda_config);
 
 	wifi_init_config_t wifi_init_config = WIFI_INIT_CONFIG_DEFAULT();
 	ESP_ERROR_CHECK(esp_wifi_init(&wifi_init_config));
@@ -49,31 +321,42 @@ void wifi_setup(nmda_init_config_t* nmda_config) {
 	ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT,IP_EVENT_STA_GOT_IP,wifi_event_handler,NULL));
 	ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
 
-	wifi_config_t wifi_config = {
-		.sta = {
-			.ssid = {0},
-			.password = {0},
-			.scan_method = (wifi_scan_method_t)0,
-			.bssid_set = false,
-			.bssid = {0},
-			.channel = 0,
-			.listen_interval = 0,
-			.sort_method = (wifi_sort_method_t)0,
-			.threshold = {0, (wifi_auth_mode_t)0}},
+	const esp_timer_create_args_t reconnect_timer_args = {
+		.callback = reconnect_callback,
+		.arg = NULL,
+		.dispatch_method = ESP_TIMER_TASK,
+		.name = "wifi_reconnect",
 	};
-	memset(&wifi_config, 0, sizeof(wifi_config));
+	ESP_ERROR_CHECK(esp_timer_create(&reconnect_timer_args, &s_reconnect_timer));
+
+	wifi_config_t* wifi_config = &s_wifi_config;
+	memset(wifi_config, 0, sizeof(*wifi_config));
 
-	strcpy((char*)wifi_config.sta.ssid,     nmda_config->wifi_essid);
-	strcpy((char*)wifi_config.sta.password, nmda_config->wifi_password);
-	ESP_LOGI("WIFI", "wifi_essid: |%s|", wifi_config.sta.ssid);
-	ESP_LOGI("WIFI", "wifi_password: |%s|", wifi_config.sta.password);
+	strcpy((char*)wifi_config->sta.ssid,     nmda_config->wifi_essid);
+	strcpy((char*)wifi_config->sta.password, nmda_config->wifi_password);
+	ESP_LOGI("WIFI", "wifi_essid: |%s|", wifi_config->sta.ssid);
+	ESP_LOGI("WIFI", "wifi_password: |%s|", wifi_config->sta.password);
 
-	wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
-	wifi_config.sta.pmf_cfg.capable = true;
-	wifi_config.sta.pmf_cfg.required = false;
+	wifi_config->sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+	wifi_config->sta.pmf_cfg.capable = true;
+	wifi_config->sta.pmf_cfg.required = false;
+
+#ifdef CONFIG_ENABLE_WIFI_FAST_CONNECT
+	// Go straight to the last AP: no scan of the other channels
+	uint32_t ssid_crc = esp_rom_crc32_le(0, wifi_config->sta.ssid, strlen((const char*)wifi_config->sta.ssid));
+	if (ap_cache_load(ssid_crc)) {
+		wifi_config->sta.scan_method = WIFI_FAST_SCAN;
+		wifi_config->sta.channel = s_ap_cache.channel;
+		wifi_config->sta.bssid_set = true;
+		memcpy(wifi_config->sta.bssid, s_ap_cache.bssid, 6);
+		s_fast_attempt = true;
+		s_ap_hint = true;
+		ESP_LOGI("WIFI", "fast connect to " MACSTR " channel %d", MAC2STR(s_ap_cache.bssid), s_ap_cache.channel);
+	}
+#endif
 
 	ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-	ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config) );
+	ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, wifi_config) );
 	ESP_ERROR_CHECK(esp_wifi_start());
 
 	ESP_LOGI("WIFI", "wifi_setup: done");
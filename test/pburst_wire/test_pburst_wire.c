@@ -0,0 +1,175 @@
+// Host test of the binary pburst format: round trips, the example of
+// docs/PBURST_DOCUMENTATION.md and rejection of malformed payloads.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "pburst_wire.h"
+
+#define MAX_PULSES 64
+#define RESOLUTION_HZ 2000000
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        s_failures++; \
+    } \
+} while (0)
+
+static size_t encode(uint8_t *buf, size_t size, const pburst_bin_header_t *header, const pburst_pulse_t *pulses)
+{
+    pburst_writer_t w;
+    pburst_writer_init(&w, buf, size);
+    pburst_write_header(&w, header);
+    for (uint8_t i = 0; i < header->num_pulses; i++) {
+        pburst_write_pulse(&w, pulses[i].duration_ticks, pulses[i].separation_us);
+    }
+    return pburst_writer_finish(&w);
+}
+
+static void round_trip(const char *name, uint8_t channel, int64_t start_timestamp,
+                       const pburst_pulse_t *pulses, uint8_t n)
+{
+    uint8_t buf[PBURST_BIN_MAX_SIZE(MAX_PULSES) + 1];
+    pburst_pulse_t decoded[MAX_PULSES];
+    pburst_bin_header_t header = { channel, RESOLUTION_HZ, start_timestamp, n };
+    pburst_bin_header_t out;
+
+    size_t len = encode(buf, sizeof(buf) - 1, &header, pulses);
+    CHECK(len > 0 && len <= PBURST_BIN_MAX_SIZE(n), "%s: encoded %zu bytes", name, len);
+    if (len == 0) {
+        return;
+    }
+
+    pburst_status_t status = pburst_decode(buf, len, &out, decoded, MAX_PULSES);
+    CHECK(status == PBURST_OK, "%s: decode: %s", name, pburst_status_name(status));
+    if (status != PBURST_OK) {
+        return;
+    }
+    CHECK(out.channel == channel && out.resolution_hz == RESOLUTION_HZ &&
+          out.start_timestamp == start_timestamp && out.num_pulses == n, "%s: header mismatch", name);
+    for (uint8_t i = 0; i < n; i++) {
+        CHECK(decoded[i].duration_ticks == pulses[i].duration_ticks &&
+              decoded[i].duration_us == pulses[i].duration_ticks / (RESOLUTION_HZ / 1000000) &&
+              decoded[i].separation_us == pulses[i].separation_us, "%s: pulse %u mismatch", name, i);
+    }
+
+    // Every strict prefix is truncated, and a trailing byte is rejected
+    for (size_t cut = 0; cut < len; cut++) {
+        CHECK(pburst_decode(buf, cut, &out, decoded, MAX_PULSES) != PBURST_OK,
+              "%s: %zu of %zu bytes accepted", name, cut, len);
+    }
+    buf[len] = PBURST_BIN_MAGIC;
+    CHECK(pburst_decode(buf, len + 1, &out, decoded, MAX_PULSES) == PBURST_ERR_SIZE,
+          "%s: trailing byte accepted", name);
+
+    // As the first record of a batch it ends where it was written
+    size_t consumed = 0;
+    CHECK(pburst_decode_next(buf, len + 1, &consumed, &out, decoded, MAX_PULSES) == PBURST_OK &&
+          consumed == len, "%s: batch record of %zu bytes, expected %zu", name, consumed, len);
+
+    // A buffer one byte short reports the overflow
+    CHECK(encode(buf, len - 1, &header, pulses) == 0, "%s: overflow not reported", name);
+}
+
+static void test_round_trips(void)
+{
+    pburst_pulse_t pulses[MAX_PULSES];
+
+    pulses[0] = (pburst_pulse_t){ .duration_ticks = 9, .separation_us = -1 };
+    round_trip("single", 1, 1718000000123456LL, pulses, 1);
+
+    pulses[0] = (pburst_pulse_t){ .duration_ticks = 0, .separation_us = 0 };
+    pulses[1] = (pburst_pulse_t){ .duration_ticks = 32767, .separation_us = INT64_MAX };
+    pulses[2] = (pburst_pulse_t){ .duration_ticks = UINT16_MAX, .separation_us = INT64_MIN };
+    round_trip("limits", 3, INT64_MIN, pulses, 3);
+    round_trip("limits_ts", 2, INT64_MAX, pulses, 3);
+    round_trip("empty", 2, 0, pulses, 0);
+
+    static const uint8_t sizes[] = { 2, 8, 23, MAX_PULSES };
+    uint32_t lcg = 0x2545F491;
+    for (size_t k = 0; k < sizeof(sizes); k++) {
+        int n = sizes[k];
+        for (int i = 0; i < n; i++) {
+            lcg = lcg * 1664525u + 1013904223u;
+            pulses[i].duration_ticks = (uint16_t)(lcg >> 20);
+            pulses[i].separation_us = (i == 0) ? -1 : (int64_t)((lcg >> 4) % 5000000);
+        }
+        round_trip("random", (uint8_t)(1 + n % 3), 1718000000000000LL + n, pulses, (uint8_t)n);
+    }
+}
+
+// The 21-byte example of docs/PBURST_DOCUMENTATION.md
+static void test_documented_example(void)
+{
+    static const uint8_t example[] = { 0xb5, 0x01, 0x03, 0x80, 0x89, 0x7a, 0x80, 0xc9, 0x89, 0xfb, 0x94,
+                                       0xe4, 0x86, 0x06, 0x03, 0x0c, 0x01, 0x0c, 0x78, 0x0c, 0x78 };
+    pburst_bin_header_t header;
+    pburst_pulse_t pulses[MAX_PULSES];
+
+    pburst_status_t status = pburst_decode(example, sizeof(example), &header, pulses, MAX_PULSES);
+    CHECK(status == PBURST_OK, "example: %s", pburst_status_name(status));
+    if (status != PBURST_OK) {
+        return;
+    }
+    CHECK(header.channel == 3 && header.resolution_hz == RESOLUTION_HZ && header.num_pulses == 3,
+          "example: header");
+    CHECK(pulses[0].duration_us == 6 && pulses[0].separation_us == -1, "example: pulse 0");
+    CHECK(pulses[1].duration_us == 6 && pulses[1].separation_us == 60, "example: pulse 1");
+    CHECK(pulses[2].duration_us == 6 && pulses[2].separation_us == 60, "example: pulse 2");
+    printf("example start_timestamp %" PRId64 "\n", header.start_timestamp);
+}
+
+static void test_malformed(void)
+{
+    pburst_bin_header_t header;
+    pburst_pulse_t pulses[MAX_PULSES];
+
+    static const uint8_t bad_magic[] = { '{', PBURST_BIN_VERSION, 1, 0x80, 0x89, 0x7A, 0, 0 };
+    static const uint8_t bad_version[] = { PBURST_BIN_MAGIC, 2, 1, 0x80, 0x89, 0x7A, 0, 0 };
+    CHECK(pburst_decode(bad_magic, sizeof(bad_magic), &header, pulses, MAX_PULSES) == PBURST_ERR_VERSION,
+          "bad magic accepted");
+    CHECK(pburst_decode(bad_version, sizeof(bad_version), &header, pulses, MAX_PULSES) == PBURST_ERR_VERSION,
+          "bad version accepted");
+
+    // Eleven continuation bytes
+    static const uint8_t overlong[] = { PBURST_BIN_MAGIC, PBURST_BIN_VERSION, 1,
+                                        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 };
+    CHECK(pburst_decode(overlong, sizeof(overlong), &header, pulses, MAX_PULSES) == PBURST_ERR_FIELD,
+          "overlong varint accepted");
+
+    // Resolution below 1 MHz cannot be converted to whole microseconds
+    static const uint8_t low_resolution[] = { PBURST_BIN_MAGIC, PBURST_BIN_VERSION, 1, 0x01, 0x00, 0x00 };
+    CHECK(pburst_decode(low_resolution, sizeof(low_resolution), &header, pulses, MAX_PULSES) == PBURST_ERR_FIELD,
+          "resolution below 1 MHz accepted");
+
+    // More pulses than the output array holds
+    static const uint8_t too_many[] = { PBURST_BIN_MAGIC, PBURST_BIN_VERSION, 1, 0x80, 0x89, 0x7A, 0x00, 0x02,
+                                        0x0c, 0x01, 0x0c, 0x78 };
+    CHECK(pburst_decode(too_many, sizeof(too_many), &header, pulses, 1) == PBURST_ERR_SIZE,
+          "pulse count over max_pulses accepted");
+
+    // Duration over 16 bits
+    static const uint8_t long_pulse[] = { PBURST_BIN_MAGIC, PBURST_BIN_VERSION, 1, 0x80, 0x89, 0x7A, 0x00, 0x01,
+                                          0x80, 0x80, 0x04, 0x01 };
+    CHECK(pburst_decode(long_pulse, sizeof(long_pulse), &header, pulses, MAX_PULSES) == PBURST_ERR_FIELD,
+          "duration over 16 bits accepted");
+}
+
+int main(void)
+{
+    test_round_trips();
+    test_documented_example();
+    test_malformed();
+
+    if (s_failures > 0) {
+        printf("%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    printf("pburst wire format: all checks passed\n");
+    return 0;
+}